@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Runtime support for programs translated by luna --emit-c (see emit_c.h).
+// The generated code calls these for everything that depends on the
+// environment; each helper does what the AST walker does for the same node.
+#pragma once
+
+#include <math.h>
+#include <luna/ast.h>
+#include <luna/env.h>
+#include <luna/interpreter.h>
+#include <luna/luna_error.h>
+#include <luna/value.h>
+
+#define AOT_TAIL_ARGS 8     // Tail calls pass at most this many arguments
+
+struct AotFrame;
+
+// Body of a translated user function. Runs in scope (parameters already
+// bound) and returns its result.
+typedef Value (*AotBody)(Env *scope, AotFrame *frame);
+
+// State of one translated user function call
+struct AotFrame
+{
+    Env *scope;                         // Call scope
+    AstNode *tail_fn;                   // Set by 'return f(...)' run in place
+    AotBody tail_body;
+    Value tail_args[AOT_TAIL_ARGS];
+    int tail_argc;
+};
+
+// Program start and end: global environment, natives, error context
+Env *aot_start(const char *source, const char *path);
+int aot_finish(Env *global);
+
+// Makes the function node a 'func' (or 'memo func') statement defines.
+// Call sites find it through call_resolve like any other user function.
+AstNode *aot_function(const char *name, const char *const *params, int count, int memo);
+int aot_param_count(AstNode *fn);
+
+// Calls a user function with argc owned arguments (missing ones are null),
+// looking up and storing the result of a 'memo func'.
+Value aot_call(Env *e, AstNode *fn, AotBody body, Value *args, int argc);
+
+// True when 'return fn(...)' may replace the current call (see the walker's
+// tail_call_target)
+int aot_can_tail(Env *e, AotFrame *frame, AstNode *fn);
+
+// Calls a native; arguments whose bit is set in borrowed are not freed
+Value aot_call_native(NativeFunc fn, Value *args, int argc, unsigned long long borrowed);
+
+// Reads a variable (null if undefined)
+Value aot_get(Env *e, const char *name);
+
+// name = values[0] + ... + values[count - 1] for 'x = x + ...', extending
+// x's string in place when it can (see append_sum). Takes the values.
+void aot_assign_sum(Env *e, const char *name, Value *values, int count);
+
+// eval_binop that takes both operands
+Value aot_binop(BinOpKind op, Value l, Value r);
+
+// Reads list[index] or map[key] (dense list items as floats), or null.
+// Takes both values.
+Value aot_index(Value target, Value index);
+
+// Steps from a list or map variable to the item at index for assignment,
+// or returns nullptr (reporting out of bounds indices). Takes index.
+Value *aot_index_ref(Value *list, Value index, int line);
+
+// list[index] = value for lists, dense lists and maps. Takes index and value.
+void aot_assign_index(Value *target, Value index, Value value, int line);
+
+// append(list, value). Takes value.
+void aot_append(Value *list, Value value, int line);
+
+Value aot_step(Env *e, const char *name, int delta);    // x++ and x--
+void aot_print(Value v);                                // One print argument; takes v
+Value aot_input(const char *prompt);
+Value aot_not(Value v);                                 // Takes v
+int aot_truthy(Value v);                                // Takes v
+
+// Unboxed float helpers, matching eval_binop
+static inline double aot_fdiv(double l, double r)
+{
+    return r == 0 ? 0 : l / r;
+}
+
+static inline int aot_feq(double l, double r)
+{
+    return fabs(l - r) < EPSILON;
+}
+
+static inline int aot_fneq(double l, double r)
+{
+    return fabs(l - r) >= EPSILON;
+}
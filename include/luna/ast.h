@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <variant>
@@ -13,6 +14,7 @@ typedef enum
     NODE_CHAR,
     NODE_BOOL,
     NODE_LIST,
+    NODE_MAP,
     NODE_IDENT,
 
     NODE_BINOP,
@@ -57,7 +59,13 @@ typedef enum
 } BinOpKind;
 
 struct AstNode;
+struct AstArena;
+struct Proto;
+struct JitCode;
+struct MemoTable;
 
+// Child nodes. A list is built on the heap with nodelist_push; the node
+// it is given to moves the items into its arena (capacity 0 from then on).
 typedef struct
 {
     AstNode **items;
@@ -65,30 +73,42 @@ typedef struct
     int capacity;
 } NodeList;
 
+// A global variable as read by one site, reused while the global table
+// keeps its shape and no other scope binds the name (see env_get_cached)
+struct GlobalCache
+{
+    Value *slot = nullptr;          // NULL when the name is undefined
+    size_t shape = 0;               // env_var_shape() when filled, 0 if empty
+    const int *shadows = nullptr;   // bindings of the name outside the global scope
+};
+
 /* =========================
    Payload structs
    ========================= */
 
+// Text (names, literals, prompts) is NUL-terminated and lives in the arena
+// of the tree, like the nodes and their child lists.
 struct NumberNode { long long value; };
 struct FloatNode  { double value; };
-struct StringNode { std::string text; };
+struct StringNode { const char *text; };
 struct CharNode   { char value; };
 struct BoolNode   { bool value; };
 struct ListNode   { NodeList items; };
-struct IdentNode  { std::string name; };
-struct IncNode    { std::string name; };
-struct DecNode    { std::string name; };
+struct MapNode    { NodeList items; };  // key, value, key, value, ...
+struct IdentNode  { const char *name; GlobalCache cache{}; };
+struct IncNode    { const char *name; };
+struct DecNode    { const char *name; };
 
 struct BinOpNode { BinOpKind op; AstNode *left; AstNode *right; };
-struct LetNode   { std::string name; AstNode *expr; };
-struct AssignNode{ std::string name; AstNode *expr; };
+struct LetNode   { const char *name; AstNode *expr; };
+struct AssignNode{ const char *name; AstNode *expr; };
 
 struct AssignIndexNode { AstNode *list; AstNode *index; AstNode *value; };
 struct IndexNode       { AstNode *target; AstNode *index; };
 struct NotNode         { AstNode *expr; };
 
 struct PrintNode { NodeList args; };
-struct InputNode { std::string prompt; };
+struct InputNode { const char *prompt; };
 struct BreakNode {};
 struct ContinueNode {};
 
@@ -117,14 +137,55 @@ struct SwitchNode
 };
 
 struct CaseNode  { AstNode *value; NodeList body; };
-struct BlockNode { NodeList items; };
-struct CallNode  { std::string name; NodeList args; };
+struct BlockNode
+{
+    NodeList items;
+    AstArena *arena = nullptr;  // Set on a program's root: the memory of its tree
+};
+// Built-in functions handled by the interpreter itself, found at parse time
+typedef enum
+{
+    INTRINSIC_NONE,
+    INTRINSIC_LEN,
+    INTRINSIC_APPEND,
+    INTRINSIC_TYPE,
+    INTRINSIC_INT,
+    INTRINSIC_FLOAT
+} Intrinsic;
+
+// The function a call site resolved to last time (see call_resolve).
+// It stays valid while epoch matches env_func_epoch().
+struct CallTarget
+{
+    AstNode *fn = nullptr;          // user function, or
+    NativeFunc native = nullptr;    // native function
+    bool mutates = false;           // the native changes its list or map arguments
+    size_t epoch = 0;               // 0 until resolved
+    bool cacheable = false;         // natives only: the name is never a variable
+};
+
+struct CallNode
+{
+    const char *name;
+    NodeList args;
+    Intrinsic intrinsic = INTRINSIC_NONE;
+    int pure_tail = 0;              // args from here on have no side effects
+    CallTarget target{};
+    GlobalCache var{};              // the variable holding a native callee
+};
 
 struct FuncDefNode 
 {
-    std::string name;
-    std::vector<std::string> params;
+    const char *name;
+    const char **params;
+    int param_count;
     NodeList body;
+    Proto *proto = nullptr; // Bytecode for the body, compiled on first use
+    JitCode *jit = nullptr; // Machine code for the body (see jit.h)
+    int calls = 0;          // Calls counted towards JIT_HOT_CALLS, -1 once
+                            // the body cannot be compiled
+    bool memo = false;      // Declared 'memo func' (see memo.h)
+    MemoTable *memo_table = nullptr;
 };
 
 struct ReturnNode { AstNode *expr; };
@@ -137,6 +198,7 @@ using AstPayload = std::variant
     CharNode,
     BoolNode,
     ListNode,
+    MapNode,
     IdentNode,
     IncNode,
     DecNode,
@@ -193,6 +255,13 @@ struct AstNode
    API stays the same
    ========================= */
 
+// Memory of one program's tree. The ast_* constructors carve nodes, child
+// lists and text out of the arena in use, in large blocks released at once.
+AstArena *ast_arena_create(void);
+void ast_arena_use(AstArena *arena);    // nullptr: none
+void ast_arena_free(AstArena *arena);   // Also frees the functions' bytecode,
+                                        // machine code and memo tables
+
 void nodelist_init(NodeList *l);
 void nodelist_push(NodeList *l, AstNode *n);
 void nodelist_free(NodeList *l);
@@ -203,6 +272,7 @@ AstNode *ast_string(const char *s, int line);
 AstNode *ast_char(char c, int line);
 AstNode *ast_bool(int v, int line);
 AstNode *ast_list(NodeList items, int line);
+AstNode *ast_map(NodeList items, int line);
 AstNode *ast_ident(const char *name, int line);
 AstNode *ast_inc(const char *name, int line);
 AstNode *ast_dec(const char *name, int line);
@@ -227,4 +297,26 @@ AstNode *ast_return(AstNode *expr, int line);
 AstNode *ast_assign_index(AstNode *list, AstNode *index, AstNode *value, int line);
 AstNode *ast_not(AstNode *expr, int line);
 
-void ast_free(AstNode *node);
\ No newline at end of file
+// The root block of a program, owning the arena its nodes were made in
+AstNode *ast_program(NodeList items, AstArena *arena, int line);
+
+// Frees a program's root made by ast_program, with its arena. Nodes dropped
+// from a tree (by the optimizer, say) stay in the arena until then.
+void ast_free(AstNode *node);
+
+// True when evaluating the expression cannot change any variable
+int ast_is_pure(AstNode *node);
+
+#define SUM_MAX_OPERANDS 16     // Operands one '+' chain is split into
+
+// Splits a chain a + b + c + ... into its operands, leftmost first, and
+// returns their count (1 when node is not a '+'). A chain of more than max
+// operands keeps its head as one operand.
+int ast_sum_operands(AstNode *node, AstNode **operands, int max);
+
+// For an assignment 'x = x + a + ...', splits the value as ast_sum_operands
+// (at most SUM_MAX_OPERANDS) and returns the count; 0 for other assignments
+int ast_self_append(AstNode *assign, AstNode **operands);
+
+// Prints the tree under node, one node per line, indented by depth
+void ast_dump(AstNode *node, FILE *out);
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Bytecode format shared by the compiler (compiler.cpp) and the VM (vm.cpp).
+// The compiler lowers the AST produced by parser_parse_program into one Proto
+// per function body (plus one for the top level program). Instructions work
+// on a per-frame register window. Variables declared in the function (or in
+// a block) are resolved to scope slots at compile time; every other name is
+// looked up through the Env chain at run time.
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <luna/ast.h>
+#include <luna/value.h>
+
+// Operand legend: A/B/C are 16-bit operands, R(x) is register x of the
+// current frame, K(x) is constant x, V(x) is variable reference x and J is
+// a 32-bit jump target stored in the B/C pair. Registers are temporaries
+// owned by the frame: an instruction that "consumes" a register frees it
+// and leaves null behind. Instructions naming a variable K(B) other than
+// BC_DEFVAR look it up through the global cache C.
+#define LUNA_OPCODES(X)                                                       \
+    X(BC_LOADK)       /* R(A) = copy of K(B)                               */ \
+    X(BC_LOADNULL)    /* R(A) = null                                       */ \
+    X(BC_GETVAR)      /* R(A) = copy of variable K(B), null if undefined   */ \
+    X(BC_DEFVAR)      /* let K(B) = R(A)                        consumes A */ \
+    X(BC_SETVAR)      /* K(B) = R(A)                            consumes A */ \
+    X(BC_INCVAR)      /* R(A) = K(B)++                                     */ \
+    X(BC_DECVAR)      /* R(A) = K(B)--                                     */ \
+    /* Slot variables: L(B, C) is slot B of the scope C levels up          */ \
+    X(BC_GETLOCAL)    /* R(A) = copy of L(B, C)                            */ \
+    X(BC_DEFLOCAL)    /* let L(B, 0) = R(A)                     consumes A */ \
+    X(BC_SETLOCAL)    /* L(B, C) = R(A)                         consumes A */ \
+    X(BC_INCLOCAL)    /* R(A) = L(B, C)++                                  */ \
+    X(BC_DECLOCAL)    /* R(A) = L(B, C)--                                  */ \
+    X(BC_STEPLOCAL)   /* L(B, C)++ (A = 0) or L(B, C)-- (A = 1), no result */ \
+    /* Binary operators, same order as BinOpKind: R(A) = R(B) op R(C)      */ \
+    X(BC_ADD)                                                                 \
+    X(BC_SUB)                                                                 \
+    X(BC_MUL)                                                                 \
+    X(BC_DIV)                                                                 \
+    X(BC_MOD)                                                                 \
+    X(BC_EQ)                                                                  \
+    X(BC_NEQ)                                                                 \
+    X(BC_LT)                                                                  \
+    X(BC_GT)                                                                  \
+    X(BC_LTE)                                                                 \
+    X(BC_GTE)                                                                 \
+    /* Quickened binary operators (see BC_ADD). The VM rewrites a generic  */ \
+    /* one into these once it has seen int/int (_II) or float/float (_FF)  */ \
+    /* operands, and rewrites it back when the operand types change.       */ \
+    X(BC_ADD_II)                                                              \
+    X(BC_SUB_II)                                                              \
+    X(BC_MUL_II)                                                              \
+    X(BC_DIV_II)                                                              \
+    X(BC_MOD_II)                                                              \
+    X(BC_EQ_II)                                                               \
+    X(BC_NEQ_II)                                                              \
+    X(BC_LT_II)                                                               \
+    X(BC_GT_II)                                                               \
+    X(BC_LTE_II)                                                              \
+    X(BC_GTE_II)                                                              \
+    X(BC_ADD_FF)                                                              \
+    X(BC_SUB_FF)                                                              \
+    X(BC_MUL_FF)                                                              \
+    X(BC_DIV_FF)                                                              \
+    X(BC_MOD_FF)                                                              \
+    X(BC_EQ_FF)                                                               \
+    X(BC_NEQ_FF)                                                              \
+    X(BC_LT_FF)                                                               \
+    X(BC_GT_FF)                                                               \
+    X(BC_LTE_FF)                                                              \
+    X(BC_GTE_FF)                                                              \
+    /* Loop tests, same order as OP_LT..OP_GTE: skip the next instruction  */ \
+    /* (the jump out of the loop) if L(B, C) op R(A)            consumes A */ \
+    X(BC_LOOPLT)                                                              \
+    X(BC_LOOPGT)                                                              \
+    X(BC_LOOPLTE)                                                             \
+    X(BC_LOOPGTE)                                                             \
+    X(BC_NOT)         /* R(A) = !R(B)                           consumes B */ \
+    X(BC_JMP)         /* goto J                                            */ \
+    X(BC_JMPF)        /* if !R(A) goto J                        consumes A */ \
+    X(BC_JMPF_KEEP)   /* if !R(A) goto J keeping A, else consume A    (&&) */ \
+    X(BC_JMPT_KEEP)   /* if R(A) goto J keeping A, else consume A     (||) */ \
+    X(BC_NEWLIST)     /* R(A) = []                                         */ \
+    X(BC_LISTPUSH)    /* append R(B) to list R(A)               consumes B */ \
+    X(BC_NEWMAP)      /* R(A) = {}                                         */ \
+    X(BC_MAPSET)      /* R(A)[R(B)] = R(B+1) in a map literal consumes B.. */ \
+    X(BC_INDEX)       /* R(A) = R(B)[R(C)]                   consumes B, C */ \
+    X(BC_INDEXVAR)    /* R(A) = V(B)[R(A+1)]..[R(A+C)]     consumes A+1.. */ \
+    X(BC_SETINDEX)    /* V(B)[R(A+1)]..[R(A+C)] = R(A)     consumes A..A+C */ \
+    X(BC_APPEND)      /* append(V(B)[R(A+1)]..[R(A+C)], R(A))              */ \
+    X(BC_APPENDSUM)   /* V(B) = R(A) + .. + R(A+C), in place (append_sum) */ \
+    X(BC_BADTARGET)   /* report non-list target (C: 0 assign, 1 append)    */ \
+    X(BC_APPEND_ARGC) /* report append() called with a bad argument count  */ \
+    X(BC_LEN)         /* R(A) = len(R(B))                       consumes B */ \
+    X(BC_LENVAR)      /* R(A) = len(V(B)[R(A+1)]..[R(A+C)]) consumes A+1.. */ \
+    X(BC_TYPE)        /* R(A) = type(R(B))                      consumes B */ \
+    X(BC_TOINT)       /* R(A) = int(R(B))                       consumes B */ \
+    X(BC_TOFLOAT)     /* R(A) = float(R(B))                     consumes B */ \
+    X(BC_PRINT)       /* print one argument R(A)                consumes A */ \
+    X(BC_PRINTLN)     /* finish a print statement                          */ \
+    X(BC_INPUT)       /* R(A) = input(K(B))                                */ \
+    X(BC_SWITCHEQ)    /* R(A) = R(B) matches case R(C)          consumes C */ \
+    X(BC_FREE)        /* free R(A)                                         */ \
+    X(BC_PUSHSCOPE)   /* enter a block scope laid out by scopes[A]         */ \
+    X(BC_POPSCOPE)    /* leave a block scope                               */ \
+    X(BC_FUNCDEF)     /* define the function stored at funcs[B]            */ \
+    X(BC_PREPCALL)    /* resolve the callee of call site B, args from R(A) */ \
+    X(BC_ARGSKIP)     /* goto J if argument A of the pending call is unused*/ \
+    X(BC_ARGVAR)      /* R(A) = argument read from variable K(B)           */ \
+    X(BC_ARGLOCAL)    /* R(A) = argument read from L(B, C)                 */ \
+    X(BC_ARGREF)      /* rebind R(A) to V(B) for natives that change it    */ \
+    X(BC_ARGREFLOCAL) /* same for L(B, C)                                  */ \
+    X(BC_CALL)        /* R(A) = pending call, arguments R(B)..R(B+C-1)     */ \
+    X(BC_TAILCALL)    /* BC_CALL of 'return f(...)', may replace the frame */ \
+    X(BC_RETURN)      /* return R(A)                                       */ \
+    X(BC_RETNULL)     /* return null                                       */ \
+    X(BC_HALT)        /* end of the top level program                      */
+
+#define LUNA_OPCODE_ENUM(op) op,
+typedef enum
+{
+    LUNA_OPCODES(LUNA_OPCODE_ENUM)
+    BC_COUNT
+} OpCode;
+#undef LUNA_OPCODE_ENUM
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t misses;     // Quickened binary operators: failed type guards
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+} Instr;
+
+#define INSTR_JUMP(i) ((uint32_t)(i).b | ((uint32_t)(i).c << 16))
+
+// Static description of a call expression
+typedef struct
+{
+    uint16_t name;          // constant holding the callee name
+    uint16_t argc;
+    CallNode *node;         // caches the resolved callee (call_resolve)
+} CallSite;
+
+// A variable named by an instruction operand
+typedef struct
+{
+    uint16_t name;          // constant holding the variable name
+    int16_t slot;           // -1 when the name is looked up dynamically
+    uint16_t depth;
+    uint16_t cache;         // globals[] entry of a dynamic lookup
+} VarRef;
+
+// Slot layout of one scope: the names of its slot variables in order
+typedef std::vector<const char*> ScopeLayout;
+
+struct Proto
+{
+    std::string name;
+    std::vector<Instr> code;
+    std::vector<int> lines;             // source line of every instruction
+    std::vector<Value> consts;
+    std::vector<CallSite> calls;
+    std::vector<VarRef> refs;
+    std::vector<GlobalCache> globals;   // one per named variable access
+    std::vector<AstNode*> funcs;        // NODE_FUNC_DEF nodes referenced by BC_FUNCDEF
+    std::vector<ScopeLayout> scopes;    // scopes[0] is the call scope of a function
+    std::vector<uint16_t> param_slots;
+    int nregs;
+};
+
+// Compiles a whole program (the NODE_BLOCK returned by the parser)
+Proto *compile_program(AstNode *prog);
+
+// Compiles the body of a NODE_FUNC_DEF. The result is cached on the node.
+Proto *compile_function(AstNode *funcdef);
+
+void proto_free(Proto *p);
+
+// Prints a readable listing of the bytecode (luna --dump-bytecode)
+void proto_dump(const Proto *p, FILE *out);
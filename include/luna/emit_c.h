@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Ahead-of-time backend (luna --emit-c). Translates a program into one C++
+// translation unit written in plain C style, to be built against the Luna
+// runtime:
+//
+//   luna --emit-c prog.lu > prog.cpp
+//   c++ -std=c++20 -O2 -Iinclude prog.cpp bin/libluna.a -lm -o prog
+//
+// Statements become straight-line code over the runtime helpers of aot.h,
+// so the program behaves as it does on the interpreter. User functions
+// that only compute on ints and floats also get an unboxed C version,
+// called when all arguments are ints.
+#pragma once
+
+#include <cstdio>
+#include <luna/ast.h>
+
+// Writes the translation of prog, parsed from source read from path
+void emit_c(AstNode *prog, const char *source, const char *path, FILE *out);
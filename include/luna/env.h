@@ -12,6 +12,7 @@ typedef struct Env Env;
 // Scope Management
 Env *env_create(Env *parent);
 void env_free(Env *e);
+Env *env_parent(Env *e);
 
 // Global wrapper helpers (maintained for compatibility)
 Env *env_create_global(void);
@@ -22,6 +23,27 @@ Value *env_get(Env *e, const char *name);
 void env_def(Env *e, const char *name, Value val);
 void env_assign(Env *e, const char *name, Value val);
 
+// Returns the one stored copy of name, valid until exit
+const char *env_intern(const char *name);
+
+// env_get that remembers global variables in cache (see GlobalCache)
+Value *env_get_cached(Env *e, const char *name, GlobalCache *cache);
+size_t env_var_shape(void);
+
+// True when every name e binds is one of the count names and e defines no
+// functions, so a scope binding those names hides everything e holds
+int env_binds_only(Env *e, const char *const *names, int count);
+
+// Slot variables, resolved to (depth, slot) pairs by the compiler.
+// Slot names must come from env_intern.
+Env *env_create_slots(Env *parent, const char *const *names, int count);
+Value *env_slot(Env *e, int depth, int slot);
+void env_def_slot(Env *e, int slot, Value val);
+
+// Number of heap allocations made for scopes so far (see luna --stats)
+size_t env_heap_allocs(void);
+
 // Function Definition Management
 void env_def_func(Env *e, const char *name, AstNode *def);
 AstNode *env_get_func(Env *e, const char *name);
+size_t env_func_epoch(void);
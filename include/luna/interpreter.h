@@ -5,6 +5,29 @@
 #include <luna/value.h>
 #include <luna/env.h> 
 
+// Selects the execution engine. Programs are compiled to bytecode and run on
+// the VM by default; setting this (luna --tree-walk) runs the original AST
+// walker instead so the two can be diffed.
+extern int luna_use_tree_walker;
+
 // Entry point for the interpreter
 // Note: env_create and env_register_stdlib are now in env.h and library.h
-Value interpret(AstNode *program, Env *env); 
\ No newline at end of file
+Value interpret(AstNode *program, Env *env); 
+
+// Semantics shared by the AST walker and the bytecode VM
+constexpr float EPSILON = static_cast<float>(0.000001); // Float == tolerance
+int is_truthy(Value v);
+Value eval_binop(BinOpKind op, Value l, Value r);
+Value sum_values(Value *values, int count);
+int append_sum(Value *var, Value *values, int count);
+void map_store(Value *map, const Value *key, Value value, int line);   // Copies value
+void dense_store(Value *dense, const Value *index, Value value, int line);
+void dense_append(Value *dense, Value value, int line);
+int switch_values_equal(Value val, Value cval);
+CallTarget call_resolve(Env *e, CallNode &call);
+
+// Built-in intrinsics (len, type, int, float)
+Value builtin_len(Value v);
+Value builtin_type(Value v);
+Value builtin_int(Value v);
+Value builtin_float(Value v);
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Baseline JIT for x86-64. A user function that has been called
+// JIT_HOT_CALLS times is compiled to machine code if its body only computes
+// on int and float locals: arithmetic, comparisons, if / while / for and
+// calls to itself. The code is specialized to the argument types of that
+// call and guarded by them; anything else (other types, division by zero,
+// a deep recursion) bails out and the VM runs the call instead.
+#pragma once
+
+#include <luna/ast.h>
+#include <luna/value.h>
+
+#define JIT_HOT_CALLS 4    // Calls before a function is compiled
+#define JIT_MAX_ARGS 8     // Functions with more parameters are not compiled
+
+// Set by luna --no-jit to keep every call on the VM
+extern int luna_no_jit;
+
+// Counts a call of the user function fn and runs it in machine code when it
+// is hot and compiled. Returns 1 with the result in *out; 0 if the caller
+// has to run the call itself. args are only read.
+int jit_call(AstNode *fn, int argc, const Value *args, Value *out);
+
+// Releases the machine code of a function (nullptr is ignored)
+void jit_free(JitCode *code);
@@ -9,4 +9,9 @@
 
 // Registers all built-in native functions (Math, String, Time, Vec) 
 // into the given environment so they can be called from Luna scripts.
-void env_register_stdlib(Env *env);
\ No newline at end of file
+void env_register_stdlib(Env *env);
+
+// True for natives that change their list or map arguments in place (sort,
+// shuffle, remove). They get those variables by reference; all other
+// natives only read their arguments.
+int native_mutates_args(NativeFunc fn);
@@ -5,4 +5,5 @@
 
 // Native Wrappers
 Value lib_list_sort(int argc, Value *argv);
-Value lib_list_shuffle(int argc, Value *argv);
\ No newline at end of file
+Value lib_list_shuffle(int argc, Value *argv);
+Value lib_list_append(int argc, Value *argv);
\ No newline at end of file
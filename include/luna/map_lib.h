@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+#pragma once
+#include <luna/value.h>
+
+// Native Wrappers
+Value lib_map_keys(int argc, Value *argv);
+Value lib_map_values(int argc, Value *argv);
+Value lib_map_has(int argc, Value *argv);
+Value lib_map_remove(int argc, Value *argv);
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Memoization of 'memo func' functions. Each such function keeps a table
+// from argument values to results, bounded by luna_memo_limit entries and
+// evicting the least recently used one. Ints, floats, strings, chars,
+// bools, null and (nested) lists of those can be keys; calls with any other
+// argument run normally. Marking a function 'memo' promises that its result
+// only depends on its arguments: a hit skips the body and its side effects.
+#pragma once
+
+#include <stdio.h>
+#include <luna/ast.h>
+#include <luna/value.h>
+
+#define MEMO_DEFAULT_LIMIT 100000   // Entries kept per function
+
+struct MemoTable;
+
+extern long long luna_memo_limit;   // Set by memo_limit()
+
+// Hash of a call's arguments; keyable is 0 when one of them cannot be a key
+typedef struct
+{
+    unsigned long long hash;
+    int keyable;
+} MemoKey;
+
+// args are the argc values passed to fn; its other parameters are null
+MemoKey memo_key(AstNode *fn, const Value *args, int argc);
+
+// On a hit, stores a copy of the cached result in *out and returns 1
+int memo_lookup(AstNode *fn, MemoKey key, const Value *args, int argc, Value *out);
+
+// Remembers result for the arguments (both are copied)
+void memo_store(AstNode *fn, MemoKey key, const Value *args, int argc, Value result);
+
+void memo_free(MemoTable *table);
+
+// Prints the hit and miss counts of every live table (luna --stats)
+void memo_report(FILE *out);
+
+// Natives: memo_limit(n) sets the bound and returns the previous one;
+// memo_stats("name") returns [hits, misses, entries]
+Value lib_memo_limit(int argc, Value *argv);
+Value lib_memo_stats(int argc, Value *argv);
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Tree-level optimizations applied between parsing and execution.
+#pragma once
+
+#include <luna/ast.h>
+
+// Set by luna --no-opt to run programs exactly as parsed
+extern int luna_no_opt;
+
+// Simplifies a parsed program in place and returns it:
+//  - constant arithmetic, comparisons, && / || and ! are folded
+//  - if / while statements with a constant condition lose their dead code
+//  - identities on integer operands (x + 0, x * 1, ...) are removed
+AstNode *optimize_program(AstNode *prog);
@@ -15,4 +15,7 @@ typedef struct
 
 void parser_init(Parser *p, const char *source);
 void parser_close(Parser *p);
+
+// Returns the program's root, or nullptr after a syntax error. The tree lives
+// in an arena of its own, kept in use for the optimizer and freed by ast_free.
 AstNode *parser_parse_program(Parser *p);
\ No newline at end of file
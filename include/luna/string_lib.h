@@ -9,16 +9,7 @@
 // Helper function for return value carefully 
 inline Value make_string_value(std::string_view sv)
 {
-    char *buf = (char*)malloc(sv.size() + 1);
-    if (!buf) return value_null();
-
-    memcpy(buf, sv.data(), sv.size());
-    buf[sv.size()] = '\0';
-
-    Value v;
-    v.type = VAL_STRING;
-    v.s = buf;
-    return v;
+    return value_string_len(sv.data(), sv.size());
 }
 
 // Basic Inspection
@@ -53,6 +44,7 @@ Value lib_str_pad_right(int argc, Value *argv);         // "Hi", 5, '.' -> "Hi..
 // Lists
 Value lib_str_split(int argc, Value *argv);
 Value lib_str_join(int argc, Value *argv);
+Value lib_str_builder(int argc, Value *argv);          // string_builder(1024) -> ""
 
 // Character Checks
 Value lib_str_is_digit(int argc, Value *argv);
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Scratch memory for data that dies before the statement that made it:
+// operands rendered for a string concatenation, vectors packed for the
+// SIMD kernels, sort buffers. Allocating bumps a pointer and temp_release
+// drops everything allocated since a mark, so marks nest like calls do.
+// Blocks are kept once allocated, so a loop that builds and drops
+// temporaries stops reaching malloc after its first iteration.
+#pragma once
+
+#include <stddef.h>
+
+typedef struct
+{
+    size_t block;   // Index of the block in use
+    size_t used;    // Bytes used in it
+} TempMark;
+
+TempMark temp_mark(void);
+
+// size bytes, 16-byte aligned, valid until the enclosing mark is released
+void *temp_alloc(size_t size);
+
+void temp_release(TempMark mark);
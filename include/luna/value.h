@@ -7,6 +7,52 @@
 
 typedef struct Value Value; // Forward decl
 
+// Strings, lists and maps are shared, reference counted heap objects.
+// Copying a Value only takes another reference; anything that modifies a
+// list or map must first make it unique with value_list_unique or
+// value_map_unique (copy-on-write), so scripts still see plain value
+// semantics. Strings are only modified in place by
+// value_string_append, which does the same for them.
+typedef struct LunaString
+{
+    int refcount;
+    unsigned int hash;  // value_string_hash, 0 until first asked for
+    size_t length;
+    size_t capacity;    // Bytes chars can hold, not counting the NUL
+    char *chars;        // NUL terminated, stored right after the header
+} LunaString;
+
+typedef struct LunaList
+{
+    int refcount;
+    int count;
+    int capacity;
+    Value *items;
+} LunaList;
+
+// Contiguous double buffer behind a VAL_DENSE_LIST
+typedef struct LunaDenseList
+{
+    int refcount;
+    int count;
+    int capacity;
+    double *data;
+} LunaDenseList;
+
+// Hash table behind a VAL_MAP (see map.cpp). Entries are kept in insertion
+// order; the slots find them by key, 16 control bytes at a time.
+typedef struct LunaMap
+{
+    int refcount;
+    int count;          // Keys in the map
+    int used;           // Entries used so far, removed ones included
+    int capacity;       // Entries that fit before the table is rebuilt
+    int slots;          // A power of 2, at least one group
+    unsigned char *ctrl;    // Per slot: 7 bits of the key's hash, or empty/removed
+    int *index;         // Per slot: its entry
+    struct LunaMapEntry *entries;
+} LunaMap;
+
 // Typedef for Native Functions
 typedef Value (*NativeFunc)(int argc, Value *argv);
 
@@ -17,53 +63,126 @@ typedef enum {
     VAL_CHAR,   
     VAL_BOOL,
     VAL_LIST,
-    VAL_DENSE_LIST, // Added for high-performance SIMD/Matrix math
+    VAL_DENSE_LIST, // Unboxed float list for the vector kernels (vec_lib.cpp)
     VAL_NATIVE, 
     VAL_FILE,   // File Handle Type
+    VAL_MAP,
     VAL_NULL
 } ValueType;
 
-// Represents a runtime value in the language
+// Represents a runtime value in the language: a tag and one 8-byte payload,
+// heap objects being pointers to headers that hold their own sizes. That is
+// 16 bytes per value. Building with LUNA_COMPACT_VALUES shrinks the gap
+// after the tag (12 bytes per value, payloads 4-byte aligned), which makes
+// large lists a quarter smaller at the price of unaligned 8-byte loads.
+//
+// A string of up to VALUE_SMALL_MAX bytes is kept in the value itself, from
+// the byte after 'small' through the payload, with no LunaString behind it
+// (unless room was reserved for it to grow). Use value_chars and
+// value_length rather than v.string.
+#ifdef LUNA_COMPACT_VALUES
+#pragma pack(push, 4)
+#define VALUE_GAP 2
+#else
+#define VALUE_GAP 6
+#endif
 struct Value {
-    ValueType type;
+    unsigned char type;     // ValueType
+    unsigned char small;    // VAL_STRING: 1 + length if kept inline, else 0
+    char gap[VALUE_GAP];    // Start of an inline string
     union {
         long long i;   
         double f;       
-        char *s;
+        LunaString *string;
         char c;         
         int b;
         NativeFunc native; 
         FILE *file; // Standard C File Pointer
-        struct {        
-            struct Value *items;
-            int count;
-            int capacity;
-        } list;
-        struct {        // Raw contiguous double buffer
-            double *data; // Speed goes brrrrrrr
-            int count;
-            int capacity;
-        } dlist;
+        LunaList *list;
+        LunaDenseList *dlist; // Raw contiguous double buffer
+        LunaMap *map;
     };
 };
+#ifdef LUNA_COMPACT_VALUES
+#pragma pack(pop)
+#endif
+
+#define VALUE_SMALL_MAX (VALUE_GAP + 8 - 1)     // Leaves room for the NUL
+
+// A key and its value. A removed entry has a null key until the table is
+// rebuilt.
+typedef struct LunaMapEntry
+{
+    Value key;
+    Value value;
+    unsigned int hash;
+} LunaMapEntry;
+
+// Characters of a string value (NUL terminated). For a short string they
+// live inside *v, so the pointer is good only while *v stays where it is.
+static inline char *value_chars(Value *v)
+{
+    return v->small ? (char *)v + 2 : v->string->chars;
+}
+
+static inline const char *value_chars(const Value *v)
+{
+    return v->small ? (const char *)v + 2 : v->string->chars;
+}
+
+// Length in bytes of a string value
+static inline size_t value_length(const Value *v)
+{
+    return v->small ? (size_t)(v->small - 1) : v->string->length;
+}
 
 // Constructors
 Value value_int(long long x); 
 Value value_float(double x);
 Value value_string(const char *s);
+Value value_string_len(const char *s, size_t len);
+Value value_string_alloc(size_t len);   // value_chars()[0..len) left for the caller
 Value value_char(char c); 
 Value value_bool(int b);
 Value value_list(void);
-Value value_dense_list(void); // New constructor for dense arrays
+Value value_dense_list(void);
+Value value_map(void);
 Value value_native(NativeFunc fn); 
 Value value_file(FILE *f); // For file_lib
 Value value_null(void);
 
 // Utils for memory management
-void value_free(Value v);
-Value value_copy(Value v);
+void value_free(Value v);           // Drops a reference
+Value value_copy(Value v);          // Takes a reference (O(1) for strings and lists)
 char *value_to_string(Value v);
+int value_string_equal(const Value *a, const Value *b);
+unsigned int value_string_hash(const Value *v);     // Never 0
+
+// A string equal to chars[0..len) shared with every other interned copy of
+// it, so equal keys and identifiers compare by pointer and hash once.
+// Interned strings live until the program ends.
+Value value_string_intern(const char *chars, size_t len);
+const char *value_temp_string(const Value *v, size_t *len);  // No copy of strings
+void value_string_reserve(Value *s, size_t capacity);  // Also makes *s unshared
+void value_string_append(Value *s, const char *chars, size_t len);
+void value_string_append_value(Value *s, const Value *v);
+void value_list_unique(Value *list);
+void value_list_reserve(Value *list, int capacity);
 void value_list_append(Value *list, Value v); 
-void value_dlist_append(Value *list, double v); // Append to dense list
+void value_dlist_unique(Value *list);
+void value_dlist_resize(Value *list, int count);   // New items are 0.0
+void value_dlist_append(Value *list, double v);
+
+// Makes a list or map unshared so a native can change it in place
+// (see native_mutates_args); returns 0 for other values
+int value_unshare(Value *v);
+
+// Maps take int, string, char and bool keys; lookups of other keys find
+// nothing and value_map_slot refuses them (returns nullptr)
+int value_map_key_ok(const Value *key);
+void value_map_unique(Value *map);
+Value *value_map_find(const Value *map, const Value *key);   // nullptr if missing
+Value *value_map_slot(Value *map, const Value *key);  // Unshares; adds the key (null) if missing
+int value_map_remove(Value *map, const Value *key);   // Unshares; 1 if it was there
 
 #endif
\ No newline at end of file
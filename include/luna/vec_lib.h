@@ -18,5 +18,6 @@ Value lib_vec_sub(int argc, Value *argv);
 Value lib_vec_mul(int argc, Value *argv);
 Value lib_vec_div(int argc, Value *argv);
 Value lib_mat_mul(int argc, Value *argv); // Prototype for native matrix multiplication
+Value lib_dense_list(int argc, Value *argv);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+#pragma once
+#include <luna/bytecode.h>
+#include <luna/env.h>
+#include <luna/value.h>
+
+// Executes a compiled program in the given (usually global) environment
+Value vm_run(Proto *proto, Env *env);
@@ -0,0 +1,412 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Runtime support for translated programs (see aot.h). Every helper mirrors
+// the AST walker's handling of the same node, error messages included.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <vector>
+#include <luna/aot.h>
+#include <luna/library.h>
+#include <luna/math_lib.h>
+#include <luna/memo.h>
+#include <luna/temp.h>
+
+// Holds the function nodes made by aot_function until exit
+static AstArena *aot_arena = nullptr;
+
+Env *aot_start(const char *source, const char *path)
+{
+    // Same start-up as luna itself (see main.cpp)
+    setlocale(LC_ALL, "C");
+    Env *global = env_create_global();
+    env_register_stdlib(global);
+    lib_math_srand(0, NULL);
+    error_init(source, path);
+    aot_arena = ast_arena_create();
+    ast_arena_use(aot_arena);
+    return global;
+}
+
+int aot_finish(Env *global)
+{
+    env_free_global(global);
+    ast_arena_free(aot_arena);
+    aot_arena = nullptr;
+    return 0;
+}
+
+AstNode *aot_function(const char *name, const char *const *params, int count, int memo)
+{
+    NodeList body;
+    nodelist_init(&body);
+    AstNode *n = ast_funcdef(name, const_cast<char **>(params), count, body, 0);
+    n->get<FuncDefNode>().memo = memo;
+    return n;
+}
+
+int aot_param_count(AstNode *fn)
+{
+    return fn->get<FuncDefNode>().param_count;
+}
+
+// Binds the parameters of fn in scope, taking the arguments
+static void aot_bind(Env *scope, AstNode *fn, Value *args, int argc)
+{
+    const FuncDefNode &def = fn->get<FuncDefNode>();
+    for (int i = 0; i < def.param_count; i++)
+    {
+        Value v = i < argc ? args[i] : value_null();
+        env_def(scope, def.params[i], v);
+        value_free(v);
+    }
+}
+
+static Value aot_run(Env *e, AstNode *fn, AotBody body, Value *args, int argc)
+{
+    AotFrame frame;
+    frame.tail_fn = nullptr;
+    Env *scope = env_create(e);
+    aot_bind(scope, fn, args, argc);
+    while (1)
+    {
+        frame.scope = scope;
+        Value ret = body(scope, &frame);
+        if (!frame.tail_fn)
+        {
+            env_free(scope);
+            return ret;
+        }
+
+        // Tail call: the callee takes over this call's scope
+        value_free(ret);
+        fn = frame.tail_fn;
+        body = frame.tail_body;
+        frame.tail_fn = nullptr;
+        env_free(scope);
+        scope = env_create(e);
+        aot_bind(scope, fn, frame.tail_args, frame.tail_argc);
+    }
+}
+
+Value aot_call(Env *e, AstNode *fn, AotBody body, Value *args, int argc)
+{
+    if (!fn->get<FuncDefNode>().memo)
+    {
+        return aot_run(e, fn, body, args, argc);
+    }
+
+    // 'memo func': the arguments are kept to store the result under
+    Value res;
+    MemoKey key = memo_key(fn, args, argc);
+    if (memo_lookup(fn, key, args, argc, &res))
+    {
+        for (int i = 0; i < argc; i++)
+        {
+            value_free(args[i]);
+        }
+        return res;
+    }
+    std::vector<Value> keep(args, args + argc);
+    for (Value &v : keep)
+    {
+        v = value_copy(v);
+    }
+    res = aot_run(e, fn, body, args, argc);
+    memo_store(fn, key, keep.data(), argc, res);
+    for (Value &v : keep)
+    {
+        value_free(v);
+    }
+    return res;
+}
+
+int aot_can_tail(Env *e, AotFrame *frame, AstNode *fn)
+{
+    const FuncDefNode &def = fn->get<FuncDefNode>();
+    if (def.param_count > AOT_TAIL_ARGS || def.memo)
+    {
+        return 0;
+    }
+    for (Env *scope = e; ; scope = env_parent(scope))
+    {
+        if (!env_binds_only(scope, def.params, def.param_count))
+        {
+            return 0;
+        }
+        if (scope == frame->scope)
+        {
+            return 1;
+        }
+    }
+}
+
+Value aot_call_native(NativeFunc fn, Value *args, int argc, unsigned long long borrowed)
+{
+    Value res = fn(argc, args);
+    for (int i = 0; i < argc; i++)
+    {
+        if (i >= 64 || !((borrowed >> i) & 1))
+        {
+            value_free(args[i]);
+        }
+    }
+    return res;
+}
+
+Value aot_get(Env *e, const char *name)
+{
+    Value *v = env_get(e, name);
+    return v ? value_copy(*v) : value_null();
+}
+
+void aot_assign_sum(Env *e, const char *name, Value *values, int count)
+{
+    if (!append_sum(env_get(e, name), values, count))
+    {
+        Value v = sum_values(values, count);
+        env_assign(e, name, v);
+        value_free(v);
+    }
+}
+
+Value aot_binop(BinOpKind op, Value l, Value r)
+{
+    Value res = eval_binop(op, l, r);
+    value_free(l);
+    value_free(r);
+    return res;
+}
+
+Value aot_index(Value target, Value index)
+{
+    Value res = value_null();
+    if (target.type == VAL_LIST && index.type == VAL_INT)
+    {
+        if (index.i >= 0 && index.i < target.list->count)
+        {
+            res = value_copy(target.list->items[index.i]);
+        }
+    }
+    else if (target.type == VAL_MAP)
+    {
+        const Value *item = value_map_find(&target, &index);
+        res = item ? value_copy(*item) : value_null();
+    }
+    else if (target.type == VAL_DENSE_LIST && index.type == VAL_INT)
+    {
+        if (index.i >= 0 && index.i < target.dlist->count)
+        {
+            res = value_float(target.dlist->data[index.i]);
+        }
+    }
+    value_free(target);
+    value_free(index);
+    return res;
+}
+
+Value *aot_index_ref(Value *list, Value index, int line)
+{
+    if (list && list->type == VAL_MAP)
+    {
+        value_map_unique(list);
+        Value *item = value_map_find(list, &index);
+        value_free(index);
+        return item;
+    }
+    if (!list || list->type != VAL_LIST)
+    {
+        value_free(index);
+        return nullptr;
+    }
+    if (index.type != VAL_INT)
+    {
+        value_free(index);
+        return nullptr;
+    }
+    if (index.i < 0 || index.i >= list->list->count)
+    {
+        char msg[128];
+        snprintf
+        (
+            msg,
+            sizeof(msg),
+            "Index %lld is out of bounds for list of length %d",
+            index.i,
+            list->list->count
+        );
+        error_report
+        (
+            ERR_INDEX,
+            line,
+            0,
+            msg,
+            "Check that your index is between 0 and len(list)-1"
+        );
+        return nullptr;
+    }
+    value_list_unique(list);
+    return &list->list->items[index.i];
+}
+
+void aot_assign_index(Value *target, Value index, Value value, int line)
+{
+    if (target && target->type == VAL_MAP)
+    {
+        map_store(target, &index, value, line);
+        value_free(index);
+        value_free(value);
+        return;
+    }
+    if (target && target->type == VAL_DENSE_LIST)
+    {
+        dense_store(target, &index, value, line);
+        value_free(index);
+        value_free(value);
+        return;
+    }
+    if (!target || target->type != VAL_LIST)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Cannot assign to non-list target - target must be a list",
+            "Use list indices only on list variables, e.g., myList[0] = value"
+        );
+        value_free(index);
+        value_free(value);
+        return;
+    }
+    if (index.type != VAL_INT)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "List index must be an integer",
+            "Use integer values for list indices, e.g., myList[0] or myList[i]"
+        );
+        value_free(index);
+        value_free(value);
+        return;
+    }
+    if (index.i < 0 || index.i >= target->list->count)
+    {
+        char msg[128];
+        snprintf
+        (
+            msg,
+            sizeof(msg),
+            "Index %lld is out of bounds for list of length %d",
+            index.i, target->list->count
+        );
+        error_report
+        (
+            ERR_INDEX,
+            line,
+            0,
+            msg,
+            "Ensure your index is between 0 and len(list)-1"
+        );
+        value_free(value);
+        return;
+    }
+
+    value_list_unique(target);
+    Value *slot = &target->list->items[index.i];
+    value_free(*slot);
+    *slot = value;
+}
+
+void aot_append(Value *list, Value value, int line)
+{
+    if (list && list->type == VAL_LIST)
+    {
+        value_list_append(list, value);
+    }
+    else if (list && list->type == VAL_DENSE_LIST)
+    {
+        dense_append(list, value, line);
+    }
+    else if (list && list->type == VAL_STRING)
+    {
+        value_string_append_value(list, &value);
+    }
+    else
+    {
+        error_report
+        (
+            ERR_ARGUMENT,
+            line,
+            0,
+            "append() expects a list variable as the first argument",
+            "Use append(myList, value) where myList is a list variable"
+        );
+    }
+    value_free(value);
+}
+
+Value aot_step(Env *e, const char *name, int delta)
+{
+    Value *v = env_get(e, name);
+    if (v && v->type == VAL_INT)
+    {
+        Value old = *v;
+        v->i += delta;
+        return old;
+    }
+    if (v && v->type == VAL_FLOAT)
+    {
+        Value old = *v;
+        v->f += delta;
+        return old;
+    }
+    return value_null();
+}
+
+void aot_print(Value v)
+{
+    TempMark mark = temp_mark();
+    size_t len;
+    printf("%s ", value_temp_string(&v, &len));
+    temp_release(mark);
+    value_free(v);
+}
+
+Value aot_input(const char *prompt)
+{
+    char buf[256];
+    if (prompt[0])
+    {
+        printf("%s", prompt);
+    }
+    if (fgets(buf, 256, stdin))
+    {
+        buf[strcspn(buf, "\n")] = 0;
+    }
+    else
+    {
+        buf[0] = 0;
+    }
+    return value_string(buf);
+}
+
+Value aot_not(Value v)
+{
+    Value res = value_bool(!is_truthy(v));
+    value_free(v);
+    return res;
+}
+
+int aot_truthy(Value v)
+{
+    int t = is_truthy(v);
+    value_free(v);
+    return t;
+}
@@ -1,10 +1,117 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // Copyright (c) 2025 Bharath
 
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
 // #include <variant>
 #include <type_traits>
+#include <vector>
 #include <luna/ast.h>
+#include <luna/bytecode.h>
+#include <luna/jit.h>
+#include <luna/memo.h>
+
+#define ARENA_BLOCK (64 * 1024)     // Bytes per block of an arena
+
+// Nodes have no destructors to run: a tree goes away with its arena
+static_assert(std::is_trivially_destructible_v<AstNode>);
+
+struct AstArena
+{
+    char *next;                     // Free space in the newest block
+    char *end;
+    std::vector<char *> blocks;
+    std::vector<AstNode *> funcs;   // Function definitions made in the arena
+};
+
+// Where the constructors allocate
+static AstArena *current_arena = nullptr;
+
+AstArena *ast_arena_create(void)
+{
+    AstArena *a = new AstArena();
+    a->next = a->end = nullptr;
+    return a;
+}
+
+void ast_arena_use(AstArena *arena)
+{
+    current_arena = arena;
+}
+
+void ast_arena_free(AstArena *a)
+{
+    if (!a)
+    {
+        return;
+    }
+    for (AstNode *n : a->funcs)
+    {
+        FuncDefNode &def = n->get<FuncDefNode>();
+        proto_free(def.proto);
+        jit_free(def.jit);
+        memo_free(def.memo_table);
+    }
+    for (char *block : a->blocks)
+    {
+        free(block);
+    }
+    if (current_arena == a)
+    {
+        current_arena = nullptr;
+    }
+    delete a;
+}
+
+static void *arena_alloc(size_t size, size_t align)
+{
+    AstArena *a = current_arena;
+    uintptr_t at = ((uintptr_t)a->next + align - 1) & ~(uintptr_t)(align - 1);
+    if (!a->next || at + size > (uintptr_t)a->end)
+    {
+        // Oversized requests get a block of their own
+        size_t bytes = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+        char *block = (char *)malloc(bytes);
+        a->blocks.push_back(block);
+        a->end = block + bytes;
+        at = (uintptr_t)block;
+    }
+    a->next = (char *)(at + size);
+    return (void *)at;
+}
+
+static const char *arena_text(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *copy = (char *)arena_alloc(n, 1);
+    memcpy(copy, s, n);
+    return copy;
+}
+
+// Moves a list built on the heap into the arena
+static NodeList arena_list(NodeList l)
+{
+    if (l.capacity == 0)
+    {
+        return l;
+    }
+    AstNode **items = nullptr;
+    if (l.count > 0)
+    {
+        items = (AstNode **)arena_alloc(sizeof(AstNode *) * l.count, alignof(AstNode *));
+        memcpy(items, l.items, sizeof(AstNode *) * l.count);
+    }
+    free(l.items);
+    return NodeList{ items, l.count, 0 };
+}
+
+static AstNode *make(NodeKind kind, int line, AstPayload data)
+{
+    return new (arena_alloc(sizeof(AstNode), alignof(AstNode))) AstNode(kind, line, std::move(data));
+}
 
 // NodeList management
 void nodelist_init(NodeList *l)
@@ -18,23 +125,32 @@ void nodelist_push(NodeList *l, AstNode *n)
 {
     if (l->count >= l->capacity)
     {
-        int nc = (l->capacity == 0) ? 4 : l->capacity * 2;
-        l->items = (AstNode **)realloc(l->items, sizeof(AstNode *) * nc);
+        // Items already in an arena are copied back to the heap
+        int nc = (l->capacity == 0) ? (l->count < 2 ? 4 : l->count * 2) : l->capacity * 2;
+        AstNode **items = (AstNode **)malloc(sizeof(AstNode *) * nc);
+        if (l->count > 0)
+        {
+            memcpy(items, l->items, sizeof(AstNode *) * l->count);
+        }
+        if (l->capacity > 0)
+        {
+            free(l->items);
+        }
+        l->items = items;
         l->capacity = nc;
     }
     l->items[l->count++] = n;
 }
 
+// Frees a list that was never given to a node (its nodes stay in the arena)
 void nodelist_free(NodeList *l)
 {
     if (!l) return;
 
-    for (int i = 0; i < l->count; i++)
+    if (l->capacity > 0)
     {
-        ast_free(l->items[i]);
+        free(l->items);
     }
-
-    free(l->items);
     l->items = nullptr;
     l->count = 0;
     l->capacity = 0;
@@ -46,153 +162,207 @@ void nodelist_free(NodeList *l)
 
 AstNode *ast_number(long long v, int line)
 {
-    return new AstNode(NODE_NUMBER, line, NumberNode{v});
+    return make(NODE_NUMBER, line, NumberNode{v});
 }
 
 AstNode *ast_float(double v, int line)
 {
-    return new AstNode(NODE_FLOAT, line, FloatNode{v});
+    return make(NODE_FLOAT, line, FloatNode{v});
 }
 
 AstNode *ast_string(const char *s, int line)
 {
-    return new AstNode(NODE_STRING, line, StringNode{s ? s : ""});
+    return make(NODE_STRING, line, StringNode{arena_text(s ? s : "")});
 }
 
 AstNode *ast_char(char c, int line)
 {
-    return new AstNode(NODE_CHAR, line, CharNode{c});
+    return make(NODE_CHAR, line, CharNode{c});
 }
 
 AstNode *ast_bool(int v, int line)
 {
-    return new AstNode(NODE_BOOL, line, BoolNode{(bool)v});
+    return make(NODE_BOOL, line, BoolNode{(bool)v});
 }
 
 AstNode *ast_list(NodeList items, int line)
 {
-    return new AstNode(NODE_LIST, line, ListNode{items});
+    return make(NODE_LIST, line, ListNode{arena_list(items)});
+}
+
+AstNode *ast_map(NodeList items, int line)
+{
+    return make(NODE_MAP, line, MapNode{arena_list(items)});
 }
 
 AstNode *ast_ident(const char *name, int line)
 {
-    return new AstNode(NODE_IDENT, line, IdentNode{name});
+    return make(NODE_IDENT, line, IdentNode{arena_text(name)});
 }
 
 AstNode *ast_inc(const char *name, int line)
 {
-    return new AstNode(NODE_INC, line, IncNode{name});
+    return make(NODE_INC, line, IncNode{arena_text(name)});
 }
 
 AstNode *ast_dec(const char *name, int line)
 {
-    return new AstNode(NODE_DEC, line, DecNode{name});
+    return make(NODE_DEC, line, DecNode{arena_text(name)});
 }
 
 AstNode *ast_binop(BinOpKind op, AstNode *l, AstNode *r, int line)
 {
-    return new AstNode(NODE_BINOP, line, BinOpNode{op, l, r});
+    return make(NODE_BINOP, line, BinOpNode{op, l, r});
 }
 
 AstNode *ast_let(const char *name, AstNode *expr, int line)
 {
-    return new AstNode(NODE_LET, line, LetNode{name, expr});
+    return make(NODE_LET, line, LetNode{arena_text(name), expr});
 }
 
 AstNode *ast_assign(const char *name, AstNode *expr, int line)
 {
-    return new AstNode(NODE_ASSIGN, line, AssignNode{name, expr});
+    return make(NODE_ASSIGN, line, AssignNode{arena_text(name), expr});
 }
 
 AstNode *ast_print(NodeList args, int line)
 {
-    return new AstNode(NODE_PRINT, line, PrintNode{args});
+    return make(NODE_PRINT, line, PrintNode{arena_list(args)});
 }
 
 AstNode *ast_input(const char *prompt, int line)
 {
-    return new AstNode(NODE_INPUT, line, InputNode{prompt ? prompt : ""});
+    return make(NODE_INPUT, line, InputNode{arena_text(prompt ? prompt : "")});
 }
 
 AstNode *ast_if(AstNode *cond, NodeList then_b, NodeList else_b, int line)
 {
-    return new AstNode(NODE_IF, line, IfNode{cond, then_b, else_b});
+    return make(NODE_IF, line, IfNode{cond, arena_list(then_b), arena_list(else_b)});
 }
 
 AstNode *ast_while(AstNode *cond, NodeList body, int line)
 {
-    return new AstNode(NODE_WHILE, line, WhileNode{cond, body});
+    return make(NODE_WHILE, line, WhileNode{cond, arena_list(body)});
 }
 
 AstNode *ast_for(AstNode *init, AstNode *cond, AstNode *incr, NodeList body, int line)
 {
-    return new AstNode(NODE_FOR, line, ForNode{init, cond, incr, body});
+    return make(NODE_FOR, line, ForNode{init, cond, incr, arena_list(body)});
 }
 
 AstNode *ast_break(int line)
 {
-	return new AstNode(NODE_BREAK, line, BreakNode{});
+	return make(NODE_BREAK, line, BreakNode{});
 }
 
 AstNode *ast_continue(int line)
 {
-	return new AstNode(NODE_CONTINUE, line, ContinueNode{});
+	return make(NODE_CONTINUE, line, ContinueNode{});
 }
 
 AstNode *ast_group(NodeList items, int line)
 {
-    return new AstNode(NODE_GROUP, line, BlockNode{items});
+    return make(NODE_GROUP, line, BlockNode{arena_list(items)});
 }
 
 AstNode *ast_switch(AstNode *expr, NodeList cases, NodeList def, int line)
 {
-    return new AstNode(NODE_SWITCH, line, SwitchNode{expr, cases, def});
+    return make(NODE_SWITCH, line, SwitchNode{expr, arena_list(cases), arena_list(def)});
 }
 
 AstNode *ast_case(AstNode *value, NodeList body, int line)
 {
-    return new AstNode(NODE_CASE, line, CaseNode{value, body});
+    return make(NODE_CASE, line, CaseNode{value, arena_list(body)});
 }
 
 AstNode *ast_block(NodeList items, int line)
 {
-    return new AstNode(NODE_BLOCK, line, BlockNode{items});
+    return make(NODE_BLOCK, line, BlockNode{arena_list(items)});
+}
+
+AstNode *ast_program(NodeList items, AstArena *arena, int line)
+{
+    AstNode *n = ast_block(items, line);
+    n->get<BlockNode>().arena = arena;
+    return n;
+}
+
+// append() is always the intrinsic; the others only with one argument
+static Intrinsic intrinsic_for(const char *name, int argc)
+{
+    if (!strcmp(name, "append"))
+    {
+        return INTRINSIC_APPEND;
+    }
+    if (argc != 1)
+    {
+        return INTRINSIC_NONE;
+    }
+    if (!strcmp(name, "len"))
+    {
+        return INTRINSIC_LEN;
+    }
+    if (!strcmp(name, "type"))
+    {
+        return INTRINSIC_TYPE;
+    }
+    if (!strcmp(name, "int"))
+    {
+        return INTRINSIC_INT;
+    }
+    if (!strcmp(name, "float"))
+    {
+        return INTRINSIC_FLOAT;
+    }
+    return INTRINSIC_NONE;
 }
 
 AstNode *ast_call(const char *name, NodeList args, int line)
 {
-    return new AstNode(NODE_CALL, line, CallNode{name, args});
+    CallNode call{arena_text(name), arena_list(args)};
+    call.intrinsic = intrinsic_for(name, args.count);
+
+    // An argument can be borrowed from its variable only if evaluating the
+    // arguments after it cannot change that variable
+    call.pure_tail = args.count;
+    while (call.pure_tail > 0 && ast_is_pure(call.args.items[call.pure_tail - 1]))
+    {
+        call.pure_tail--;
+    }
+    return make(NODE_CALL, line, std::move(call));
 }
 
 AstNode *ast_index(AstNode *target, AstNode *index, int line)
 {
-    return new AstNode(NODE_INDEX, line, IndexNode{target, index});
+    return make(NODE_INDEX, line, IndexNode{target, index});
 }
 
 AstNode *ast_funcdef(const char *name, char **params, int count, NodeList body, int line)
 {
-    std::vector<std::string> p;
+    const char **p = (const char **)arena_alloc(sizeof(char *) * (count > 0 ? count : 1), alignof(char *));
     for (int i = 0; i < count; i++)
     {
-        p.emplace_back(params[i]);
+        p[i] = arena_text(params[i]);
     }
 
-    return new AstNode
+    AstNode *n = make
     (
         NODE_FUNC_DEF,
         line,
-        FuncDefNode{name, std::move(p), body}
+        FuncDefNode{arena_text(name), p, count, arena_list(body)}
     );
+    current_arena->funcs.push_back(n);
+    return n;
 }
 
 AstNode *ast_return(AstNode *expr, int line)
 {
-    return new AstNode(NODE_RETURN, line, ReturnNode{expr});
+    return make(NODE_RETURN, line, ReturnNode{expr});
 }
 
 AstNode *ast_assign_index(AstNode *list, AstNode *index, AstNode *value, int line)
 {
-    return new AstNode
+    return make
     (
         NODE_ASSIGN_INDEX,
         line,
@@ -202,98 +372,293 @@ AstNode *ast_assign_index(AstNode *list, AstNode *index, AstNode *value, int lin
 
 AstNode *ast_not(AstNode *expr, int line)
 {
-    return new AstNode(NODE_NOT, line, NotNode{expr});
+    return make(NODE_NOT, line, NotNode{expr});
 }
 
 void ast_free(AstNode *n)
 {
     if (!n) return;
-    
-    std::visit
-    (
-        [&](auto &node)
+
+    if (n->kind == NODE_BLOCK)
+    {
+        ast_arena_free(n->get<BlockNode>().arena);
+    }
+}
+
+// True when evaluating the expression n cannot change any variable
+int ast_is_pure(AstNode *n)
+{
+    if (!n)
+    {
+        return 1;
+    }
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+    case NODE_FLOAT:
+    case NODE_STRING:
+    case NODE_CHAR:
+    case NODE_BOOL:
+    case NODE_IDENT:
+        return 1;
+    case NODE_BINOP:
+        return ast_is_pure(n->get<BinOpNode>().left) && ast_is_pure(n->get<BinOpNode>().right);
+    case NODE_NOT:
+        return ast_is_pure(n->get<NotNode>().expr);
+    case NODE_INDEX:
+        return ast_is_pure(n->get<IndexNode>().target) && ast_is_pure(n->get<IndexNode>().index);
+    case NODE_LIST:
+    case NODE_MAP:
+    {
+        NodeList &items = n->kind == NODE_LIST ? n->get<ListNode>().items : n->get<MapNode>().items;
+        for (int i = 0; i < items.count; i++)
         {
-            using T = std::decay_t<decltype(node)>;
-            if constexpr (std::is_same_v<T, BinOpNode>) 
+            if (!ast_is_pure(items.items[i]))
             {
-                ast_free(node.left);
-                ast_free(node.right);
+                return 0;
             }
-            else if constexpr 
-            (
-                std::is_same_v<T, LetNode> ||
-                std::is_same_v<T, AssignNode>
-            ) 
-            {
-                ast_free(node.expr);
-            }
-            else if constexpr (std::is_same_v<T, IfNode>) 
-            {
-                ast_free(node.cond);
-                nodelist_free(&node.then_block);
-                nodelist_free(&node.else_block);
-            }
-            else if constexpr (std::is_same_v<T, WhileNode>) 
-            {
-                ast_free(node.cond);
-                nodelist_free(&node.body);
-            }
-            else if constexpr (std::is_same_v<T, ForNode>) 
-            {
-                ast_free(node.init);
-                ast_free(node.cond);
-                ast_free(node.incr);
-                nodelist_free(&node.body);
-            }
-            else if constexpr (std::is_same_v<T, SwitchNode>) 
-            {
-                ast_free(node.expr);
-                nodelist_free(&node.cases);
-                nodelist_free(&node.default_case);
-            }
-            else if constexpr (std::is_same_v<T, CaseNode>) 
-            {
-                ast_free(node.value);
-                nodelist_free(&node.body);
-            }
-            else if constexpr (std::is_same_v<T, BlockNode>) 
-            {
-                nodelist_free(&node.items);
-            }
-            else if constexpr (std::is_same_v<T, CallNode>) 
-            {
-                nodelist_free(&node.args);
-            }
-            else if constexpr (std::is_same_v<T, FuncDefNode>) 
-            {
-                nodelist_free(&node.body);
-            }
-            else if constexpr (std::is_same_v<T, ReturnNode>) 
-            {
-                ast_free(node.expr);
-            }
-            else if constexpr (std::is_same_v<T, AssignIndexNode>) 
-            {
-                ast_free(node.list);
-                ast_free(node.index);
-                ast_free(node.value);
-            }
-            else if constexpr (std::is_same_v<T, NotNode>) 
-            {
-                ast_free(node.expr);
-            } 
-
-            else if constexpr
-            (
-                std::is_same_v<T, BreakNode> || 
-                std::is_same_v<T, ContinueNode>
-            )
-            {
-                // TODO
-            }
-        }, 
-        n->data
-    );
+        }
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+int ast_sum_operands(AstNode *n, AstNode **operands, int max)
+{
+    int first = max;
+    while (first > 1 && n->kind == NODE_BINOP && n->get<BinOpNode>().op == OP_ADD)
+    {
+        operands[--first] = n->get<BinOpNode>().right;
+        n = n->get<BinOpNode>().left;
+    }
+    operands[--first] = n;
+    memmove(operands, operands + first, sizeof(AstNode *) * (max - first));
+    return max - first;
+}
+
+int ast_self_append(AstNode *assign, AstNode **operands)
+{
+    AssignNode &node = assign->get<AssignNode>();
+    if (!node.expr)
+    {
+        return 0;
+    }
+    int count = ast_sum_operands(node.expr, operands, SUM_MAX_OPERANDS);
+    if (count < 2 || operands[0]->kind != NODE_IDENT || strcmp(operands[0]->get<IdentNode>().name, node.name) != 0)
+    {
+        return 0;
+    }
+    return count;
+}
 
-    delete n;
-}
\ No newline at end of file
+static const char *binop_name(BinOpKind op)
+{
+    switch (op)
+    {
+    case OP_ADD: return "+";
+    case OP_SUB: return "-";
+    case OP_MUL: return "*";
+    case OP_DIV: return "/";
+    case OP_MOD: return "%";
+    case OP_EQ:  return "==";
+    case OP_NEQ: return "!=";
+    case OP_LT:  return "<";
+    case OP_GT:  return ">";
+    case OP_LTE: return "<=";
+    case OP_GTE: return ">=";
+    case OP_AND: return "&&";
+    case OP_OR:  return "||";
+    }
+    return "?";
+}
+
+static void dump_node(AstNode *n, FILE *out, int depth);
+
+static void dump_label(const char *label, FILE *out, int depth)
+{
+    fprintf(out, "%*s%s\n", depth * 2, "", label);
+}
+
+static void dump_list(NodeList *l, FILE *out, int depth)
+{
+    for (int i = 0; i < l->count; i++)
+    {
+        dump_node(l->items[i], out, depth);
+    }
+}
+
+static void dump_node(AstNode *n, FILE *out, int depth)
+{
+    if (!n)
+    {
+        return;
+    }
+    fprintf(out, "%*s", depth * 2, "");
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        fprintf(out, "number %lld\n", n->get<NumberNode>().value);
+        break;
+    case NODE_FLOAT:
+        fprintf(out, "float %g\n", n->get<FloatNode>().value);
+        break;
+    case NODE_STRING:
+        fprintf(out, "string \"%s\"\n", n->get<StringNode>().text);
+        break;
+    case NODE_CHAR:
+        fprintf(out, "char '%c'\n", n->get<CharNode>().value);
+        break;
+    case NODE_BOOL:
+        fprintf(out, "bool %s\n", n->get<BoolNode>().value ? "true" : "false");
+        break;
+    case NODE_LIST:
+        fprintf(out, "list\n");
+        dump_list(&n->get<ListNode>().items, out, depth + 1);
+        break;
+    case NODE_MAP:
+        fprintf(out, "map\n");
+        dump_list(&n->get<MapNode>().items, out, depth + 1);
+        break;
+    case NODE_IDENT:
+        fprintf(out, "ident %s\n", n->get<IdentNode>().name);
+        break;
+    case NODE_INC:
+        fprintf(out, "inc %s\n", n->get<IncNode>().name);
+        break;
+    case NODE_DEC:
+        fprintf(out, "dec %s\n", n->get<DecNode>().name);
+        break;
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        fprintf(out, "binop %s\n", binop_name(binop.op));
+        dump_node(binop.left, out, depth + 1);
+        dump_node(binop.right, out, depth + 1);
+        break;
+    }
+    case NODE_LET:
+        fprintf(out, "let %s\n", n->get<LetNode>().name);
+        dump_node(n->get<LetNode>().expr, out, depth + 1);
+        break;
+    case NODE_ASSIGN:
+        fprintf(out, "assign %s\n", n->get<AssignNode>().name);
+        dump_node(n->get<AssignNode>().expr, out, depth + 1);
+        break;
+    case NODE_ASSIGN_INDEX:
+    {
+        AssignIndexNode &node = n->get<AssignIndexNode>();
+        fprintf(out, "assign_index\n");
+        dump_node(node.list, out, depth + 1);
+        dump_node(node.index, out, depth + 1);
+        dump_node(node.value, out, depth + 1);
+        break;
+    }
+    case NODE_INDEX:
+        fprintf(out, "index\n");
+        dump_node(n->get<IndexNode>().target, out, depth + 1);
+        dump_node(n->get<IndexNode>().index, out, depth + 1);
+        break;
+    case NODE_NOT:
+        fprintf(out, "not\n");
+        dump_node(n->get<NotNode>().expr, out, depth + 1);
+        break;
+    case NODE_PRINT:
+        fprintf(out, "print\n");
+        dump_list(&n->get<PrintNode>().args, out, depth + 1);
+        break;
+    case NODE_INPUT:
+        fprintf(out, "input \"%s\"\n", n->get<InputNode>().prompt);
+        break;
+    case NODE_BREAK:
+        fprintf(out, "break\n");
+        break;
+    case NODE_CONTINUE:
+        fprintf(out, "continue\n");
+        break;
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        fprintf(out, "if\n");
+        dump_node(node.cond, out, depth + 1);
+        dump_label("then", out, depth);
+        dump_list(&node.then_block, out, depth + 1);
+        if (node.else_block.count > 0)
+        {
+            dump_label("else", out, depth);
+            dump_list(&node.else_block, out, depth + 1);
+        }
+        break;
+    }
+    case NODE_WHILE:
+        fprintf(out, "while\n");
+        dump_node(n->get<WhileNode>().cond, out, depth + 1);
+        dump_label("do", out, depth);
+        dump_list(&n->get<WhileNode>().body, out, depth + 1);
+        break;
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+        fprintf(out, "for\n");
+        dump_node(node.init, out, depth + 1);
+        dump_node(node.cond, out, depth + 1);
+        dump_node(node.incr, out, depth + 1);
+        dump_label("do", out, depth);
+        dump_list(&node.body, out, depth + 1);
+        break;
+    }
+    case NODE_SWITCH:
+    {
+        SwitchNode &node = n->get<SwitchNode>();
+        fprintf(out, "switch\n");
+        dump_node(node.expr, out, depth + 1);
+        dump_list(&node.cases, out, depth + 1);
+        if (node.default_case.count > 0)
+        {
+            dump_label("default", out, depth + 1);
+            dump_list(&node.default_case, out, depth + 2);
+        }
+        break;
+    }
+    case NODE_CASE:
+        fprintf(out, "case\n");
+        dump_node(n->get<CaseNode>().value, out, depth + 1);
+        dump_list(&n->get<CaseNode>().body, out, depth + 1);
+        break;
+    case NODE_BLOCK:
+        fprintf(out, "block\n");
+        dump_list(&n->get<BlockNode>().items, out, depth + 1);
+        break;
+    case NODE_GROUP:
+        fprintf(out, "group\n");
+        dump_list(&n->get<BlockNode>().items, out, depth + 1);
+        break;
+    case NODE_CALL:
+        fprintf(out, "call %s\n", n->get<CallNode>().name);
+        dump_list(&n->get<CallNode>().args, out, depth + 1);
+        break;
+    case NODE_FUNC_DEF:
+    {
+        FuncDefNode &node = n->get<FuncDefNode>();
+        fprintf(out, "%sfunc %s(", node.memo ? "memo " : "", node.name);
+        for (int i = 0; i < node.param_count; i++)
+        {
+            fprintf(out, "%s%s", i ? ", " : "", node.params[i]);
+        }
+        fprintf(out, ")\n");
+        dump_list(&node.body, out, depth + 1);
+        break;
+    }
+    case NODE_RETURN:
+        fprintf(out, "return\n");
+        dump_node(n->get<ReturnNode>().expr, out, depth + 1);
+        break;
+    }
+}
+
+// Prints the tree under n, one node per line, indented by depth
+void ast_dump(AstNode *n, FILE *out)
+{
+    dump_node(n, out, 0);
+}
@@ -0,0 +1,1154 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Lowers the AST into register bytecode for the VM (see bytecode.h).
+// The generated code must behave exactly like the AST walker in
+// interpreter.cpp, which is kept as the reference implementation
+// (luna --tree-walk) so the two can be diffed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <luna/bytecode.h>
+#include <luna/ast.h>
+#include <luna/value.h>
+#include <luna/env.h>
+#include <luna/mystr.h>
+
+// A loop or switch that 'break' / 'continue' can leave
+struct Breakable
+{
+    int is_switch;
+    int scope_depth;            // Block scopes open outside the construct
+    int value_reg;              // Switch value register (freed on exit)
+    std::vector<int> breaks;    // Jumps patched to the exit
+    std::vector<int> continues; // Jumps patched to the continue target
+};
+
+struct Compiler
+{
+    Proto *p;
+    int top;                    // First free register
+    int line;                   // Line of the node being compiled
+    int scope_depth;            // Block scopes opened by this proto
+    int in_function;
+    std::vector<int> scopes;    // Layout of each open slot scope, innermost last
+    std::vector<Breakable> targets;
+    std::unordered_map<std::string, int> const_index;
+};
+
+static void compile_stmt(Compiler *c, AstNode *n);
+static void compile_expr(Compiler *c, AstNode *n, int dst);
+
+static void check_operand(long v, const char *what)
+{
+    if (v < 0 || v > UINT16_MAX)
+    {
+        fprintf(stderr, "Compile Error: too many %s in one function\n", what);
+        exit(1);
+    }
+}
+
+static int emit(Compiler *c, int op, int a, int b, int cc)
+{
+    Instr in;
+    in.op = (uint8_t)op;
+    in.misses = 0;
+    in.a = (uint16_t)a;
+    in.b = (uint16_t)b;
+    in.c = (uint16_t)cc;
+    c->p->code.push_back(in);
+    c->p->lines.push_back(c->line);
+    return (int)c->p->code.size() - 1;
+}
+
+static int here(Compiler *c)
+{
+    return (int)c->p->code.size();
+}
+
+// Emits a jump whose target is filled in later by patch_jump
+static int emit_jump(Compiler *c, int op, int a)
+{
+    return emit(c, op, a, 0, 0);
+}
+
+static void patch_jump(Compiler *c, int at, int target)
+{
+    c->p->code[at].b = (uint16_t)(target & 0xFFFF);
+    c->p->code[at].c = (uint16_t)((uint32_t)target >> 16);
+}
+
+static int alloc_reg(Compiler *c)
+{
+    int r = c->top++;
+    check_operand(r, "registers");
+    if (c->top > c->p->nregs)
+    {
+        c->p->nregs = c->top;
+    }
+    return r;
+}
+
+// Registers are released in stack order
+static void release_regs(Compiler *c, int first)
+{
+    c->top = first;
+}
+
+// Interns a constant, sharing identical strings and numbers
+static int add_const(Compiler *c, Value v)
+{
+    std::string key(1, (char)v.type);
+    switch (v.type)
+    {
+    case VAL_STRING:
+        key += value_chars(&v);
+        break;
+    case VAL_INT:
+        key.append((const char *)&v.i, sizeof(v.i));
+        break;
+    case VAL_FLOAT:
+        key.append((const char *)&v.f, sizeof(v.f));
+        break;
+    case VAL_CHAR:
+        key += v.c;
+        break;
+    case VAL_BOOL:
+        key += (char)v.b;
+        break;
+    default:
+        break;
+    }
+
+    auto it = c->const_index.find(key);
+    if (it != c->const_index.end())
+    {
+        value_free(v);
+        return it->second;
+    }
+
+    int idx = (int)c->p->consts.size();
+    check_operand(idx, "constants");
+    c->p->consts.push_back(v);
+    c->const_index.emplace(key, idx);
+    return idx;
+}
+
+static int name_const(Compiler *c, const std::string &name)
+{
+    return add_const(c, value_string_intern(name.data(), name.size()));
+}
+
+// Finds the slot of a name declared so far in the open scopes of this
+// function. Returns 0 for names that must be looked up dynamically.
+static int resolve_local(Compiler *c, const std::string &name, int *depth, int *slot)
+{
+    for (int i = (int)c->scopes.size() - 1; i >= 0; i--)
+    {
+        ScopeLayout &layout = c->p->scopes[c->scopes[i]];
+        for (int k = (int)layout.size() - 1; k >= 0; k--)
+        {
+            if (name == layout[k])
+            {
+                *depth = (int)c->scopes.size() - 1 - i;
+                *slot = k;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Gives a name a slot in the innermost scope. Top level names are globals
+// and stay dynamic (returns -1) so the REPL and natives can see them.
+static int declare_local(Compiler *c, const std::string &name)
+{
+    if (c->scopes.empty())
+    {
+        return -1;
+    }
+    ScopeLayout &layout = c->p->scopes[c->scopes.back()];
+    for (size_t k = 0; k < layout.size(); k++)
+    {
+        if (name == layout[k])
+        {
+            return (int)k;
+        }
+    }
+    check_operand((long)layout.size(), "variables in one scope");
+    layout.push_back(env_intern(name.c_str()));
+    return (int)layout.size() - 1;
+}
+
+static int add_scope(Compiler *c)
+{
+    int idx = (int)c->p->scopes.size();
+    check_operand(idx, "scopes");
+    c->p->scopes.push_back(ScopeLayout());
+    return idx;
+}
+
+// Gives a named variable access its own global cache
+static int add_global_cache(Compiler *c)
+{
+    int idx = (int)c->p->globals.size();
+    check_operand(idx, "variable names");
+    c->p->globals.push_back(GlobalCache());
+    return idx;
+}
+
+static int var_ref(Compiler *c, const std::string &name)
+{
+    VarRef ref;
+    int depth = 0, slot = -1;
+    ref.name = (uint16_t)name_const(c, name);
+    if (!resolve_local(c, name, &depth, &slot))
+    {
+        slot = -1;
+    }
+    ref.slot = (int16_t)slot;
+    ref.depth = (uint16_t)depth;
+    ref.cache = (uint16_t)(slot < 0 ? add_global_cache(c) : 0);
+    int idx = (int)c->p->refs.size();
+    check_operand(idx, "variable references");
+    c->p->refs.push_back(ref);
+    return idx;
+}
+
+// Emits an access to a variable: the slot form when it resolves, the named
+// form otherwise
+static void emit_var(Compiler *c, int named_op, int local_op, int a, const std::string &name)
+{
+    int depth, slot;
+    if (resolve_local(c, name, &depth, &slot))
+    {
+        emit(c, local_op, a, slot, depth);
+    }
+    else
+    {
+        emit(c, named_op, a, name_const(c, name), add_global_cache(c));
+    }
+}
+
+// True when running the statements may define a name in the enclosing scope.
+// Blocks that never declare anything do not need a scope of their own.
+static int declares_names(AstNode *n)
+{
+    if (!n)
+    {
+        return 0;
+    }
+    if (n->kind == NODE_LET || n->kind == NODE_FUNC_DEF)
+    {
+        return 1;
+    }
+    if (n->kind == NODE_GROUP)
+    {
+        NodeList &items = n->get<BlockNode>().items;
+        for (int i = 0; i < items.count; i++)
+        {
+            if (declares_names(items.items[i]))
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int list_declares_names(NodeList *list)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        if (declares_names(list->items[i]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void push_scope(Compiler *c)
+{
+    int layout = add_scope(c);
+    emit(c, BC_PUSHSCOPE, layout, 0, 0);
+    c->scopes.push_back(layout);
+    c->scope_depth++;
+}
+
+static void pop_scope(Compiler *c)
+{
+    emit(c, BC_POPSCOPE, 0, 0, 0);
+    c->scopes.pop_back();
+    c->scope_depth--;
+}
+
+// Compiles a statement list, in a fresh scope when 'scoped' is set
+static void compile_block(Compiler *c, NodeList *list, int scoped)
+{
+    int needs_scope = scoped && list_declares_names(list);
+    if (needs_scope)
+    {
+        push_scope(c);
+    }
+    for (int i = 0; i < list->count; i++)
+    {
+        compile_stmt(c, list->items[i]);
+    }
+    if (needs_scope)
+    {
+        pop_scope(c);
+    }
+}
+
+// Expressions
+
+// Collects the index expressions of a chain like a[i][j] (innermost first)
+// and returns the identifier at its root, or nullptr if there is none.
+static AstNode *index_chain(AstNode *n, std::vector<AstNode*> &indices)
+{
+    if (n->kind == NODE_IDENT)
+    {
+        return n;
+    }
+    if (n->kind == NODE_INDEX)
+    {
+        IndexNode &idx = n->get<IndexNode>();
+        AstNode *root = index_chain(idx.target, indices);
+        indices.push_back(idx.index);
+        return root;
+    }
+    return nullptr;
+}
+
+// Reads an index chain rooted at a variable (BC_INDEXVAR, BC_LENVAR) without
+// copying the lists along the way. The indices go in the registers after
+// dst, so dst must be the last one allocated, and they are evaluated before
+// the variable is read, so they must not be able to change it.
+static int compile_var_read(Compiler *c, AstNode *n, int dst, int op)
+{
+    std::vector<AstNode*> indices;
+    AstNode *root = index_chain(n, indices);
+    if (!root || dst != c->top - 1)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (!ast_is_pure(indices[i]))
+        {
+            return 0;
+        }
+    }
+
+    int line = c->line;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        compile_expr(c, indices[i], alloc_reg(c));
+    }
+    c->line = line;
+    int ref = var_ref(c, root->get<IdentNode>().name);
+    emit(c, op, dst, ref, (int)indices.size());
+    release_regs(c, dst + 1);
+    return 1;
+}
+
+// append(list, value): the list is updated in place through its variable
+static void compile_append(Compiler *c, CallNode &call, int dst)
+{
+    if (call.args.count != 2)
+    {
+        emit(c, BC_APPEND_ARGC, 0, 0, 0);
+        emit(c, BC_LOADNULL, dst, 0, 0);
+        return;
+    }
+
+    std::vector<AstNode*> indices;
+    AstNode *root = index_chain(call.args.items[0], indices);
+
+    int item = alloc_reg(c);
+    if (!root)
+    {
+        compile_expr(c, call.args.items[1], item);
+        emit(c, BC_BADTARGET, item, 0, 1);
+    }
+    else
+    {
+        // Index expressions are evaluated before the appended value
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            compile_expr(c, indices[i], alloc_reg(c));
+        }
+        compile_expr(c, call.args.items[1], item);
+        int ref = var_ref(c, root->get<IdentNode>().name);
+        emit(c, BC_APPEND, item, ref, (int)indices.size());
+    }
+    release_regs(c, item);
+    emit(c, BC_LOADNULL, dst, 0, 0);
+}
+
+// call_op is BC_CALL, or BC_TAILCALL for the call of a 'return' statement
+static void compile_call(Compiler *c, AstNode *n, int dst, int call_op)
+{
+    CallNode &call = n->get<CallNode>();
+    int argc = call.args.count;
+
+    // Intrinsics take priority over user and native functions
+    int op = -1;
+    switch (call.intrinsic)
+    {
+    case INTRINSIC_LEN:
+        if (compile_var_read(c, call.args.items[0], dst, BC_LENVAR))
+        {
+            return;
+        }
+        op = BC_LEN;
+        break;
+    case INTRINSIC_TYPE:
+        op = BC_TYPE;
+        break;
+    case INTRINSIC_INT:
+        op = BC_TOINT;
+        break;
+    case INTRINSIC_FLOAT:
+        op = BC_TOFLOAT;
+        break;
+    case INTRINSIC_APPEND:
+        compile_append(c, call, dst);
+        return;
+    case INTRINSIC_NONE:
+        break;
+    }
+    if (op >= 0)
+    {
+        compile_expr(c, call.args.items[0], dst);
+        emit(c, op, dst, dst, 0);
+        return;
+    }
+
+    CallSite site;
+    site.name = (uint16_t)name_const(c, call.name);
+    site.argc = (uint16_t)argc;
+    site.node = &call;
+    int site_idx = (int)c->p->calls.size();
+    check_operand(site_idx, "call sites");
+    check_operand(argc, "arguments");
+    c->p->calls.push_back(site);
+
+    // The callee is resolved before the arguments: user functions only
+    // evaluate as many arguments as they have parameters.
+    int base = c->top;
+    emit(c, BC_PREPCALL, base, site_idx, 0);
+    for (int i = 0; i < argc; i++)
+    {
+        alloc_reg(c);
+    }
+    for (int i = 0; i < argc; i++)
+    {
+        AstNode *arg = call.args.items[i];
+        int skip = emit_jump(c, BC_ARGSKIP, i);
+        if (arg->kind == NODE_IDENT && i + 1 >= call.pure_tail)
+        {
+            // Natives may read the variable in place, which is safe when
+            // the remaining arguments cannot change it
+            emit_var(c, BC_ARGVAR, BC_ARGLOCAL, base + i, arg->get<IdentNode>().name);
+        }
+        else
+        {
+            compile_expr(c, arg, base + i);
+        }
+        patch_jump(c, skip, here(c));
+    }
+    for (int i = 0; i + 1 < call.pure_tail; i++)
+    {
+        // Variables the remaining arguments might change are copied above,
+        // and natives that change their arguments get them afterwards
+        AstNode *arg = call.args.items[i];
+        if (arg->kind == NODE_IDENT)
+        {
+            emit_var(c, BC_ARGREF, BC_ARGREFLOCAL, base + i, arg->get<IdentNode>().name);
+        }
+    }
+    c->line = n->line;
+    emit(c, call_op, dst, base, argc);
+    release_regs(c, base);
+}
+
+static void compile_expr(Compiler *c, AstNode *n, int dst)
+{
+    if (!n)
+    {
+        emit(c, BC_LOADNULL, dst, 0, 0);
+        return;
+    }
+    c->line = n->line;
+
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        emit(c, BC_LOADK, dst, add_const(c, value_int(n->get<NumberNode>().value)), 0);
+        break;
+    case NODE_FLOAT:
+        emit(c, BC_LOADK, dst, add_const(c, value_float(n->get<FloatNode>().value)), 0);
+        break;
+    case NODE_STRING:
+    {
+        const char *text = n->get<StringNode>().text;
+        emit(c, BC_LOADK, dst, add_const(c, value_string_intern(text, strlen(text))), 0);
+        break;
+    }
+    case NODE_CHAR:
+        emit(c, BC_LOADK, dst, add_const(c, value_char(n->get<CharNode>().value)), 0);
+        break;
+    case NODE_BOOL:
+        emit(c, BC_LOADK, dst, add_const(c, value_bool(n->get<BoolNode>().value)), 0);
+        break;
+
+    case NODE_LIST:
+    {
+        ListNode &list = n->get<ListNode>();
+        emit(c, BC_NEWLIST, dst, 0, 0);
+        int item = alloc_reg(c);
+        for (int i = 0; i < list.items.count; i++)
+        {
+            compile_expr(c, list.items.items[i], item);
+            emit(c, BC_LISTPUSH, dst, item, 0);
+        }
+        release_regs(c, item);
+        break;
+    }
+
+    case NODE_MAP:
+    {
+        NodeList &items = n->get<MapNode>().items;
+        emit(c, BC_NEWMAP, dst, 0, 0);
+        int key = alloc_reg(c);
+        int value = alloc_reg(c);
+        for (int i = 0; i + 1 < items.count; i += 2)
+        {
+            compile_expr(c, items.items[i], key);
+            compile_expr(c, items.items[i + 1], value);
+            c->line = n->line;
+            emit(c, BC_MAPSET, dst, key, 0);
+        }
+        release_regs(c, key);
+        break;
+    }
+
+    case NODE_IDENT:
+        emit_var(c, BC_GETVAR, BC_GETLOCAL, dst, n->get<IdentNode>().name);
+        break;
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op == OP_AND || binop.op == OP_OR)
+        {
+            // Short-circuit: the left value is the result if it decides
+            compile_expr(c, binop.left, dst);
+            int j = emit_jump(c, binop.op == OP_AND ? BC_JMPF_KEEP : BC_JMPT_KEEP, dst);
+            compile_expr(c, binop.right, dst);
+            patch_jump(c, j, here(c));
+            break;
+        }
+        compile_expr(c, binop.left, dst);
+        int r = alloc_reg(c);
+        compile_expr(c, binop.right, r);
+        c->line = n->line;
+        emit(c, BC_ADD + (int)binop.op, dst, dst, r);
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_NOT:
+        compile_expr(c, n->get<NotNode>().expr, dst);
+        emit(c, BC_NOT, dst, dst, 0);
+        break;
+
+    case NODE_INDEX:
+    {
+        if (compile_var_read(c, n, dst, BC_INDEXVAR))
+        {
+            break;
+        }
+        IndexNode &idx = n->get<IndexNode>();
+        compile_expr(c, idx.target, dst);
+        int r = alloc_reg(c);
+        compile_expr(c, idx.index, r);
+        emit(c, BC_INDEX, dst, dst, r);
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_INC:
+        emit_var(c, BC_INCVAR, BC_INCLOCAL, dst, n->get<IncNode>().name);
+        break;
+    case NODE_DEC:
+        emit_var(c, BC_DECVAR, BC_DECLOCAL, dst, n->get<DecNode>().name);
+        break;
+
+    case NODE_CALL:
+        compile_call(c, n, dst, BC_CALL);
+        break;
+
+    case NODE_INPUT:
+        emit(c, BC_INPUT, dst, add_const(c, value_string(n->get<InputNode>().prompt)), 0);
+        break;
+
+    default:
+        emit(c, BC_LOADNULL, dst, 0, 0);
+        break;
+    }
+}
+
+// Statements
+
+// Closes the block scopes opened inside a loop or switch before jumping out
+static void pop_scopes_to(Compiler *c, int depth)
+{
+    for (int d = c->scope_depth; d > depth; d--)
+    {
+        emit(c, BC_POPSCOPE, 0, 0, 0);
+    }
+}
+
+static void compile_break(Compiler *c)
+{
+    if (c->targets.empty())
+    {
+        return; // 'break' outside of a loop or switch does nothing
+    }
+    Breakable &t = c->targets.back();
+    pop_scopes_to(c, t.scope_depth);
+    t.breaks.push_back(emit_jump(c, BC_JMP, 0));
+}
+
+static void compile_continue(Compiler *c)
+{
+    // 'continue' passes through switches to the innermost loop
+    int i = (int)c->targets.size() - 1;
+    while (i >= 0 && c->targets[i].is_switch)
+    {
+        i--;
+    }
+    if (i < 0)
+    {
+        return;
+    }
+    for (int j = (int)c->targets.size() - 1; j > i; j--)
+    {
+        emit(c, BC_FREE, c->targets[j].value_reg, 0, 0);
+    }
+    pop_scopes_to(c, c->targets[i].scope_depth);
+    c->targets[i].continues.push_back(emit_jump(c, BC_JMP, 0));
+}
+
+static void patch_list(Compiler *c, std::vector<int> &jumps, int target)
+{
+    for (int at : jumps)
+    {
+        patch_jump(c, at, target);
+    }
+}
+
+static void compile_assign_index(Compiler *c, AstNode *n)
+{
+    AssignIndexNode &node = n->get<AssignIndexNode>();
+    int val = alloc_reg(c);
+    compile_expr(c, node.value, val);
+
+    std::vector<AstNode*> indices;
+    AstNode *root = index_chain(node.list, indices);
+    c->line = n->line;
+    if (!root)
+    {
+        emit(c, BC_BADTARGET, val, 0, 0);
+        release_regs(c, val);
+        return;
+    }
+
+    indices.push_back(node.index);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        compile_expr(c, indices[i], alloc_reg(c));
+    }
+    c->line = n->line;
+    int ref = var_ref(c, root->get<IdentNode>().name);
+    emit(c, BC_SETINDEX, val, ref, (int)indices.size());
+    release_regs(c, val);
+}
+
+static void compile_switch(Compiler *c, AstNode *n)
+{
+    SwitchNode &sw = n->get<SwitchNode>();
+    int val = alloc_reg(c);
+    compile_expr(c, sw.expr, val);
+
+    Breakable t;
+    t.is_switch = 1;
+    t.scope_depth = c->scope_depth;
+    t.value_reg = val;
+    c->targets.push_back(t);
+
+    // Cases are tried in order; the first match runs and leaves the switch
+    std::vector<int> to_end;
+    int test = alloc_reg(c);
+    for (int i = 0; i < sw.cases.count; i++)
+    {
+        CaseNode &cs = sw.cases.items[i]->get<CaseNode>();
+        compile_expr(c, cs.value, test);
+        emit(c, BC_SWITCHEQ, test, val, test);
+        int next = emit_jump(c, BC_JMPF, test);
+        compile_block(c, &cs.body, 1);
+        to_end.push_back(emit_jump(c, BC_JMP, 0));
+        patch_jump(c, next, here(c));
+    }
+    compile_block(c, &sw.default_case, 1);
+
+    int end = here(c);
+    patch_list(c, to_end, end);
+    patch_list(c, c->targets.back().breaks, end);
+    c->targets.pop_back();
+    emit(c, BC_FREE, val, 0, 0);
+    release_regs(c, val);
+}
+
+// Compiles the test of a loop and returns the jump taken when it fails.
+// 'i < n' style tests on a slot variable compare the variable in place
+// (BC_LOOPLT..BC_LOOPGTE) instead of copying it into a register first.
+// The bound must be pure: it is evaluated before i is read.
+static int compile_loop_test(Compiler *c, AstNode *cond)
+{
+    int depth, slot;
+    if (cond && cond->kind == NODE_BINOP)
+    {
+        BinOpNode &test = cond->get<BinOpNode>();
+        if (test.op >= OP_LT && test.op <= OP_GTE && test.left->kind == NODE_IDENT &&
+            ast_is_pure(test.right) &&
+            resolve_local(c, test.left->get<IdentNode>().name, &depth, &slot))
+        {
+            int r = alloc_reg(c);
+            compile_expr(c, test.right, r);
+            c->line = cond->line;
+            emit(c, BC_LOOPLT + (test.op - OP_LT), r, slot, depth);
+            release_regs(c, r);
+            return emit_jump(c, BC_JMP, 0);
+        }
+    }
+    int r = alloc_reg(c);
+    compile_expr(c, cond, r);
+    int exit = emit_jump(c, BC_JMPF, r);
+    release_regs(c, r);
+    return exit;
+}
+
+static void compile_stmt(Compiler *c, AstNode *n)
+{
+    if (!n)
+    {
+        return;
+    }
+    c->line = n->line;
+
+    switch (n->kind)
+    {
+    case NODE_LET:
+    {
+        LetNode &let = n->get<LetNode>();
+        int r = alloc_reg(c);
+        // The initializer still sees any outer variable of the same name
+        compile_expr(c, let.expr, r);
+        int slot = declare_local(c, let.name);
+        if (slot >= 0)
+        {
+            emit(c, BC_DEFLOCAL, r, slot, 0);
+        }
+        else
+        {
+            emit(c, BC_DEFVAR, r, name_const(c, let.name), 0);
+        }
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_ASSIGN:
+    {
+        AssignNode &assign = n->get<AssignNode>();
+        AstNode *operands[SUM_MAX_OPERANDS];
+        int count = ast_self_append(n, operands);
+        if (count > 0)
+        {
+            // x = x + ...: the operands, x's value first, in a register run
+            int first = c->top;
+            for (int i = 0; i < count; i++)
+            {
+                compile_expr(c, operands[i], alloc_reg(c));
+            }
+            c->line = n->line;
+            emit(c, BC_APPENDSUM, first, var_ref(c, assign.name), count - 1);
+            release_regs(c, first);
+            break;
+        }
+        int r = alloc_reg(c);
+        compile_expr(c, assign.expr, r);
+        c->line = n->line;
+        emit_var(c, BC_SETVAR, BC_SETLOCAL, r, assign.name);
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_ASSIGN_INDEX:
+        compile_assign_index(c, n);
+        break;
+
+    case NODE_PRINT:
+    {
+        PrintNode &print = n->get<PrintNode>();
+        int r = alloc_reg(c);
+        for (int i = 0; i < print.args.count; i++)
+        {
+            compile_expr(c, print.args.items[i], r);
+            emit(c, BC_PRINT, r, 0, 0);
+        }
+        emit(c, BC_PRINTLN, 0, 0, 0);
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        int r = alloc_reg(c);
+        compile_expr(c, node.cond, r);
+        int to_else = emit_jump(c, BC_JMPF, r);
+        release_regs(c, r);
+
+        compile_block(c, &node.then_block, 1);
+        if (node.else_block.count > 0)
+        {
+            int to_end = emit_jump(c, BC_JMP, 0);
+            patch_jump(c, to_else, here(c));
+            compile_block(c, &node.else_block, 1);
+            patch_jump(c, to_end, here(c));
+        }
+        else
+        {
+            patch_jump(c, to_else, here(c));
+        }
+        break;
+    }
+
+    case NODE_WHILE:
+    {
+        WhileNode &node = n->get<WhileNode>();
+        int start = here(c);
+        int exit = compile_loop_test(c, node.cond);
+
+        Breakable t;
+        t.is_switch = 0;
+        t.scope_depth = c->scope_depth;
+        t.value_reg = 0;
+        c->targets.push_back(t);
+
+        compile_block(c, &node.body, 1);
+        emit(c, BC_JMP, 0, start & 0xFFFF, (uint32_t)start >> 16);
+
+        int end = here(c);
+        patch_jump(c, exit, end);
+        patch_list(c, c->targets.back().breaks, end);
+        patch_list(c, c->targets.back().continues, start);
+        c->targets.pop_back();
+        break;
+    }
+
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+
+        // The loop variable lives in a scope around the whole loop
+        int scoped = declares_names(node.init) || declares_names(node.incr);
+        if (scoped)
+        {
+            push_scope(c);
+        }
+        compile_stmt(c, node.init);
+
+        int start = here(c);
+        int exit = compile_loop_test(c, node.cond);
+
+        Breakable t;
+        t.is_switch = 0;
+        t.scope_depth = c->scope_depth;
+        t.value_reg = 0;
+        c->targets.push_back(t);
+
+        compile_block(c, &node.body, 1);
+
+        int cont = here(c);
+        compile_stmt(c, node.incr);
+        emit(c, BC_JMP, 0, start & 0xFFFF, (uint32_t)start >> 16);
+
+        int end = here(c);
+        patch_jump(c, exit, end);
+        patch_list(c, c->targets.back().breaks, end);
+        patch_list(c, c->targets.back().continues, cont);
+        c->targets.pop_back();
+
+        if (scoped)
+        {
+            pop_scope(c);
+        }
+        break;
+    }
+
+    case NODE_SWITCH:
+        compile_switch(c, n);
+        break;
+
+    case NODE_BLOCK:
+        compile_block(c, &n->get<BlockNode>().items, 1);
+        break;
+
+    case NODE_GROUP:
+        // Statements run in the CURRENT scope
+        compile_block(c, &n->get<BlockNode>().items, 0);
+        break;
+
+    case NODE_FUNC_DEF:
+    {
+        int idx = (int)c->p->funcs.size();
+        check_operand(idx, "functions");
+        c->p->funcs.push_back(n);
+        emit(c, BC_FUNCDEF, 0, idx, 0);
+        break;
+    }
+
+    case NODE_RETURN:
+    {
+        ReturnNode &ret = n->get<ReturnNode>();
+        int r = alloc_reg(c);
+        if (c->in_function && ret.expr && ret.expr->kind == NODE_CALL &&
+            ret.expr->get<CallNode>().intrinsic == INTRINSIC_NONE)
+        {
+            // The VM may run the callee in place of this frame, in which
+            // case the frame never reaches the BC_RETURN
+            c->line = ret.expr->line;
+            compile_call(c, ret.expr, r, BC_TAILCALL);
+        }
+        else
+        {
+            compile_expr(c, ret.expr, r);
+        }
+        if (c->in_function)
+        {
+            emit(c, BC_RETURN, r, 0, 0);
+        }
+        else
+        {
+            // 'return' at the top level ends the program
+            emit(c, BC_FREE, r, 0, 0);
+            emit(c, BC_HALT, 0, 0, 0);
+        }
+        release_regs(c, r);
+        break;
+    }
+
+    case NODE_BREAK:
+        compile_break(c);
+        break;
+
+    case NODE_CONTINUE:
+        compile_continue(c);
+        break;
+
+    case NODE_INC:
+    case NODE_DEC:
+    {
+        // A standalone i++ on a slot variable needs no result register
+        const char *name = n->kind == NODE_INC ?
+            n->get<IncNode>().name : n->get<DecNode>().name;
+        int depth, slot;
+        if (resolve_local(c, name, &depth, &slot))
+        {
+            emit(c, BC_STEPLOCAL, n->kind == NODE_DEC, slot, depth);
+            break;
+        }
+    }
+        [[fallthrough]];
+    default:
+    {
+        // Standalone expressions (e.g. function calls without assignment)
+        int r = alloc_reg(c);
+        compile_expr(c, n, r);
+        emit(c, BC_FREE, r, 0, 0);
+        release_regs(c, r);
+        break;
+    }
+    }
+}
+
+static void compiler_init(Compiler *c, Proto *p, int in_function)
+{
+    c->p = p;
+    c->top = 0;
+    c->line = 0;
+    c->scope_depth = 0;
+    c->in_function = in_function;
+    p->nregs = 0;
+}
+
+Proto *compile_program(AstNode *prog)
+{
+    Proto *p = new Proto();
+    p->name = "<main>";
+    Compiler c;
+    compiler_init(&c, p, 0);
+
+    // The top level block runs directly in the environment it is given
+    if (prog->kind == NODE_BLOCK)
+    {
+        NodeList &items = prog->get<BlockNode>().items;
+        for (int i = 0; i < items.count; i++)
+        {
+            compile_stmt(&c, items.items[i]);
+        }
+    }
+    else
+    {
+        compile_stmt(&c, prog);
+    }
+    emit(&c, BC_HALT, 0, 0, 0);
+    return p;
+}
+
+Proto *compile_function(AstNode *funcdef)
+{
+    FuncDefNode &fd = funcdef->get<FuncDefNode>();
+    if (fd.proto)
+    {
+        return fd.proto;
+    }
+
+    Proto *p = new Proto();
+    p->name = fd.name;
+    Compiler c;
+    compiler_init(&c, p, 1);
+    c.line = funcdef->line;
+
+    // Parameters take the first slots of the call scope; the body runs in
+    // that scope
+    c.scopes.push_back(add_scope(&c));
+    for (int i = 0; i < fd.param_count; i++)
+    {
+        p->param_slots.push_back((uint16_t)declare_local(&c, fd.params[i]));
+    }
+    for (int i = 0; i < fd.body.count; i++)
+    {
+        compile_stmt(&c, fd.body.items[i]);
+    }
+    emit(&c, BC_RETNULL, 0, 0, 0);
+
+    fd.proto = p;
+    return p;
+}
+
+void proto_free(Proto *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    for (size_t i = 0; i < p->consts.size(); i++)
+    {
+        value_free(p->consts[i]);
+    }
+    delete p;
+}
+
+#define LUNA_OPCODE_NAME(op) #op,
+static const char *opcode_names[] =
+{
+    LUNA_OPCODES(LUNA_OPCODE_NAME)
+};
+#undef LUNA_OPCODE_NAME
+
+void proto_dump(const Proto *p, FILE *out)
+{
+    fprintf
+    (
+        out, "== %s (%zu instructions, %d registers) ==\n",
+        p->name.c_str(), p->code.size(), p->nregs
+    );
+    for (size_t i = 0; i < p->scopes.size(); i++)
+    {
+        fprintf(out, "  scope %zu:", i);
+        for (size_t k = 0; k < p->scopes[i].size(); k++)
+        {
+            fprintf(out, " %s", p->scopes[i][k]);
+        }
+        fprintf(out, "\n");
+    }
+    for (size_t i = 0; i < p->code.size(); i++)
+    {
+        const Instr &in = p->code[i];
+        fprintf
+        (
+            out, "%5zu  [line %4d]  %-14s %5d %5d %5d",
+            i, p->lines[i], opcode_names[in.op] + 3, in.a, in.b, in.c
+        );
+
+        switch (in.op)
+        {
+        case BC_JMP:
+        case BC_JMPF:
+        case BC_JMPF_KEEP:
+        case BC_JMPT_KEEP:
+        case BC_ARGSKIP:
+            fprintf(out, "   ; -> %u", INSTR_JUMP(in));
+            break;
+        case BC_LOADK:
+        case BC_GETVAR:
+        case BC_DEFVAR:
+        case BC_SETVAR:
+        case BC_INCVAR:
+        case BC_DECVAR:
+        case BC_ARGVAR:
+        case BC_ARGREF:
+        {
+            char *s = value_to_string(p->consts[in.b]);
+            fprintf(out, "   ; %s", s);
+            free(s);
+            break;
+        }
+        case BC_INDEXVAR:
+        case BC_LENVAR:
+        case BC_SETINDEX:
+        case BC_APPEND:
+        case BC_APPENDSUM:
+        {
+            const VarRef &ref = p->refs[in.b];
+            fprintf(out, "   ; %s", value_chars(&p->consts[ref.name]));
+            if (ref.slot >= 0)
+            {
+                fprintf(out, " (slot %d, depth %d)", ref.slot, ref.depth);
+            }
+            break;
+        }
+        case BC_PREPCALL:
+        {
+            const CallSite &site = p->calls[in.b];
+            fprintf(out, "   ; %s/%d", value_chars(&p->consts[site.name]), site.argc);
+            break;
+        }
+        case BC_FUNCDEF:
+            fprintf(out, "   ; %s", p->funcs[in.b]->get<FuncDefNode>().name);
+            break;
+        default:
+            break;
+        }
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,1600 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// C backend (see emit_c.h). Each statement is translated the way the AST
+// walker executes it: the same scopes are created in the same order, and
+// values are built and freed through the runtime (aot.h), so dynamic
+// scoping, natives and error messages all behave as on the interpreter.
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <luna/emit_c.h>
+
+// Something the generated code must free when control leaves its block:
+// a scope (env_free) or a switch value (value_free)
+typedef struct
+{
+    int is_scope;
+    std::string name;
+} Cleanup;
+
+// An enclosing loop or switch, the targets of 'break' and 'continue'
+typedef struct
+{
+    int is_loop;
+    size_t depth;           // Cleanups that stay when jumping out
+    std::string next;       // Label 'continue' jumps to ("" for C continue)
+    std::string end;        // Label 'break' jumps to ("" for C break)
+    int used;               // A goto targets next or end
+} Flow;
+
+// Functions the call sites of one body can run, by id
+typedef struct
+{
+    std::vector<int> bodies;    // Through their boxed body
+    std::vector<int> unboxed;   // Through their unboxed version
+} CallRefs;
+
+typedef struct
+{
+    AstNode *node;
+    int unboxed;            // Has an unboxed version
+    int ret_float;          // ... returning double instead of long long
+    std::string decl;       // Declaration of the unboxed version
+    std::string code;       // Its definition
+    std::string body;       // Definition of the boxed body
+    CallRefs refs;          // What the boxed body calls
+    int reached;            // Some emitted call site runs the boxed body
+    int unboxed_reached;    // ... or the unboxed version
+} EmitFunc;
+
+typedef struct
+{
+    std::string *buf;
+    int indent;
+    int temps;
+    int cur_line;           // Value of luna_current_line here, -1 if unknown
+    std::vector<Cleanup> cleanups;
+    std::vector<Flow> flows;
+    int in_function;
+    std::string stmt_end;   // Label after the current top statement
+    int stmt_end_used;
+    int done_used;          // A top-level 'return' jumps to the end of main
+
+    std::vector<EmitFunc> funcs;
+    std::map<AstNode *, int> func_ids;
+    std::map<std::string, std::vector<int>> funcs_by_name;
+    CallRefs *refs;         // Of the body being emitted
+    std::vector<std::string> sites;
+} Emitter;
+
+// --- Text ------------------------------------------------------------------
+
+static void out(Emitter *em, const std::string &text)
+{
+    em->buf->append(em->indent * 4, ' ');
+    em->buf->append(text);
+    em->buf->push_back('\n');
+}
+
+static void open_block(Emitter *em)
+{
+    out(em, "{");
+    em->indent++;
+}
+
+static void close_block(Emitter *em)
+{
+    em->indent--;
+    out(em, "}");
+}
+
+static std::string temp(Emitter *em, const char *prefix)
+{
+    return prefix + std::to_string(++em->temps);
+}
+
+static std::string c_string(const std::string &s)
+{
+    std::string r = "\"";
+    for (unsigned char ch : s)
+    {
+        switch (ch)
+        {
+        case '"':  r += "\\\""; break;
+        case '\\': r += "\\\\"; break;
+        case '\n': r += "\\n"; break;
+        case '\t': r += "\\t"; break;
+        case '\r': r += "\\r"; break;
+        default:
+            if (ch < 32 || ch >= 127)
+            {
+                char oct[8];
+                snprintf(oct, sizeof(oct), "\\%03o", ch);
+                r += oct;
+            }
+            else
+            {
+                r += (char)ch;
+            }
+        }
+    }
+    return r + "\"";
+}
+
+static std::string c_int(long long v)
+{
+    if (v == (-9223372036854775807LL - 1))
+    {
+        return "(-9223372036854775807LL - 1)";
+    }
+    return std::to_string(v) + "LL";
+}
+
+static std::string c_double(double v)
+{
+    if (std::isnan(v))
+    {
+        return "NAN";
+    }
+    if (std::isinf(v))
+    {
+        return v < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.17g", v);
+    std::string s = buf;
+    if (s.find_first_of(".e") == std::string::npos)
+    {
+        s += ".0";
+    }
+    return s;
+}
+
+static const char *binop_name(BinOpKind op)
+{
+    static const char *names[] =
+    {
+        "OP_ADD", "OP_SUB", "OP_MUL", "OP_DIV", "OP_MOD", "OP_EQ", "OP_NEQ",
+        "OP_LT", "OP_GT", "OP_LTE", "OP_GTE", "OP_AND", "OP_OR"
+    };
+    return names[op];
+}
+
+static std::string func_name(int id)
+{
+    return "fn_" + std::to_string(id);
+}
+
+// --- Scopes and jumps ------------------------------------------------------
+
+static std::string env(Emitter *em)
+{
+    for (size_t i = em->cleanups.size(); i-- > 0; )
+    {
+        if (em->cleanups[i].is_scope)
+        {
+            return em->cleanups[i].name;
+        }
+    }
+    return "e";
+}
+
+static std::string push_scope(Emitter *em)
+{
+    std::string parent = env(em);
+    std::string name = temp(em, "e");
+    out(em, "Env *" + name + " = env_create(" + parent + ");");
+    em->cleanups.push_back({ 1, name });
+    return name;
+}
+
+static void emit_cleanup(Emitter *em, const Cleanup &c)
+{
+    out(em, (c.is_scope ? "env_free(" : "value_free(") + c.name + ");");
+}
+
+static void pop_cleanup(Emitter *em)
+{
+    emit_cleanup(em, em->cleanups.back());
+    em->cleanups.pop_back();
+}
+
+// Frees everything above depth without popping it (for jumps)
+static void unwind(Emitter *em, size_t depth)
+{
+    for (size_t i = em->cleanups.size(); i-- > depth; )
+    {
+        emit_cleanup(em, em->cleanups[i]);
+    }
+}
+
+static void set_line(Emitter *em, int line)
+{
+    if (line != em->cur_line)
+    {
+        out(em, "luna_current_line = " + std::to_string(line) + ";");
+        em->cur_line = line;
+    }
+}
+
+// --- Unboxed functions -----------------------------------------------------
+
+// Functions whose body only computes on ints and floats are also emitted
+// without Values: locals become C variables of a fixed type. Parameters are
+// assumed to be ints; callers check that before using this version.
+
+typedef enum
+{
+    UB_NONE,
+    UB_INT,
+    UB_FLOAT
+} UbType;
+
+typedef struct
+{
+    std::string name;
+    std::string cname;
+    UbType type;
+} UbVar;
+
+typedef struct
+{
+    UbType type;
+    std::string code;
+} UbExpr;
+
+typedef struct
+{
+    FuncDefNode *def;
+    std::string fname;
+    UbType ret;
+    std::vector<UbVar> vars;
+    int nvars;
+    int loops;
+    int used_top;
+    int ok;
+    std::string text;
+    int indent;
+} Unboxer;
+
+static void ub_out(Unboxer *u, const std::string &text)
+{
+    u->text.append(u->indent * 4, ' ');
+    u->text.append(text);
+    u->text.push_back('\n');
+}
+
+static const char *ub_ctype(UbType t)
+{
+    return t == UB_FLOAT ? "double" : "long long";
+}
+
+static const UbVar *ub_find(Unboxer *u, const char *name)
+{
+    for (size_t i = u->vars.size(); i-- > 0; )
+    {
+        if (u->vars[i].name == name)
+        {
+            return &u->vars[i];
+        }
+    }
+    return nullptr;
+}
+
+static UbExpr ub_fail(Unboxer *u)
+{
+    u->ok = 0;
+    return { UB_NONE, "" };
+}
+
+static std::string ub_as_double(const UbExpr &e)
+{
+    return e.type == UB_INT ? "(double)" + e.code : e.code;
+}
+
+static UbExpr ub_expr(Unboxer *u, AstNode *n);
+
+// Argument list of a call to the function itself, or "" on failure
+static std::string ub_args(Unboxer *u, CallNode &call)
+{
+    if (call.intrinsic != INTRINSIC_NONE || strcmp(call.name, u->def->name) != 0 ||
+        call.args.count != u->def->param_count)
+    {
+        u->ok = 0;
+        return "";
+    }
+    std::string args;
+    for (int i = 0; i < call.args.count; i++)
+    {
+        UbExpr a = ub_expr(u, call.args.items[i]);
+        if (a.type != UB_INT)
+        {
+            u->ok = 0;
+            return "";
+        }
+        args += (i ? ", " : "") + a.code;
+    }
+    return args;
+}
+
+static UbExpr ub_expr(Unboxer *u, AstNode *n)
+{
+    if (!u->ok || !n)
+    {
+        return ub_fail(u);
+    }
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        return { UB_INT, c_int(n->get<NumberNode>().value) };
+
+    case NODE_FLOAT:
+        return { UB_FLOAT, c_double(n->get<FloatNode>().value) };
+
+    case NODE_IDENT:
+    {
+        const UbVar *v = ub_find(u, n->get<IdentNode>().name);
+        if (!v)
+        {
+            return ub_fail(u);
+        }
+        return { v->type, v->cname };
+    }
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op > OP_MOD)
+        {
+            return ub_fail(u);
+        }
+        UbExpr l = ub_expr(u, binop.left);
+        UbExpr r = ub_expr(u, binop.right);
+        if (!u->ok)
+        {
+            return ub_fail(u);
+        }
+        static const char *ops[] = { " + ", " - ", " * ", " / ", " % " };
+        if (l.type == UB_INT && r.type == UB_INT)
+        {
+            // Int division gives a float, or int 0 for a zero divisor
+            if (binop.op == OP_DIV)
+            {
+                return ub_fail(u);
+            }
+            return { UB_INT, "(" + l.code + ops[binop.op] + r.code + ")" };
+        }
+        if (binop.op == OP_MOD)
+        {
+            return ub_fail(u);
+        }
+        if (binop.op == OP_DIV)
+        {
+            return { UB_FLOAT, "aot_fdiv(" + ub_as_double(l) + ", " + ub_as_double(r) + ")" };
+        }
+        return { UB_FLOAT, "(" + ub_as_double(l) + ops[binop.op] + ub_as_double(r) + ")" };
+    }
+
+    case NODE_CALL:
+    {
+        std::string args = ub_args(u, n->get<CallNode>());
+        if (!u->ok)
+        {
+            return ub_fail(u);
+        }
+        return { u->ret, u->fname + "(" + args + ")" };
+    }
+
+    default:
+        return ub_fail(u);
+    }
+}
+
+// A C condition with the truthiness of n
+static std::string ub_cond(Unboxer *u, AstNode *n)
+{
+    if (!u->ok || !n)
+    {
+        u->ok = 0;
+        return "";
+    }
+    switch (n->kind)
+    {
+    case NODE_BOOL:
+        return n->get<BoolNode>().value ? "1" : "0";
+
+    case NODE_NOT:
+        return "!" + ub_cond(u, n->get<NotNode>().expr);
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op == OP_AND || binop.op == OP_OR)
+        {
+            std::string l = ub_cond(u, binop.left);
+            std::string r = ub_cond(u, binop.right);
+            return "(" + l + (binop.op == OP_AND ? " && " : " || ") + r + ")";
+        }
+        if (binop.op < OP_EQ)
+        {
+            break;
+        }
+        UbExpr l = ub_expr(u, binop.left);
+        UbExpr r = ub_expr(u, binop.right);
+        if (!u->ok)
+        {
+            return "";
+        }
+        static const char *ops[] = { " == ", " != ", " < ", " > ", " <= ", " >= " };
+        if (l.type == UB_INT && r.type == UB_INT)
+        {
+            return "(" + l.code + ops[binop.op - OP_EQ] + r.code + ")";
+        }
+        std::string dl = ub_as_double(l), dr = ub_as_double(r);
+        if (binop.op == OP_EQ)
+        {
+            return "aot_feq(" + dl + ", " + dr + ")";
+        }
+        if (binop.op == OP_NEQ)
+        {
+            return "aot_fneq(" + dl + ", " + dr + ")";
+        }
+        return "(" + dl + ops[binop.op - OP_EQ] + dr + ")";
+    }
+
+    default:
+        break;
+    }
+    UbExpr e = ub_expr(u, n);
+    return "(" + e.code + (e.type == UB_INT ? " != 0)" : " != 0.0)");
+}
+
+static void ub_stmt(Unboxer *u, AstNode *n);
+
+static void ub_block(Unboxer *u, NodeList &list)
+{
+    size_t vars = u->vars.size();
+    for (int i = 0; i < list.count && u->ok; i++)
+    {
+        ub_stmt(u, list.items[i]);
+    }
+    u->vars.resize(vars);
+}
+
+static std::string ub_declare(Unboxer *u, const std::string &name, UbType type)
+{
+    std::string cname = "v" + std::to_string(u->nvars++) + "_" + name;
+    u->vars.push_back({ name, cname, type });
+    return cname;
+}
+
+// A statement usable as the step of a C for loop
+static std::string ub_step(Unboxer *u, AstNode *n)
+{
+    if (!n)
+    {
+        return "";
+    }
+    if (n->kind == NODE_INC || n->kind == NODE_DEC)
+    {
+        const char *name = n->kind == NODE_INC ?
+            n->get<IncNode>().name : n->get<DecNode>().name;
+        const UbVar *v = ub_find(u, name);
+        if (!v || v->type != UB_INT)
+        {
+            u->ok = 0;
+            return "";
+        }
+        return v->cname + (n->kind == NODE_INC ? "++" : "--");
+    }
+    if (n->kind == NODE_ASSIGN)
+    {
+        AssignNode &assign = n->get<AssignNode>();
+        const UbVar *v = ub_find(u, assign.name);
+        UbExpr e = ub_expr(u, assign.expr);
+        if (!v || !u->ok || e.type != v->type)
+        {
+            u->ok = 0;
+            return "";
+        }
+        return v->cname + " = " + e.code;
+    }
+    u->ok = 0;
+    return "";
+}
+
+static void ub_stmt(Unboxer *u, AstNode *n)
+{
+    if (!u->ok || !n)
+    {
+        return;
+    }
+    switch (n->kind)
+    {
+    case NODE_LET:
+    {
+        LetNode &let = n->get<LetNode>();
+        UbExpr e = ub_expr(u, let.expr);
+        if (!u->ok || strcmp(let.name, u->def->name) == 0)
+        {
+            u->ok = 0;
+            return;
+        }
+        std::string cname = ub_declare(u, let.name, e.type);
+        ub_out(u, std::string(ub_ctype(e.type)) + " " + cname + " = " + e.code + ";");
+        return;
+    }
+
+    case NODE_ASSIGN:
+    case NODE_INC:
+    case NODE_DEC:
+    {
+        std::string step = ub_step(u, n);
+        if (u->ok)
+        {
+            ub_out(u, step + ";");
+        }
+        return;
+    }
+
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        ub_out(u, "if " + std::string(1, '(') + ub_cond(u, node.cond) + ")");
+        ub_out(u, "{");
+        u->indent++;
+        ub_block(u, node.then_block);
+        u->indent--;
+        ub_out(u, "}");
+        if (node.else_block.count > 0)
+        {
+            ub_out(u, "else");
+            ub_out(u, "{");
+            u->indent++;
+            ub_block(u, node.else_block);
+            u->indent--;
+            ub_out(u, "}");
+        }
+        return;
+    }
+
+    case NODE_WHILE:
+    {
+        WhileNode &node = n->get<WhileNode>();
+        ub_out(u, "while (" + ub_cond(u, node.cond) + ")");
+        ub_out(u, "{");
+        u->indent++;
+        u->loops++;
+        ub_block(u, node.body);
+        u->loops--;
+        u->indent--;
+        ub_out(u, "}");
+        return;
+    }
+
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+        size_t vars = u->vars.size();
+        ub_out(u, "{");
+        u->indent++;
+        ub_stmt(u, node.init);
+        std::string cond = node.cond ? ub_cond(u, node.cond) : "0";
+        std::string step = ub_step(u, node.incr);
+        ub_out(u, "for (; " + cond + "; " + step + ")");
+        ub_out(u, "{");
+        u->indent++;
+        u->loops++;
+        ub_block(u, node.body);
+        u->loops--;
+        u->indent--;
+        ub_out(u, "}");
+        u->indent--;
+        ub_out(u, "}");
+        u->vars.resize(vars);
+        return;
+    }
+
+    case NODE_BREAK:
+    case NODE_CONTINUE:
+        if (!u->loops)
+        {
+            u->ok = 0;
+            return;
+        }
+        ub_out(u, n->kind == NODE_BREAK ? "break;" : "continue;");
+        return;
+
+    case NODE_BLOCK:
+    case NODE_GROUP:
+        ub_out(u, "{");
+        u->indent++;
+        ub_block(u, n->get<BlockNode>().items);
+        u->indent--;
+        ub_out(u, "}");
+        return;
+
+    case NODE_RETURN:
+    {
+        AstNode *expr = n->get<ReturnNode>().expr;
+        if (!expr)
+        {
+            u->ok = 0;
+            return;
+        }
+        if (expr->kind == NODE_CALL)
+        {
+            // A call to itself in tail position restarts the body
+            CallNode &call = expr->get<CallNode>();
+            std::string args = ub_args(u, call);
+            if (!u->ok)
+            {
+                return;
+            }
+            std::vector<std::string> temps;
+            for (int i = 0; i < call.args.count; i++)
+            {
+                UbExpr a = ub_expr(u, call.args.items[i]);
+                temps.push_back("a" + std::to_string(u->nvars++));
+                ub_out(u, "long long " + temps.back() + " = " + a.code + ";");
+            }
+            for (int i = 0; i < call.args.count; i++)
+            {
+                ub_out(u, "p" + std::to_string(i) + " = " + temps[i] + ";");
+            }
+            ub_out(u, "goto top;");
+            u->used_top = 1;
+            return;
+        }
+        UbExpr e = ub_expr(u, expr);
+        if (!u->ok || e.type != u->ret)
+        {
+            u->ok = 0;
+            return;
+        }
+        ub_out(u, "return " + e.code + ";");
+        return;
+    }
+
+    case NODE_CALL:
+    {
+        std::string args = ub_args(u, n->get<CallNode>());
+        if (u->ok)
+        {
+            ub_out(u, "(void)" + u->fname + "(" + args + ");");
+        }
+        return;
+    }
+
+    default:
+        u->ok = 0;
+        return;
+    }
+}
+
+static int always_returns(NodeList &list);
+
+static int stmt_returns(AstNode *n)
+{
+    switch (n->kind)
+    {
+    case NODE_RETURN:
+        return 1;
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        return always_returns(node.then_block) && always_returns(node.else_block);
+    }
+    case NODE_BLOCK:
+    case NODE_GROUP:
+        return always_returns(n->get<BlockNode>().items);
+    default:
+        return 0;
+    }
+}
+
+static int always_returns(NodeList &list)
+{
+    for (int i = 0; i < list.count; i++)
+    {
+        if (stmt_returns(list.items[i]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Emits the unboxed version of f, or leaves f->unboxed clear
+static void emit_unboxed(EmitFunc *f, int id)
+{
+    FuncDefNode &def = f->node->get<FuncDefNode>();
+    if (def.memo || !always_returns(def.body))
+    {
+        return;
+    }
+    static const UbType rets[] = { UB_INT, UB_FLOAT };
+    for (UbType ret : rets)
+    {
+        Unboxer u;
+        u.def = &def;
+        u.fname = func_name(id) + "_unboxed";
+        u.ret = ret;
+        u.nvars = 0;
+        u.loops = 0;
+        u.used_top = 0;
+        u.ok = 1;
+        u.indent = 1;
+
+        std::string params;
+        for (int i = 0; i < def.param_count; i++)
+        {
+            if (strcmp(def.params[i], def.name) == 0)
+            {
+                return;
+            }
+            std::string cname = "p" + std::to_string(i);
+            u.vars.push_back({ def.params[i], cname, UB_INT });
+            params += (i ? ", long long " : "long long ") + cname;
+        }
+        ub_block(&u, def.body);
+        if (!u.ok)
+        {
+            continue;
+        }
+
+        f->decl = "static " + std::string(ub_ctype(ret)) + " " + u.fname + "(" + params + ")";
+        std::string head = f->decl + "\n{\n";
+        for (int i = 0; i < def.param_count; i++)
+        {
+            // A parameter hidden by a later one of the same name is never read
+            head += "    (void)p" + std::to_string(i) + ";\n";
+        }
+        if (u.used_top)
+        {
+            head += "top:\n";
+        }
+        f->code += head + u.text + "    return 0;\n}\n\n";
+        f->unboxed = 1;
+        f->ret_float = ret == UB_FLOAT;
+        return;
+    }
+}
+
+// --- Boxed code ------------------------------------------------------------
+
+static std::string emit_expr(Emitter *em, AstNode *n);
+static void emit_stmt(Emitter *em, AstNode *n);
+
+// Finds a Value* to the variable or list item n names, for assignments.
+// The pointer is null where the walker's get_mutable_value gives up.
+static std::string emit_ref(Emitter *em, AstNode *n)
+{
+    std::string p = temp(em, "p");
+    if (n->kind == NODE_IDENT)
+    {
+        out(em, "Value *" + p + " = env_get(" + env(em) + ", " +
+            c_string(n->get<IdentNode>().name) + ");");
+    }
+    else if (n->kind == NODE_INDEX)
+    {
+        IndexNode &index = n->get<IndexNode>();
+        std::string list = emit_ref(em, index.target);
+        out(em, "Value *" + p + " = nullptr;");
+        out(em, "if (" + list + " && (" + list + "->type == VAL_LIST || " + list + "->type == VAL_MAP))");
+        open_block(em);
+        std::string i = emit_expr(em, index.index);
+        out(em, p + " = aot_index_ref(" + list + ", " + i + ", " + std::to_string(n->line) + ");");
+        close_block(em);
+        em->cur_line = -1;
+    }
+    else
+    {
+        out(em, "Value *" + p + " = nullptr;");
+    }
+    return p;
+}
+
+// Emits a call of a user function or native. With tail set (inside a
+// function, for 'return f(...)'), the call may instead be handed to the
+// caller's call loop, as the walker does.
+static std::string emit_call(Emitter *em, AstNode *n, int tail)
+{
+    CallNode &call = n->get<CallNode>();
+    std::string res = temp(em, "t");
+    std::string e = env(em);
+    int argc = call.args.count;
+    std::string line = std::to_string(n->line);
+
+    switch (call.intrinsic)
+    {
+    case INTRINSIC_LEN:
+    case INTRINSIC_TYPE:
+    case INTRINSIC_INT:
+    case INTRINSIC_FLOAT:
+    {
+        static const char *builtins[] = { "", "builtin_len", "", "builtin_type", "builtin_int", "builtin_float" };
+        std::string a = emit_expr(em, call.args.items[0]);
+        out(em, "Value " + res + " = " + builtins[call.intrinsic] + "(" + a + ");");
+        out(em, "value_free(" + a + ");");
+        return res;
+    }
+    case INTRINSIC_APPEND:
+        if (argc != 2)
+        {
+            out(em, "fprintf(stderr, \"Runtime Error: append() takes 2 arguments (list, value)\\n\");");
+        }
+        else
+        {
+            std::string list = emit_ref(em, call.args.items[0]);
+            std::string item = emit_expr(em, call.args.items[1]);
+            out(em, "aot_append(" + list + ", " + item + ", " + line + ");");
+        }
+        out(em, "Value " + res + " = value_null();");
+        return res;
+    case INTRINSIC_NONE:
+        break;
+    }
+
+    // Resolve first: user functions only evaluate the arguments they take
+    std::string site = "site_" + std::to_string(em->sites.size());
+    em->sites.push_back(call.name);
+    std::string ct = temp(em, "ct");
+    std::string args = temp(em, "a");
+    std::string want = temp(em, "w");
+    std::string borrowed = temp(em, "b");
+    out(em, "CallTarget " + ct + " = call_resolve(" + e + ", " + site + ");");
+    out(em, "Value " + args + "[" + std::to_string(argc > 0 ? argc : 1) + "];");
+    out(em, "unsigned long long " + borrowed + " = 0;");
+    out(em, "int " + want + " = " + ct + ".fn ? aot_param_count(" + ct + ".fn) : " +
+        ct + ".native ? " + std::to_string(argc) + " : 0;");
+    out(em, "if (" + want + " > " + std::to_string(argc) + ") " + want + " = " + std::to_string(argc) + ";");
+    for (int i = 0; i < argc; i++)
+    {
+        std::string slot = args + "[" + std::to_string(i) + "]";
+        AstNode *arg = call.args.items[i];
+        out(em, "if (" + std::to_string(i) + " < " + want + ")");
+        open_block(em);
+        if (arg->kind == NODE_IDENT && i + 1 >= call.pure_tail && i < 64)
+        {
+            // Natives that change lists or maps get those variables by
+            // reference, unshared first so the change only reaches that variable
+            std::string ref = temp(em, "r");
+            out(em, "Value *" + ref + " = " + ct + ".native && " + ct + ".mutates ? env_get(" + e +
+                ", " + c_string(arg->get<IdentNode>().name) + ") : nullptr;");
+            out(em, "if (" + ref + " && value_unshare(" + ref + "))");
+            open_block(em);
+            out(em, slot + " = *" + ref + ";");
+            out(em, borrowed + " |= 1ULL << " + std::to_string(i) + ";");
+            close_block(em);
+            out(em, "else");
+            open_block(em);
+            out(em, slot + " = " + emit_expr(em, arg) + ";");
+            close_block(em);
+        }
+        else
+        {
+            out(em, slot + " = " + emit_expr(em, arg) + ";");
+        }
+        close_block(em);
+        out(em, "else");
+        open_block(em);
+        out(em, slot + " = value_null();");
+        close_block(em);
+        em->cur_line = -1;
+    }
+    for (int i = 0; i + 1 < call.pure_tail && i < 64; i++)
+    {
+        // Variables the arguments after them might change are copied
+        // above and taken by reference once those have run
+        AstNode *arg = call.args.items[i];
+        if (arg->kind != NODE_IDENT)
+        {
+            continue;
+        }
+        std::string slot = args + "[" + std::to_string(i) + "]";
+        std::string ref = temp(em, "r");
+        out(em, "Value *" + ref + " = " + std::to_string(i) + " < " + want + " && " + ct + ".native && " +
+            ct + ".mutates ? env_get(" + e + ", " + c_string(arg->get<IdentNode>().name) + ") : nullptr;");
+        out(em, "if (" + ref + ")");
+        open_block(em);
+        out(em, "value_free(" + slot + ");");
+        out(em, "if (value_unshare(" + ref + "))");
+        open_block(em);
+        out(em, slot + " = *" + ref + ";");
+        out(em, borrowed + " |= 1ULL << " + std::to_string(i) + ";");
+        close_block(em);
+        out(em, "else");
+        open_block(em);
+        out(em, slot + " = value_copy(*" + ref + ");");
+        close_block(em);
+        close_block(em);
+    }
+
+    std::vector<int> candidates;
+    auto it = em->funcs_by_name.find(call.name);
+    if (it != em->funcs_by_name.end())
+    {
+        candidates = it->second;
+    }
+
+    if (tail && !candidates.empty())
+    {
+        std::string body = temp(em, "tb");
+        std::string chain = "nullptr";
+        for (size_t k = candidates.size(); k-- > 0; )
+        {
+            std::string fn = func_name(candidates[k]);
+            chain = ct + ".fn == " + fn + " ? " + fn + "_body : " + chain;
+            em->refs->bodies.push_back(candidates[k]);
+        }
+        out(em, "AotBody " + body + " = " + chain + ";");
+        out(em, "if (" + body + " && aot_can_tail(" + e + ", frame, " + ct + ".fn))");
+        open_block(em);
+        out(em, "for (int i = 0; i < " + want + "; i++)");
+        open_block(em);
+        out(em, "frame->tail_args[i] = " + args + "[i];");
+        close_block(em);
+        out(em, "frame->tail_argc = " + want + ";");
+        out(em, "frame->tail_fn = " + ct + ".fn;");
+        out(em, "frame->tail_body = " + body + ";");
+        unwind(em, 1);
+        out(em, "return value_null();");
+        close_block(em);
+    }
+
+    out(em, "Value " + res + ";");
+    const char *prefix = "if";
+    for (int id : candidates)
+    {
+        EmitFunc &f = em->funcs[id];
+        std::string fn = func_name(id);
+        out(em, std::string(prefix) + " (" + ct + ".fn == " + fn + ")");
+        open_block(em);
+        std::string call_boxed = res + " = aot_call(" + e + ", " + fn + ", " + fn + "_body, " +
+            args + ", " + want + ");";
+        em->refs->bodies.push_back(id);
+        if (f.unboxed)
+        {
+            int nparams = f.node->get<FuncDefNode>().param_count;
+            std::string guard = want + " == " + std::to_string(nparams);
+            std::string unboxed_args;
+            for (int i = 0; i < nparams; i++)
+            {
+                std::string a = args + "[" + std::to_string(i) + "]";
+                guard += " && " + a + ".type == VAL_INT";
+                unboxed_args += (i ? ", " : "") + a + ".i";
+            }
+            out(em, "if (" + guard + ")");
+            open_block(em);
+            out(em, res + " = " + (f.ret_float ? "value_float(" : "value_int(") + fn +
+                "_unboxed(" + unboxed_args + "));");
+            em->refs->unboxed.push_back(id);
+            close_block(em);
+            out(em, "else");
+            open_block(em);
+            out(em, call_boxed);
+            close_block(em);
+        }
+        else
+        {
+            out(em, call_boxed);
+        }
+        close_block(em);
+        prefix = "else if";
+    }
+    out(em, std::string(prefix) + " (" + ct + ".native)");
+    open_block(em);
+    out(em, "luna_current_line = " + line + ";");
+    out(em, res + " = aot_call_native(" + ct + ".native, " + args + ", " + std::to_string(argc) +
+        ", " + borrowed + ");");
+    close_block(em);
+    out(em, "else");
+    open_block(em);
+    out(em, res + " = value_null();");
+    close_block(em);
+    em->cur_line = -1;
+    return res;
+}
+
+// Emits code computing n into a new Value variable and returns its name
+static std::string emit_expr(Emitter *em, AstNode *n)
+{
+    std::string t = temp(em, "t");
+    if (!n)
+    {
+        out(em, "Value " + t + " = value_null();");
+        return t;
+    }
+    set_line(em, n->line);
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        out(em, "Value " + t + " = value_int(" + c_int(n->get<NumberNode>().value) + ");");
+        return t;
+
+    case NODE_FLOAT:
+        out(em, "Value " + t + " = value_float(" + c_double(n->get<FloatNode>().value) + ");");
+        return t;
+
+    case NODE_STRING:
+        out(em, "Value " + t + " = value_string(" + c_string(n->get<StringNode>().text) + ");");
+        return t;
+
+    case NODE_CHAR:
+        out(em, "Value " + t + " = value_char((char)" +
+            std::to_string((int)n->get<CharNode>().value) + ");");
+        return t;
+
+    case NODE_BOOL:
+        out(em, "Value " + t + " = value_bool(" +
+            std::to_string((int)n->get<BoolNode>().value) + ");");
+        return t;
+
+    case NODE_LIST:
+    {
+        ListNode &list = n->get<ListNode>();
+        out(em, "Value " + t + " = value_list();");
+        for (int i = 0; i < list.items.count; i++)
+        {
+            open_block(em);
+            std::string item = emit_expr(em, list.items.items[i]);
+            out(em, "value_list_append(&" + t + ", " + item + ");");
+            out(em, "value_free(" + item + ");");
+            close_block(em);
+        }
+        return t;
+    }
+
+    case NODE_MAP:
+    {
+        NodeList &items = n->get<MapNode>().items;
+        out(em, "Value " + t + " = value_map();");
+        for (int i = 0; i + 1 < items.count; i += 2)
+        {
+            open_block(em);
+            std::string key = emit_expr(em, items.items[i]);
+            std::string value = emit_expr(em, items.items[i + 1]);
+            out(em, "map_store(&" + t + ", &" + key + ", " + value + ", " + std::to_string(n->line) + ");");
+            out(em, "value_free(" + key + ");");
+            out(em, "value_free(" + value + ");");
+            close_block(em);
+        }
+        return t;
+    }
+
+    case NODE_IDENT:
+        out(em, "Value " + t + " = aot_get(" + env(em) + ", " +
+            c_string(n->get<IdentNode>().name) + ");");
+        return t;
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op == OP_AND || binop.op == OP_OR)
+        {
+            // The left value is the result unless it lets the right decide
+            std::string l = emit_expr(em, binop.left);
+            out(em, std::string("if (") + (binop.op == OP_AND ? "" : "!") + "is_truthy(" + l + "))");
+            open_block(em);
+            out(em, "value_free(" + l + ");");
+            std::string r = emit_expr(em, binop.right);
+            out(em, l + " = " + r + ";");
+            close_block(em);
+            em->cur_line = -1;
+            return l;
+        }
+        std::string l = emit_expr(em, binop.left);
+        std::string r = emit_expr(em, binop.right);
+        out(em, "Value " + t + " = aot_binop(" + binop_name(binop.op) + ", " + l + ", " + r + ");");
+        return t;
+    }
+
+    case NODE_NOT:
+    {
+        std::string v = emit_expr(em, n->get<NotNode>().expr);
+        out(em, "Value " + t + " = aot_not(" + v + ");");
+        return t;
+    }
+
+    case NODE_INDEX:
+    {
+        IndexNode &index = n->get<IndexNode>();
+        std::string target = emit_expr(em, index.target);
+        std::string i = emit_expr(em, index.index);
+        out(em, "Value " + t + " = aot_index(" + target + ", " + i + ");");
+        return t;
+    }
+
+    case NODE_INC:
+        out(em, "Value " + t + " = aot_step(" + env(em) + ", " +
+            c_string(n->get<IncNode>().name) + ", 1);");
+        return t;
+
+    case NODE_DEC:
+        out(em, "Value " + t + " = aot_step(" + env(em) + ", " +
+            c_string(n->get<DecNode>().name) + ", -1);");
+        return t;
+
+    case NODE_CALL:
+        return emit_call(em, n, 0);
+
+    case NODE_INPUT:
+        out(em, "Value " + t + " = aot_input(" + c_string(n->get<InputNode>().prompt) + ");");
+        return t;
+
+    default:
+        out(em, "Value " + t + " = value_null();");
+        return t;
+    }
+}
+
+static void emit_list(Emitter *em, NodeList &list)
+{
+    for (int i = 0; i < list.count; i++)
+    {
+        emit_stmt(em, list.items[i]);
+    }
+}
+
+// Runs list in a new scope, as the walker does for blocks and branches
+static void emit_scoped(Emitter *em, NodeList &list)
+{
+    if (list.count == 0)
+    {
+        return;
+    }
+    open_block(em);
+    push_scope(em);
+    emit_list(em, list);
+    pop_cleanup(em);
+    close_block(em);
+}
+
+// 'break' or 'continue': leaves the scopes in between, then jumps
+static void emit_jump(Emitter *em, int is_break)
+{
+    for (size_t i = em->flows.size(); i-- > 0; )
+    {
+        Flow &flow = em->flows[i];
+        if (!flow.is_loop && !is_break)
+        {
+            // 'continue' passes through a switch
+            continue;
+        }
+        unwind(em, flow.depth);
+        const std::string &label = is_break ? flow.end : flow.next;
+        out(em, label.empty() ? (is_break ? "break;" : "continue;") : "goto " + label + ";");
+        flow.used |= !label.empty();
+        return;
+    }
+
+    // Outside any loop the statement does nothing but end the enclosing
+    // statements, up to the function body or program
+    unwind(em, 1);
+    out(em, "goto " + em->stmt_end + ";");
+    em->stmt_end_used = 1;
+}
+
+static void emit_stmt(Emitter *em, AstNode *n)
+{
+    if (!n)
+    {
+        return;
+    }
+    open_block(em);
+    em->cur_line = -1;
+    set_line(em, n->line);
+    std::string e = env(em);
+
+    switch (n->kind)
+    {
+    case NODE_LET:
+    {
+        LetNode &let = n->get<LetNode>();
+        std::string v = emit_expr(em, let.expr);
+        out(em, "env_def(" + e + ", " + c_string(let.name) + ", " + v + ");");
+        out(em, "value_free(" + v + ");");
+        break;
+    }
+
+    case NODE_ASSIGN:
+    {
+        AssignNode &assign = n->get<AssignNode>();
+        AstNode *operands[SUM_MAX_OPERANDS];
+        int count = ast_self_append(n, operands);
+        if (count > 0)
+        {
+            std::string values;
+            for (int i = 0; i < count; i++)
+            {
+                values += (i ? ", " : "") + emit_expr(em, operands[i]);
+            }
+            std::string ops = temp(em, "s");
+            out(em, "Value " + ops + "[] = { " + values + " };");
+            out(em, "aot_assign_sum(" + e + ", " + c_string(assign.name) + ", " + ops + ", " + std::to_string(count) + ");");
+            break;
+        }
+        std::string v = emit_expr(em, assign.expr);
+        out(em, "env_assign(" + e + ", " + c_string(assign.name) + ", " + v + ");");
+        out(em, "value_free(" + v + ");");
+        break;
+    }
+
+    case NODE_ASSIGN_INDEX:
+    {
+        AssignIndexNode &node = n->get<AssignIndexNode>();
+        std::string v = emit_expr(em, node.value);
+        std::string target = emit_ref(em, node.list);
+        std::string line = std::to_string(n->line);
+        out(em, "if (" + target + " && (" + target + "->type == VAL_LIST || " + target + "->type == VAL_DENSE_LIST || " +
+            target + "->type == VAL_MAP))");
+        open_block(em);
+        std::string i = emit_expr(em, node.index);
+        out(em, "aot_assign_index(" + target + ", " + i + ", " + v + ", " + line + ");");
+        close_block(em);
+        out(em, "else");
+        open_block(em);
+        out(em, "aot_assign_index(" + target + ", value_null(), " + v + ", " + line + ");");
+        close_block(em);
+        break;
+    }
+
+    case NODE_PRINT:
+    {
+        NodeList &args = n->get<PrintNode>().args;
+        for (int i = 0; i < args.count; i++)
+        {
+            out(em, "aot_print(" + emit_expr(em, args.items[i]) + ");");
+        }
+        out(em, "printf(\"\\n\");");
+        break;
+    }
+
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        std::string c = emit_expr(em, node.cond);
+        out(em, "if (aot_truthy(" + c + "))");
+        open_block(em);
+        emit_scoped(em, node.then_block);
+        close_block(em);
+        if (node.else_block.count > 0)
+        {
+            out(em, "else");
+            open_block(em);
+            emit_scoped(em, node.else_block);
+            close_block(em);
+        }
+        break;
+    }
+
+    case NODE_WHILE:
+    {
+        WhileNode &node = n->get<WhileNode>();
+        out(em, "for (;;)");
+        open_block(em);
+        em->cur_line = -1;
+        std::string c = emit_expr(em, node.cond);
+        out(em, "if (!aot_truthy(" + c + ")) break;");
+        em->flows.push_back({ 1, em->cleanups.size(), "", "", 0 });
+        emit_scoped(em, node.body);
+        em->flows.pop_back();
+        close_block(em);
+        break;
+    }
+
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+        std::string next = temp(em, "next");
+        push_scope(em);
+        emit_stmt(em, node.init);
+        out(em, "for (;;)");
+        open_block(em);
+        em->cur_line = -1;
+        std::string c = emit_expr(em, node.cond);
+        out(em, "if (!aot_truthy(" + c + ")) break;");
+        em->flows.push_back({ 1, em->cleanups.size(), next, "", 0 });
+        emit_scoped(em, node.body);
+        if (em->flows.back().used)
+        {
+            out(em, next + ":;");
+        }
+        em->flows.pop_back();
+        emit_stmt(em, node.incr);
+        close_block(em);
+        pop_cleanup(em);
+        break;
+    }
+
+    case NODE_SWITCH:
+    {
+        SwitchNode &node = n->get<SwitchNode>();
+        std::string v = emit_expr(em, node.expr);
+        std::string end = temp(em, "switch_end");
+        em->cleanups.push_back({ 0, v });
+        em->flows.push_back({ 0, em->cleanups.size(), "", end, node.cases.count > 0 });
+        for (int i = 0; i < node.cases.count; i++)
+        {
+            CaseNode &c = node.cases.items[i]->get<CaseNode>();
+            open_block(em);
+            em->cur_line = -1;
+            std::string cv = emit_expr(em, c.value);
+            std::string eq = temp(em, "eq");
+            out(em, "int " + eq + " = switch_values_equal(" + v + ", " + cv + ");");
+            out(em, "value_free(" + cv + ");");
+            out(em, "if (" + eq + ")");
+            open_block(em);
+            emit_scoped(em, c.body);
+            out(em, "goto " + end + ";");
+            close_block(em);
+            close_block(em);
+        }
+        emit_scoped(em, node.default_case);
+        if (em->flows.back().used)
+        {
+            out(em, end + ":;");
+        }
+        em->flows.pop_back();
+        pop_cleanup(em);
+        break;
+    }
+
+    case NODE_BLOCK:
+        emit_scoped(em, n->get<BlockNode>().items);
+        break;
+
+    case NODE_GROUP:
+        emit_list(em, n->get<BlockNode>().items);
+        break;
+
+    case NODE_FUNC_DEF:
+    {
+        FuncDefNode &def = n->get<FuncDefNode>();
+        out(em, "env_def_func(" + e + ", " + c_string(def.name) + ", " +
+            func_name(em->func_ids[n]) + ");");
+        break;
+    }
+
+    case NODE_RETURN:
+    {
+        AstNode *expr = n->get<ReturnNode>().expr;
+        int tail = em->in_function && expr && expr->kind == NODE_CALL &&
+            expr->get<CallNode>().intrinsic == INTRINSIC_NONE;
+        std::string v = tail ? emit_call(em, expr, 1) : emit_expr(em, expr);
+        unwind(em, 1);
+        if (em->in_function)
+        {
+            out(em, "return " + v + ";");
+        }
+        else
+        {
+            // A top-level 'return' ends the program
+            out(em, "value_free(" + v + ");");
+            out(em, "goto done;");
+            em->done_used = 1;
+        }
+        break;
+    }
+
+    case NODE_BREAK:
+        emit_jump(em, 1);
+        break;
+
+    case NODE_CONTINUE:
+        emit_jump(em, 0);
+        break;
+
+    default:
+    {
+        std::string v = emit_expr(em, n);
+        out(em, "value_free(" + v + ");");
+        break;
+    }
+    }
+    close_block(em);
+    em->cur_line = -1;
+}
+
+// Emits the statements of a function body or of the program
+static void emit_body(Emitter *em, NodeList &list)
+{
+    for (int i = 0; i < list.count; i++)
+    {
+        em->stmt_end = temp(em, "stmt_end");
+        em->stmt_end_used = 0;
+        emit_stmt(em, list.items[i]);
+        if (em->stmt_end_used)
+        {
+            out(em, em->stmt_end + ":;");
+        }
+    }
+}
+
+// Gives every function definition in the tree an id
+static void collect_funcs(Emitter *em, AstNode *n);
+
+static void collect_list(Emitter *em, NodeList &list)
+{
+    for (int i = 0; i < list.count; i++)
+    {
+        collect_funcs(em, list.items[i]);
+    }
+}
+
+static void collect_funcs(Emitter *em, AstNode *n)
+{
+    if (!n)
+    {
+        return;
+    }
+    switch (n->kind)
+    {
+    case NODE_FUNC_DEF:
+    {
+        int id = (int)em->funcs.size();
+        em->funcs.push_back({ n, 0, 0, "", "", "", {}, 0, 0 });
+        em->func_ids[n] = id;
+        em->funcs_by_name[n->get<FuncDefNode>().name].push_back(id);
+        collect_list(em, n->get<FuncDefNode>().body);
+        break;
+    }
+    case NODE_IF:
+        collect_list(em, n->get<IfNode>().then_block);
+        collect_list(em, n->get<IfNode>().else_block);
+        break;
+    case NODE_WHILE:
+        collect_list(em, n->get<WhileNode>().body);
+        break;
+    case NODE_FOR:
+        collect_funcs(em, n->get<ForNode>().init);
+        collect_list(em, n->get<ForNode>().body);
+        break;
+    case NODE_SWITCH:
+    {
+        SwitchNode &node = n->get<SwitchNode>();
+        for (int i = 0; i < node.cases.count; i++)
+        {
+            collect_list(em, node.cases.items[i]->get<CaseNode>().body);
+        }
+        collect_list(em, node.default_case);
+        break;
+    }
+    case NODE_BLOCK:
+    case NODE_GROUP:
+        collect_list(em, n->get<BlockNode>().items);
+        break;
+    default:
+        break;
+    }
+}
+
+void emit_c(AstNode *prog, const char *source, const char *path, FILE *out_file)
+{
+    Emitter em;
+    em.temps = 0;
+    em.cur_line = -1;
+    em.indent = 1;
+    em.stmt_end_used = 0;
+    em.done_used = 0;
+    collect_funcs(&em, prog);
+
+    // Unboxed versions first: call sites need to know which exist
+    for (size_t id = 0; id < em.funcs.size(); id++)
+    {
+        emit_unboxed(&em.funcs[id], (int)id);
+    }
+
+    for (size_t id = 0; id < em.funcs.size(); id++)
+    {
+        EmitFunc &f = em.funcs[id];
+        std::string body;
+        em.buf = &body;
+        em.refs = &f.refs;
+        em.in_function = 1;
+        em.cleanups.assign(1, { 1, "e" });
+        em.flows.clear();
+        emit_body(&em, f.node->get<FuncDefNode>().body);
+        f.body = "// " + std::string(f.node->get<FuncDefNode>().name) + " (line " +
+            std::to_string(f.node->line) + ")\n";
+        f.body += "static Value " + func_name((int)id) + "_body(Env *e, AotFrame *frame)\n{\n";
+        f.body += "    (void)e;\n    (void)frame;\n" + body + "    return value_null();\n}\n\n";
+    }
+
+    std::string main_body;
+    CallRefs main_refs;
+    em.buf = &main_body;
+    em.refs = &main_refs;
+    em.in_function = 0;
+    em.cleanups.assign(1, { 1, "e" });
+    em.flows.clear();
+    if (prog->kind == NODE_BLOCK)
+    {
+        emit_body(&em, prog->get<BlockNode>().items);
+    }
+    else
+    {
+        NodeList single = { &prog, 1, 1 };
+        emit_body(&em, single);
+    }
+
+    // Only functions some emitted call site can run are written out, so the
+    // output compiles without unused function warnings
+    std::vector<CallRefs*> pending = { &main_refs };
+    while (!pending.empty())
+    {
+        CallRefs *refs = pending.back();
+        pending.pop_back();
+        for (int id : refs->unboxed)
+        {
+            em.funcs[id].unboxed_reached = 1;
+        }
+        for (int id : refs->bodies)
+        {
+            if (!em.funcs[id].reached)
+            {
+                em.funcs[id].reached = 1;
+                pending.push_back(&em.funcs[id].refs);
+            }
+        }
+    }
+
+    fprintf(out_file, "// Generated by luna --emit-c from %s\n", path);
+    fprintf(out_file, "#include <stdio.h>\n#include <luna/aot.h>\n\n");
+    fprintf(out_file, "static const char luna_source[] =\n    %s;\n\n", c_string(source).c_str());
+    for (size_t id = 0; id < em.funcs.size(); id++)
+    {
+        fprintf(out_file, "static AstNode *%s;\n", func_name((int)id).c_str());
+        if (em.funcs[id].reached)
+        {
+            fprintf(out_file, "static Value %s_body(Env *e, AotFrame *frame);\n", func_name((int)id).c_str());
+        }
+        if (em.funcs[id].unboxed_reached)
+        {
+            fprintf(out_file, "%s;\n", em.funcs[id].decl.c_str());
+        }
+    }
+    for (size_t i = 0; i < em.sites.size(); i++)
+    {
+        fprintf(out_file, "static CallNode site_%zu;\n", i);
+    }
+    fprintf(out_file, "\n");
+    for (EmitFunc &f : em.funcs)
+    {
+        if (f.unboxed_reached)
+        {
+            fprintf(out_file, "%s", f.code.c_str());
+        }
+        if (f.reached)
+        {
+            fprintf(out_file, "%s", f.body.c_str());
+        }
+    }
+
+    fprintf(out_file, "int main(void)\n{\n");
+    fprintf(out_file, "    Env *e = aot_start(luna_source, %s);\n", c_string(path).c_str());
+    for (size_t id = 0; id < em.funcs.size(); id++)
+    {
+        FuncDefNode &def = em.funcs[id].node->get<FuncDefNode>();
+        std::string params;
+        for (int i = 0; i < def.param_count; i++)
+        {
+            params += (i ? ", " : "") + c_string(def.params[i]);
+        }
+        fprintf(out_file, "    static const char *const %s_params[] = { %s };\n",
+            func_name((int)id).c_str(), def.param_count == 0 ? "nullptr" : params.c_str());
+        fprintf(out_file, "    %s = aot_function(%s, %s_params, %d, %d);\n", func_name((int)id).c_str(),
+            c_string(def.name).c_str(), func_name((int)id).c_str(), def.param_count, (int)def.memo);
+    }
+    for (size_t i = 0; i < em.sites.size(); i++)
+    {
+        fprintf(out_file, "    site_%zu.name = %s;\n", i, c_string(em.sites[i]).c_str());
+    }
+    fprintf(out_file, "%s", main_body.c_str());
+    fprintf(out_file, "%s    return aot_finish(e);\n}\n", em.done_used ? "done:\n" : "");
+}
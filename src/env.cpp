@@ -8,31 +8,112 @@
 #include "mystr.h"
 #include "luna_error.h"
 
-// Increased size and switched to power of 2 for better hash distribution
-#define TABLE_SIZE 512
-#define MAX_FUNCS 64
+// Scopes start empty and grow on demand; tables are powers of 2
+#define MIN_VARS 8
+#define MIN_FUNCS 4
+
+// Freed scopes are kept (with their buffers) for reuse, up to this many
+#define MAX_FREE_ENVS 256
+
+// Variable names are interned: each distinct name is stored once, right
+// after this record, and lives until exit
+typedef struct {
+    unsigned int hash;
+    int shadows; // Live bindings of the name in scopes other than a global one
+} VarName;
 
 // Structure to hold a variable name and its current value
 typedef struct {
-    char *name;
+    const char *name; // Interned
     Value val;
     int occupied; // Flag for hash table occupancy
 } VarEntry;
 
-// Structure to hold a function name and its AST definition
+// A function defined by a scope. The name is owned by the function table.
 typedef struct {
-    char *name;
-    AstNode *funcdef;
+    const char *name;
+    unsigned int hash;
+    int visible; // 0 if an earlier definition in the same scope hides it
 } FuncEntry;
 
-// The Environment structure, now using a Hash Table for variables
+// One definition of a function name and the scope that made it
+typedef struct {
+    AstNode *funcdef;
+    struct Env *owner;
+} FuncDef;
+
+// All live definitions of one function name, innermost last
+typedef struct {
+    char *name; // NULL for an empty bucket
+    unsigned int hash;
+    FuncDef *defs;
+    int count;
+    int capacity;
+} FuncBinding;
+
+// The Environment structure: a small hash table for named variables
 struct Env {
-    VarEntry vars[TABLE_SIZE]; 
-    FuncEntry funcs[MAX_FUNCS];
+    VarEntry *vars;     // Allocated on the first definition
+    int var_count;
+    int var_capacity;
+    FuncEntry *funcs;
     int func_count;
+    int func_capacity;
     struct Env *parent; // Pointer to the enclosing scope
+
+    // Variables resolved by the compiler live in slots, indexed directly.
+    // Slots are defined in order, so the first slot_count ones are in use.
+    Value *slots;
+    const char *const *slot_names; // Owned by the compiled function
+    int slot_count;
+    int slot_capacity;
+
+    struct Env *next_free;
 };
 
+// Functions are looked up by name in one table shared by all scopes. Live
+// scopes always form a single chain (each new scope is a child of the
+// current one and is freed before it), so the innermost definition of a
+// name is simply the last one made, and lookups do not walk the chain.
+static FuncBinding *func_table = NULL;
+static int func_table_count = 0;
+static int func_table_capacity = 0;
+
+static Env *free_envs = NULL;
+static int free_env_count = 0;
+static size_t heap_allocs = 0;
+
+// Changes whenever the set of visible functions may have changed
+static size_t func_epoch = 1;
+
+// Interned variable names, an open addressing table kept at most half full
+static VarName **name_table = NULL;
+static int name_count = 0;
+static int name_capacity = 0;
+
+// Changes whenever a global variable is added or moved, or the globals go
+static size_t var_shape = 1;
+
+// Counted wrappers so tests can check that scopes are recycled
+static void *env_alloc(size_t size) {
+    heap_allocs++;
+    return malloc(size);
+}
+
+static void *env_realloc(void *p, size_t size) {
+    heap_allocs++;
+    return realloc(p, size);
+}
+
+static char *env_strdup(const char *s) {
+    heap_allocs++;
+    return my_strdup(s);
+}
+
+size_t env_heap_allocs(void) {
+    return heap_allocs;
+}
+
 // djb2 hash algorithm for fast, high-quality string hashing
 static unsigned int hash_name(const char *str) {
     unsigned int hash = 5381;
@@ -40,32 +121,139 @@ static unsigned int hash_name(const char *str) {
     while ((c = *str++)) {
         hash = ((hash << 5) + hash) + c; // hash * 33 + c
     }
-    return hash % TABLE_SIZE;
+    return hash;
+}
+
+static const char *name_chars(VarName *v) {
+    return (const char *)(v + 1);
+}
+
+static VarName *name_record(const char *name) {
+    return (VarName *)name - 1;
+}
+
+// Finds the interned name, or the empty bucket where it would go
+static VarName **find_name(VarName **table, int capacity, const char *name, unsigned int h) {
+    unsigned int mask = (unsigned int)capacity - 1;
+    unsigned int i = h & mask;
+    while (table[i]) {
+        if (table[i]->hash == h && strcmp(name_chars(table[i]), name) == 0) {
+            return &table[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return &table[i];
+}
+
+static const char *intern_name(const char *name, unsigned int h) {
+    if ((name_count + 1) * 2 > name_capacity) {
+        int capacity = name_capacity ? name_capacity * 2 : 64;
+        VarName **table = (VarName **)env_alloc(sizeof(VarName *) * capacity);
+        memset(table, 0, sizeof(VarName *) * capacity);
+        for (int i = 0; i < name_capacity; i++) {
+            if (name_table[i]) {
+                *find_name(table, capacity, name_chars(name_table[i]), name_table[i]->hash) = name_table[i];
+            }
+        }
+        free(name_table);
+        name_table = table;
+        name_capacity = capacity;
+    }
+    VarName **slot = find_name(name_table, name_capacity, name, h);
+    if (!*slot) {
+        size_t len = strlen(name);
+        VarName *v = (VarName *)env_alloc(sizeof(VarName) + len + 1);
+        v->hash = h;
+        v->shadows = 0;
+        memcpy(v + 1, name, len + 1);
+        *slot = v;
+        name_count++;
+    }
+    return name_chars(*slot);
+}
+
+const char *env_intern(const char *name) {
+    return intern_name(name, hash_name(name));
+}
+
+// Finds the binding for name, or the empty bucket where it would go
+static FuncBinding *find_binding(const char *name, unsigned int h) {
+    unsigned int mask = (unsigned int)func_table_capacity - 1;
+    unsigned int i = h & mask;
+    while (func_table[i].name) {
+        if (func_table[i].hash == h && strcmp(func_table[i].name, name) == 0) {
+            return &func_table[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return &func_table[i];
 }
 
 // Creates a new environment scope, linking it to a parent scope
 Env *env_create(Env *parent) {
-    Env *e = calloc(1, sizeof(Env)); // Using calloc to zero-initialize the table
+    Env *e = free_envs;
     if (e) {
-        e->parent = parent;
+        // Reuse a freed scope; its tables are already empty
+        free_envs = e->next_free;
+        free_env_count--;
+    } else {
+        e = (Env *)env_alloc(sizeof(Env));
+        if (!e) {
+            return NULL;
+        }
+        memset(e, 0, sizeof(Env));
     }
+    e->parent = parent;
+    e->next_free = NULL;
     return e;
 }
 
-// Frees the environment and the memory used by its variables
+// Releases a scope's variables and puts it on the free-list
 void env_free(Env *e) {
     if (!e) {
         return;
     }
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (e->vars[i].occupied) {
-            free(e->vars[i].name);
-            value_free(e->vars[i].val);
+    if (e->var_count > 0) {
+        for (int i = 0; i < e->var_capacity; i++) {
+            if (e->vars[i].occupied) {
+                if (e->parent) {
+                    name_record(e->vars[i].name)->shadows--;
+                }
+                value_free(e->vars[i].val);
+                e->vars[i].occupied = 0;
+            }
+        }
+        e->var_count = 0;
+        if (!e->parent) {
+            var_shape++;
         }
     }
-    for (int i = 0; i < e->func_count; i++) {
-        free(e->funcs[i].name);
+    if (e->func_count > 0) {
+        for (int i = e->func_count - 1; i >= 0; i--) {
+            if (e->funcs[i].visible) {
+                find_binding(e->funcs[i].name, e->funcs[i].hash)->count--;
+            }
+        }
+        e->func_count = 0;
+        func_epoch++;
+    }
+    for (int i = 0; i < e->slot_count; i++) {
+        name_record(e->slot_names[i])->shadows--;
+        value_free(e->slots[i]);
+    }
+    e->slot_count = 0;
+    e->slot_names = NULL;
+    e->parent = NULL;
+
+    if (free_env_count < MAX_FREE_ENVS) {
+        e->next_free = free_envs;
+        free_envs = e;
+        free_env_count++;
+        return;
     }
+    free(e->vars);
+    free(e->funcs);
+    free(e->slots);
     free(e);
 }
 
@@ -77,19 +265,100 @@ void env_free_global(Env *env) {
     env_free(env);
 }
 
+// Returns the enclosing scope (NULL for the global scope)
+Env *env_parent(Env *e) {
+    return e->parent;
+}
+
+// Creates a scope with room for 'count' slot variables named by 'names'
+Env *env_create_slots(Env *parent, const char *const *names, int count) {
+    Env *e = env_create(parent);
+    if (!e) {
+        return NULL;
+    }
+    if (count > e->slot_capacity) {
+        free(e->slots);
+        e->slots = (Value *)env_alloc(sizeof(Value) * count);
+        e->slot_capacity = count;
+    }
+    e->slot_names = names;
+    return e;
+}
+
+// Returns slot 'slot' of the scope 'depth' levels above e
+Value *env_slot(Env *e, int depth, int slot) {
+    while (depth-- > 0) {
+        e = e->parent;
+    }
+    return &e->slots[slot];
+}
+
+// Defines (or redefines) a slot variable, taking ownership of val
+void env_def_slot(Env *e, int slot, Value val) {
+    if (slot < e->slot_count) {
+        value_free(e->slots[slot]);
+        e->slots[slot] = val;
+        return;
+    }
+    while (e->slot_count < slot) {
+        name_record(e->slot_names[e->slot_count])->shadows++;
+        e->slots[e->slot_count++] = value_null();
+    }
+    name_record(e->slot_names[slot])->shadows++;
+    e->slots[e->slot_count++] = val;
+}
+
+// Finds the entry for name, or the empty entry where it would be inserted
+static VarEntry *find_entry(VarEntry *vars, int capacity, const char *name, unsigned int h) {
+    unsigned int mask = (unsigned int)capacity - 1;
+    unsigned int i = h & mask;
+    while (vars[i].occupied) {
+        if (strcmp(vars[i].name, name) == 0) {
+            return &vars[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return &vars[i];
+}
+
+// Doubles the variable table, which is kept at most half full
+static void grow_vars(Env *e) {
+    int capacity = e->var_capacity ? e->var_capacity * 2 : MIN_VARS;
+    VarEntry *vars = (VarEntry *)env_alloc(sizeof(VarEntry) * capacity);
+    memset(vars, 0, sizeof(VarEntry) * capacity);
+    for (int i = 0; i < e->var_capacity; i++) {
+        if (e->vars[i].occupied) {
+            const char *name = e->vars[i].name;
+            *find_entry(vars, capacity, name, hash_name(name)) = e->vars[i];
+        }
+    }
+    free(e->vars);
+    e->vars = vars;
+    e->var_capacity = capacity;
+}
+
 // Looks up a variable by name using the hash table, traversing up the scope chain
 Value *env_get(Env *e, const char *name) {
+    unsigned int h = 0;
+    int hashed = 0;
     Env *cur_env = e;
     while (cur_env) {
-        unsigned int h = hash_name(name);
-        unsigned int start_index = h;
+        // Slot variables are still visible by name to called functions
+        for (int i = 0; i < cur_env->slot_count; i++) {
+            if (strcmp(cur_env->slot_names[i], name) == 0) {
+                return &cur_env->slots[i];
+            }
+        }
 
-        while (cur_env->vars[h].occupied) {
-            if (strcmp(cur_env->vars[h].name, name) == 0) {
-                return &cur_env->vars[h].val;
+        if (cur_env->var_count > 0) {
+            if (!hashed) {
+                h = hash_name(name);
+                hashed = 1;
+            }
+            VarEntry *entry = find_entry(cur_env->vars, cur_env->var_capacity, name, h);
+            if (entry->occupied) {
+                return &entry->val;
             }
-            h = (h + 1) % TABLE_SIZE;
-            if (h == start_index) break; // Table is full and item not found
         }
         cur_env = cur_env->parent;
     }
@@ -98,27 +367,84 @@ Value *env_get(Env *e, const char *name) {
 
 // Defines a new variable in the current scope using the hash table
 void env_def(Env *e, const char *name, Value val) {
+    if ((e->var_count + 1) * 2 > e->var_capacity) {
+        grow_vars(e);
+    }
+
     unsigned int h = hash_name(name);
-    unsigned int start_index = h;
+    VarEntry *entry = find_entry(e->vars, e->var_capacity, name, h);
 
-    while (e->vars[h].occupied) {
-        // If the variable already exists in the current scope, overwrite it
-        if (strcmp(e->vars[h].name, name) == 0) {
-            value_free(e->vars[h].val);
-            e->vars[h].val = value_copy(val);
-            return;
-        }
-        h = (h + 1) % TABLE_SIZE;
-        if (h == start_index) {
-            fprintf(stderr, "Runtime Error: Environment variable limit reached.\n");
-            return;
+    // If the variable already exists in the current scope, overwrite it
+    if (entry->occupied) {
+        value_free(entry->val);
+        entry->val = value_copy(val);
+        return;
+    }
+
+    // Insert new entry. A global moves the cached ones (the table may have
+    // grown) and may be what a cached undefined name now finds; any other
+    // scope may hide a global of the same name.
+    entry->name = intern_name(name, h);
+    entry->val = value_copy(val);
+    entry->occupied = 1;
+    e->var_count++;
+    if (e->parent) {
+        name_record(entry->name)->shadows++;
+    } else {
+        var_shape++;
+    }
+}
+
+size_t env_var_shape(void) {
+    return var_shape;
+}
+
+// env_get for a site that keeps a cache. While no scope other than a
+// global one binds the name, the lookup can only end in the global scope,
+// whose variables stay in place until one is added.
+Value *env_get_cached(Env *e, const char *name, GlobalCache *cache) {
+    if (cache->shadows && *cache->shadows == 0 && cache->shape == var_shape) {
+        return cache->slot;
+    }
+    Value *v = env_get(e, name);
+    if (!cache->shadows) {
+        cache->shadows = &name_record(env_intern(name))->shadows;
+    }
+    if (*cache->shadows == 0) {
+        cache->slot = v;
+        cache->shape = var_shape;
+    }
+    return v;
+}
+
+static int name_in(const char *name, const char *const *names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return 1;
         }
     }
+    return 0;
+}
 
-    // Insert new entry
-    e->vars[h].name = my_strdup(name);
-    e->vars[h].val = value_copy(val);
-    e->vars[h].occupied = 1;
+// Used before a tail call drops a scope: the callee must not be able to
+// tell that the scope is gone
+int env_binds_only(Env *e, const char *const *names, int count) {
+    if (e->func_count > 0) {
+        return 0;
+    }
+    for (int i = 0; i < e->slot_count; i++) {
+        if (!name_in(e->slot_names[i], names, count)) {
+            return 0;
+        }
+    }
+    if (e->var_count > 0) {
+        for (int i = 0; i < e->var_capacity; i++) {
+            if (e->vars[i].occupied && !name_in(e->vars[i].name, names, count)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
 }
 
 // Updates an existing variable, traversing up the scope chain
@@ -130,31 +456,74 @@ void env_assign(Env *e, const char *name, Value val) {
         return;
     }
 
-    const char *suggestion = suggest_for_undefined_var(name);
-    error_report(ERR_NAME, 0, 0, 
-        suggestion ? suggestion : "Variable is not defined", 
+    std::string suggestion = suggest_for_undefined_var(name);
+    error_report(ERR_NAME, 0, 0,
+        !suggestion.empty() ? suggestion.c_str() : "Variable is not defined",
         "Declare variables with 'let' before assigning to them");
 }
 
+// Doubles the function table, which is kept at most half full
+static void grow_func_table(void) {
+    int old_capacity = func_table_capacity;
+    FuncBinding *old = func_table;
+    func_table_capacity = old_capacity ? old_capacity * 2 : MIN_FUNCS * 4;
+    func_table = (FuncBinding *)env_alloc(sizeof(FuncBinding) * func_table_capacity);
+    memset(func_table, 0, sizeof(FuncBinding) * func_table_capacity);
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].name) {
+            *find_binding(old[i].name, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+}
+
 // Defines a function in the current scope
 void env_def_func(Env *e, const char *name, AstNode *def) {
-    if (e->func_count < MAX_FUNCS) {
-        e->funcs[e->func_count].name = my_strdup(name);
-        e->funcs[e->func_count].funcdef = def;
-        e->func_count++;
+    if ((func_table_count + 1) * 2 > func_table_capacity) {
+        grow_func_table();
     }
+    unsigned int h = hash_name(name);
+    FuncBinding *b = find_binding(name, h);
+    if (!b->name) {
+        b->name = env_strdup(name);
+        b->hash = h;
+        func_table_count++;
+    }
+
+    if (e->func_count == e->func_capacity) {
+        int capacity = e->func_capacity ? e->func_capacity * 2 : MIN_FUNCS;
+        e->funcs = (FuncEntry *)env_realloc(e->funcs, sizeof(FuncEntry) * capacity);
+        e->func_capacity = capacity;
+    }
+    FuncEntry *entry = &e->funcs[e->func_count++];
+    entry->name = b->name;
+    entry->hash = h;
+
+    // Within one scope the first definition of a name is the one called
+    entry->visible = !(b->count > 0 && b->defs[b->count - 1].owner == e);
+    if (entry->visible) {
+        if (b->count == b->capacity) {
+            b->capacity = b->capacity ? b->capacity * 2 : 2;
+            b->defs = (FuncDef *)env_realloc(b->defs, sizeof(FuncDef) * b->capacity);
+        }
+        b->defs[b->count].funcdef = def;
+        b->defs[b->count].owner = e;
+        b->count++;
+    }
+    func_epoch++;
+}
+
+// Call sites cache what they resolved to for as long as this is unchanged
+size_t env_func_epoch(void) {
+    return func_epoch;
 }
 
-// Looks up a function definition
+// Looks up a function definition. e must be the current (innermost) scope.
 AstNode *env_get_func(Env *e, const char *name) {
-    Env *cur_env = e;
-    while (cur_env) {
-        for (int i = 0; i < cur_env->func_count; i++) {
-            if (strcmp(cur_env->funcs[i].name, name) == 0) {
-                return cur_env->funcs[i].funcdef;
-            }
-        }
-        cur_env = cur_env->parent;
+    (void)e;
+    if (func_table_count == 0) {
+        return NULL;
     }
-    return NULL;
-}
\ No newline at end of file
+    FuncBinding *b = find_binding(name, hash_name(name));
+    return b->count > 0 ? b->defs[b->count - 1].funcdef : NULL;
+}
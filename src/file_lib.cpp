@@ -7,6 +7,7 @@
 #include <luna/file_lib.h>
 #include <luna/value.h>
 #include <luna/mystr.h>
+#include <luna/temp.h>
 
 // Helper: Safely extract the FILE pointer from a Luna Value
 static FILE *get_file_ptr(Value v)
@@ -41,8 +42,8 @@ Value lib_file_open(int argc, Value *argv)
         return value_null();
     }
 
-    const char *path = argv[0].s;
-    const char *mode = argv[1].s;
+    const char *path = value_chars(&argv[0]);
+    const char *mode = value_chars(&argv[1]);
 
     FILE *f = fopen(path, mode);
     if (!f)
@@ -135,9 +136,10 @@ Value lib_file_write(int argc, Value *argv)
     }
 
     // Convert any Luna type to string before writing
-    char *text = value_to_string(argv[1]);
-    int res = fputs(text, f);
-    free(text);
+    TempMark mark = temp_mark();
+    size_t len;
+    int res = fputs(value_temp_string(&argv[1], &len), f);
+    temp_release(mark);
 
     return value_bool(res != EOF);
 }
@@ -150,7 +152,7 @@ Value lib_file_exists(int argc, Value *argv)
     if (argv[0].type != VAL_STRING)
         return value_bool(0);
 
-    FILE *f = fopen(argv[0].s, "r");
+    FILE *f = fopen(value_chars(&argv[0]), "r");
     if (f)
     {
         fclose(f);
@@ -167,7 +169,7 @@ Value lib_file_remove(int argc, Value *argv)
     if (argv[0].type != VAL_STRING)
         return value_bool(0);
 
-    int res = remove(argv[0].s);
+    int res = remove(value_chars(&argv[0]));
     return value_bool(res == 0);
 }
 
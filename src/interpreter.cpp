@@ -7,6 +7,9 @@
 #include <limits.h>
 #include <math.h> // Added for fabs()
 #include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #include <luna/interpreter.h>
 #include <luna/ast.h>
 #include <luna/value.h>
@@ -15,27 +18,16 @@
 #include <luna/library.h>
 #include <luna/luna_error.h>
 #include <luna/vec_lib.h>
-constexpr float EPSILON = static_cast<float>(0.000001);
+#include <luna/bytecode.h>
+#include <luna/vm.h>
+#include <luna/memo.h>
+#include <luna/temp.h>
 
-// Flags to handle 'return' statements across recursive calls
-typedef struct
-{
-    int active;
-    Value value;
-} ReturnException;
-
-// Flags to handle 'break' and 'continue' inside loops
-typedef struct
-{
-    int break_active;
-    int continue_active;
-} LoopException;
-
-static ReturnException return_exception = {0};
-static LoopException loop_exception = {0};
+// Execution engine selection (see interpreter.h)
+int luna_use_tree_walker = 0;
 
 // Centralized Truthiness Logic ~~~
-static int is_truthy(Value v)
+int is_truthy(Value v)
 {
     switch (v.type)
     {
@@ -46,11 +38,14 @@ static int is_truthy(Value v)
     case VAL_FLOAT:
         return v.f != 0.0;
     case VAL_STRING:
-        return v.s && v.s[0] != '\0'; // Empty strings are false
+        return value_chars(&v)[0] != '\0'; // Empty strings are false
     case VAL_NULL:
         return 0;
     case VAL_LIST:
+    case VAL_DENSE_LIST:
         return 1; // Lists are always true (even empty ones, usually)
+    case VAL_MAP:
+        return 1;
     case VAL_NATIVE:
         return 1;
     case VAL_CHAR:
@@ -63,7 +58,6 @@ static int is_truthy(Value v)
 }
 
 static Value eval_expr(Env *e, AstNode *n);
-static Value exec_stmt(Env *e, AstNode *n);
 
 // Recursively finds the actual memory location of a variable or list item
 // Used for assigning values to specific list indices (e.g. x[0] = 5)
@@ -71,12 +65,22 @@ static Value *get_mutable_value(Env *e, AstNode *n)
 {
     if (n->kind == NODE_IDENT)
     {
-        return env_get(e, n->get<IdentNode>().name.c_str());
+        IdentNode &ident = n->get<IdentNode>();
+        return env_get_cached(e, ident.name, &ident.cache);
     }
     else if (n->kind == NODE_INDEX)
     {
         // Recursively get the parent list
         Value *list = get_mutable_value(e, n->get<IndexNode>().target);
+        if (list && list->type == VAL_MAP)
+        {
+            // Missing keys are not added on the way to the item
+            Value key = eval_expr(e, n->get<IndexNode>().index);
+            value_map_unique(list);
+            Value *item_ptr = value_map_find(list, &key);
+            value_free(key);
+            return item_ptr;
+        }
         if (!list || list->type != VAL_LIST)
         {
             return nullptr;
@@ -91,7 +95,7 @@ static Value *get_mutable_value(Env *e, AstNode *n)
         }
 
         // Check bounds
-        if (idx.i < 0 || idx.i >= list->list.count)
+        if (idx.i < 0 || idx.i >= list->list->count)
         {
             char msg[128];
             snprintf
@@ -100,7 +104,7 @@ static Value *get_mutable_value(Env *e, AstNode *n)
                 sizeof(msg), 
                 "Index %lld is out of bounds for list of length %d", 
                 idx.i, 
-                list->list.count
+                list->list->count
             );
             // Updated to use n->line from the AST node
             error_report
@@ -115,16 +119,329 @@ static Value *get_mutable_value(Env *e, AstNode *n)
             return nullptr;
         }
 
-        // Return pointer to the specific item slot
-        Value *item_ptr = &list->list.items[idx.i];
+        // Return pointer to the specific item slot, unsharing the list first
+        value_list_unique(list);
+        Value *item_ptr = &list->list->items[idx.i];
         value_free(idx);
         return item_ptr;
     }
     return nullptr;
 }
 
+// Arguments of a native call made by the AST walker. Calls with up to
+// NATIVE_INLINE_ARGS arguments keep them in the struct instead of the heap.
+// Each argument is either owned (freed after the call) or borrowed from a
+// variable.
+#define NATIVE_INLINE_ARGS 8
+
+typedef struct
+{
+    Value *argv;
+    unsigned char *borrowed;
+    Value inline_argv[NATIVE_INLINE_ARGS];
+    unsigned char inline_borrowed[NATIVE_INLINE_ARGS];
+} NativeArgs;
+
+static void native_args_init(NativeArgs *args, int argc)
+{
+    if (argc <= NATIVE_INLINE_ARGS)
+    {
+        args->argv = args->inline_argv;
+        args->borrowed = args->inline_borrowed;
+        return;
+    }
+    args->argv = static_cast<Value*>(malloc(sizeof(Value) * argc));
+    args->borrowed = static_cast<unsigned char*>(malloc(argc));
+}
+
+static void native_args_free(NativeArgs *args, int argc)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        if (!args->borrowed[i])
+        {
+            value_free(args->argv[i]);
+        }
+    }
+    if (args->argv != args->inline_argv)
+    {
+        free(args->argv);
+        free(args->borrowed);
+    }
+}
+
+// How a statement finished. Anything but EXEC_NORMAL stops the enclosing
+// statements until the loop, switch or call that handles it.
+typedef enum
+{
+    EXEC_NORMAL,
+    EXEC_BREAK,
+    EXEC_CONTINUE,
+    EXEC_RETURN
+} ExecStatus;
+
+// State of the user function call being executed. Each call keeps its own
+// on the C stack, so the walker holds no control flow state between calls.
+typedef struct
+{
+    Env *scope;                             // Call scope (null at the top level)
+    Value ret;                              // Set with EXEC_RETURN
+    AstNode *tail_fn;                       // 'return f(...)' left for the call loop
+    Value tail_args[NATIVE_INLINE_ARGS];    // Its evaluated arguments
+} CallFrame;
+
+static ExecStatus exec_stmt(Env *e, AstNode *n, CallFrame *frame);
+
+// Runs the body of fn in scope, which binds its parameters, and frees the
+// scope. Tail calls made by the body run here, in place of the call.
+static Value run_call(Env *e, Env *scope, AstNode *fn)
+{
+    CallFrame frame;
+    frame.ret = value_null();
+    frame.tail_fn = nullptr;
+    while (1)
+    {
+        // Execute function body. A stray break or continue outside
+        // a loop does nothing, as in the VM.
+        frame.scope = scope;
+        FuncDefNode& body_def = fn->get<FuncDefNode>();
+        ExecStatus status = EXEC_NORMAL;
+        for (int i = 0; i < body_def.body.count && status != EXEC_RETURN; i++)
+        {
+            status = exec_stmt(scope, body_def.body.items[i], &frame);
+        }
+        if (!frame.tail_fn)
+        {
+            break;
+        }
+
+        // Tail call: the callee takes over this call's scope
+        fn = frame.tail_fn;
+        frame.tail_fn = nullptr;
+        env_free(scope);
+        scope = env_create(e);
+        FuncDefNode& callee = fn->get<FuncDefNode>();
+        for (int i = 0; i < callee.param_count; i++)
+        {
+            env_def(scope, callee.params[i], frame.tail_args[i]);
+            value_free(frame.tail_args[i]);
+        }
+    }
+    env_free(scope);
+
+    // The return value is handed over, not copied
+    return frame.ret;
+}
+
+// Calls a 'memo func': the arguments are evaluated first so the result can
+// be looked up before running the body
+static Value call_memo(Env *e, AstNode *fn, CallNode &call)
+{
+    FuncDefNode& funcdef = fn->get<FuncDefNode>();
+    int argc = call.args.count < funcdef.param_count ?
+        call.args.count : funcdef.param_count;
+    NativeArgs args;
+    native_args_init(&args, argc);
+    for (int i = 0; i < argc; i++)
+    {
+        args.argv[i] = eval_expr(e, call.args.items[i]);
+        args.borrowed[i] = 0;
+    }
+
+    Value res;
+    MemoKey key = memo_key(fn, args.argv, argc);
+    if (!memo_lookup(fn, key, args.argv, argc, &res))
+    {
+        Env *scope = env_create(e);
+        for (int i = 0; i < funcdef.param_count; i++)
+        {
+            env_def(scope, funcdef.params[i], i < argc ? args.argv[i] : value_null());
+        }
+        res = run_call(e, scope, fn);
+        memo_store(fn, key, args.argv, argc, res);
+    }
+    native_args_free(&args, argc);
+    return res;
+}
+
+// Returns the user function 'return expr' can tail call, or nullptr. The
+// call must leave nothing behind that the callee could see: every scope of
+// the current call binds only names the callee's parameters hide.
+static AstNode *tail_call_target(Env *e, AstNode *expr, Env *frame_scope)
+{
+    if (!frame_scope || !expr || expr->kind != NODE_CALL)
+    {
+        return nullptr;
+    }
+    CallNode& call = expr->get<CallNode>();
+    if (call.intrinsic != INTRINSIC_NONE)
+    {
+        return nullptr;
+    }
+    // Memoized functions are always called, so their results are cached
+    AstNode *fn = call_resolve(e, call).fn;
+    if (!fn || fn->get<FuncDefNode>().memo)
+    {
+        return nullptr;
+    }
+    const FuncDefNode& callee = fn->get<FuncDefNode>();
+    if (callee.param_count > NATIVE_INLINE_ARGS)
+    {
+        return nullptr;
+    }
+    for (Env *scope = e; ; scope = env_parent(scope))
+    {
+        if (!env_binds_only(scope, callee.params, callee.param_count))
+        {
+            return nullptr;
+        }
+        if (scope == frame_scope)
+        {
+            return fn;
+        }
+    }
+}
+
+// Evaluates an expression for reading only. Variables and list items are
+// returned in place instead of being copied; anything else is evaluated
+// into *tmp. The caller frees *tmp when done and must not change the
+// environment while holding the pointer.
+static const Value *eval_borrow(Env *e, AstNode *n, Value *tmp)
+{
+    *tmp = value_null();
+    if (n->kind == NODE_IDENT)
+    {
+        IdentNode &ident = n->get<IdentNode>();
+        Value *v = env_get_cached(e, ident.name, &ident.cache);
+        return v ? v : tmp;
+    }
+    if (n->kind == NODE_INDEX && ast_is_pure(n->get<IndexNode>().index))
+    {
+        IndexNode& index_node = n->get<IndexNode>();
+        const Value *target = eval_borrow(e, index_node.target, tmp);
+        Value idx = eval_expr(e, index_node.index);
+        const Value *item = nullptr;
+        if (target->type == VAL_LIST && idx.type == VAL_INT)
+        {
+            if (idx.i >= 0 && idx.i < target->list->count)
+            {
+                item = &target->list->items[idx.i];
+            }
+        }
+        else if (target->type == VAL_MAP)
+        {
+            item = value_map_find(target, &idx);
+        }
+        else if (target->type == VAL_DENSE_LIST && idx.type == VAL_INT)
+        {
+            // Items are not Values, so the one read is made in *tmp
+            Value res = value_null();
+            if (idx.i >= 0 && idx.i < target->dlist->count)
+            {
+                res = value_float(target->dlist->data[idx.i]);
+            }
+            value_free(idx);
+            value_free(*tmp);
+            *tmp = res;
+            return tmp;
+        }
+        value_free(idx);
+        if (target != tmp)
+        {
+            return item ? item : tmp;
+        }
+
+        // The list itself was a temporary, so the item has to be copied out
+        Value res = item ? value_copy(*item) : value_null();
+        value_free(*tmp);
+        *tmp = res;
+        return tmp;
+    }
+    *tmp = eval_expr(e, n);
+    return tmp;
+}
+
+// Evaluates a chain a + b + c + ... of two or more '+'
+static Value eval_sum(Env *e, AstNode *n)
+{
+    AstNode *nodes[SUM_MAX_OPERANDS];
+    Value values[SUM_MAX_OPERANDS];
+    int count = ast_sum_operands(n, nodes, SUM_MAX_OPERANDS);
+    for (int i = 0; i < count; i++)
+    {
+        values[i] = eval_expr(e, nodes[i]);
+    }
+    return sum_values(values, count);
+}
+
+// Adds values left to right as eval_binop would, but once the sum is a
+// string the rest is concatenated in temp memory and only the result is
+// allocated. Takes the values.
+Value sum_values(Value *values, int count)
+{
+    Value sum = values[0];
+    int i = 1;
+    while (i < count && sum.type != VAL_STRING && values[i].type != VAL_STRING)
+    {
+        Value next = eval_binop(OP_ADD, sum, values[i]);
+        value_free(sum);
+        value_free(values[i]);
+        sum = next;
+        i++;
+    }
+    if (i == count)
+    {
+        return sum;
+    }
+
+    TempMark mark = temp_mark();
+    const char *text[SUM_MAX_OPERANDS];
+    size_t len[SUM_MAX_OPERANDS];
+    text[0] = value_temp_string(&sum, &len[0]);
+    size_t total = len[0];
+    for (int j = i; j < count; j++)
+    {
+        text[j] = value_temp_string(&values[j], &len[j]);
+        total += len[j];
+    }
+    Value res = value_string_alloc(total);
+    char *out = value_chars(&res);
+    memcpy(out, text[0], len[0]);
+    out += len[0];
+    for (int j = i; j < count; j++)
+    {
+        memcpy(out, text[j], len[j]);
+        out += len[j];
+        value_free(values[j]);
+    }
+    value_free(sum);
+    temp_release(mark);
+    return res;
+}
+
+// 'x = x + a + ...' with values holding x and the operands: when *var still
+// holds the string read into values[0] and nothing else shares it, the
+// operands are appended to it in place (taking the values) and 1 returned.
+// Otherwise the values are left for sum_values.
+int append_sum(Value *var, Value *values, int count)
+{
+    Value head = values[0];
+    if (!var || var->type != VAL_STRING || head.type != VAL_STRING || var->small || head.small ||
+        var->string != head.string || head.string->refcount != 2)
+    {
+        return 0;
+    }
+    value_free(head);
+    for (int i = 1; i < count; i++)
+    {
+        value_string_append_value(var, &values[i]);
+        value_free(values[i]);
+    }
+    return 1;
+}
+
 // Handles binary operations like +, -, *, /, comparison
-static Value eval_binop(BinOpKind op, Value l, Value r)
+Value eval_binop(BinOpKind op, Value l, Value r)
 {
     // 1. Handle Pure Integer Operations separately to preserve precision/types
     if (l.type == VAL_INT && r.type == VAL_INT)
@@ -232,13 +549,14 @@ static Value eval_binop(BinOpKind op, Value l, Value r)
     // Handle String Equality
     if (l.type == VAL_STRING && r.type == VAL_STRING)
     {
+        int same = value_string_equal(&l, &r);
         if (op == OP_EQ)
         {
-            return value_bool(strcmp(l.s, r.s) == 0);
+            return value_bool(same);
         }   
         if (op == OP_NEQ)
         {
-            return value_bool(strcmp(l.s, r.s) != 0);
+            return value_bool(!same);
         }
     }
 
@@ -291,18 +609,21 @@ static Value eval_binop(BinOpKind op, Value l, Value r)
     // Handle String Concatenation
     if (op == OP_ADD && (l.type == VAL_STRING || r.type == VAL_STRING))
     {
-        char *sl = value_to_string(l);
-        char *sr = value_to_string(r);
-        char *comb = static_cast<char*>(malloc(strlen(sl) + strlen(sr) + 1));
-        strcpy(comb, sl);
-        strcat(comb, sr);
-        free(sl);
-        free(sr);
-        Value v = value_string(comb);
-        free(comb);
+        // Only the result is allocated; strings are read in place
+        TempMark mark = temp_mark();
+        size_t ll, rl;
+        const char *sl = value_temp_string(&l, &ll);
+        const char *sr = value_temp_string(&r, &rl);
+        Value v = value_string_alloc(ll + rl);
+        char *out = value_chars(&v);
+        memcpy(out, sl, ll);
+        memcpy(out + ll, sr, rl);
+        temp_release(mark);
         return v;
     }
-    if (l.type == VAL_LIST && r.type == VAL_LIST)
+    // Dense and boxed lists mix; see vec_lib.cpp for the result's type
+    if ((l.type == VAL_LIST || l.type == VAL_DENSE_LIST) &&
+        (r.type == VAL_LIST || r.type == VAL_DENSE_LIST))
     {
         switch (op)
         {
@@ -321,6 +642,258 @@ static Value eval_binop(BinOpKind op, Value l, Value r)
     return value_null();
 }
 
+// Built-in: len() - length of a string, list or map, 0 for anything else
+Value builtin_len(Value v)
+{
+    size_t len = 0;
+    if (v.type == VAL_STRING)
+    {
+        len = value_length(&v);
+    }
+    if (v.type == VAL_LIST)
+    {
+        len = v.list->count;
+    }
+    if (v.type == VAL_DENSE_LIST)
+    {
+        len = v.dlist->count;
+    }
+    if (v.type == VAL_MAP)
+    {
+        len = v.map->count;
+    }
+    return value_int(len);
+}
+
+// Built-in: type() - Returns type name ("int", "long", "float", etc)
+Value builtin_type(Value v)
+{
+    const char *tname = "unknown";
+    switch (v.type)
+    {
+    case VAL_INT:
+        // Check magnitude to differentiate int vs long for user
+        // Assumes standard 32-bit int limits for "int" label
+        if (v.i > INT_MAX || v.i < INT_MIN)
+        {
+            tname = "long";
+        }
+        else
+        {
+            tname = "int";
+        }
+        break;
+    case VAL_FLOAT:
+        tname = "float";
+        break;
+    case VAL_STRING:
+        tname = "string";
+        break;
+    case VAL_CHAR:
+        tname = "char";
+        break;
+    case VAL_BOOL:
+        tname = "boolean";
+        break;
+    case VAL_LIST:
+        tname = "list";
+        break;
+    case VAL_DENSE_LIST:
+        tname = "dense_list";
+        break;
+    case VAL_MAP:
+        tname = "map";
+        break;
+    case VAL_NATIVE:
+        tname = "native_function";
+        break;
+    case VAL_NULL:
+        tname = "null";
+        break;
+    default:
+        break;
+    }
+    return value_string(tname);
+}
+
+// Built-in: int()
+Value builtin_int(Value v)
+{
+    long long res = 0;
+    if (v.type == VAL_STRING)
+    {
+        res = atoll(value_chars(&v));
+    }
+    else if (v.type == VAL_FLOAT)
+    {
+        res = (long long)v.f;
+    }
+    else if (v.type == VAL_INT)
+    {
+        res = v.i;
+    }
+    else if (v.type == VAL_BOOL)
+    {
+        res = v.b;
+    }
+    else if (v.type == VAL_CHAR)
+    {
+        res = (long long)v.c;
+    }
+    return value_int(res);
+}
+
+// Built-in: float()
+Value builtin_float(Value v)
+{
+    double res = 0.0;
+    if (v.type == VAL_STRING)
+    {
+        res = atof(value_chars(&v));
+    }
+    else if (v.type == VAL_INT)
+    {
+        res = static_cast<double>(v.i);
+    }
+    else if (v.type == VAL_FLOAT)
+    {
+        res = v.f;
+    }
+    else if (v.type == VAL_BOOL)
+    {
+        res = v.b ? 1.0 : 0.0;
+    }
+    return value_float(res);
+}
+
+// map[key] = value for every engine; reports keys maps cannot hold
+void map_store(Value *map, const Value *key, Value value, int line)
+{
+    Value *slot = value_map_slot(map, key);
+    if (!slot)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Map keys must be int, string, char or bool",
+            "Convert the key first, e.g., counts[to_string(x)] = 1"
+        );
+        return;
+    }
+    value_free(*slot);
+    *slot = value_copy(value);
+}
+
+// dense[index] = value for every engine. Items are floats, so only numbers
+// can be stored.
+void dense_store(Value *dense, const Value *index, Value value, int line)
+{
+    if (index->type != VAL_INT)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "List index must be an integer",
+            "Use integer values for list indices, e.g., myList[0] or myList[i]"
+        );
+        return;
+    }
+    if (index->i < 0 || index->i >= dense->dlist->count)
+    {
+        char msg[128];
+        snprintf
+        (
+            msg,
+            sizeof(msg),
+            "Index %lld is out of bounds for list of length %d",
+            index->i, dense->dlist->count
+        );
+        error_report
+        (
+            ERR_INDEX,
+            line,
+            0,
+            msg,
+            "Ensure your index is between 0 and len(list)-1"
+        );
+        return;
+    }
+    if (value.type != VAL_INT && value.type != VAL_FLOAT)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Dense lists can only hold numbers",
+            "Store an int or float, or use a plain list for other values"
+        );
+        return;
+    }
+    value_dlist_unique(dense);
+    dense->dlist->data[index->i] = value.type == VAL_INT ? (double)value.i : value.f;
+}
+
+// append(dense, value) for every engine
+void dense_append(Value *dense, Value value, int line)
+{
+    if (value.type != VAL_INT && value.type != VAL_FLOAT)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Dense lists can only hold numbers",
+            "Store an int or float, or use a plain list for other values"
+        );
+        return;
+    }
+    value_dlist_append(dense, value.type == VAL_INT ? (double)value.i : value.f);
+}
+
+// Compares a switch value with a case value
+int switch_values_equal(Value val, Value cval)
+{
+    int eq = 0;
+    if (val.type == cval.type)
+    {
+        if (val.type == VAL_INT)
+        {
+            eq = (val.i == cval.i);
+        }
+        else if (val.type == VAL_FLOAT)
+        {
+            eq = (val.f == cval.f);
+        }
+        else if (val.type == VAL_STRING)
+        {
+            eq = value_string_equal(&val, &cval);
+        }
+        else if (val.type == VAL_BOOL)
+        {
+            eq = (val.b == cval.b);
+        }
+        else if (val.type == VAL_CHAR)
+        {
+            eq = (val.c == cval.c);
+        }
+    }
+    else if (val.type == VAL_INT && cval.type == VAL_FLOAT)
+    {
+        eq = (val.i == cval.f);
+    }
+    else if (val.type == VAL_FLOAT && cval.type == VAL_INT)
+    {
+        eq = (val.f == cval.i);
+    }
+    return eq;
+}
+
 // Evaluates an expression node and returns a Value
 static Value eval_expr(Env *e, AstNode *n)
 {
@@ -341,7 +914,7 @@ static Value eval_expr(Env *e, AstNode *n)
     }
     case NODE_STRING:
     {
-        return value_string(n->get<StringNode>().text.c_str());
+        return value_string(n->get<StringNode>().text);
     }
     case NODE_CHAR:
     {
@@ -366,10 +939,27 @@ static Value eval_expr(Env *e, AstNode *n)
         return v;
     }
 
+    // Map literal: keys and values in source order
+    case NODE_MAP:
+    {
+        Value v = value_map();
+        NodeList &items = n->get<MapNode>().items;
+        for (int i = 0; i + 1 < items.count; i += 2)
+        {
+            Value key = eval_expr(e, items.items[i]);
+            Value item = eval_expr(e, items.items[i + 1]);
+            map_store(&v, &key, item, n->line);
+            value_free(key);
+            value_free(item);
+        }
+        return v;
+    }
+
     // Variable lookup
     case NODE_IDENT:
     {
-        Value *v = env_get(e, n->get<IdentNode>().name.c_str());
+        IdentNode &ident = n->get<IdentNode>();
+        Value *v = env_get_cached(e, ident.name, &ident.cache);
         return v ? value_copy(*v) : value_null();
     }
 
@@ -398,6 +988,24 @@ static Value eval_expr(Env *e, AstNode *n)
             return eval_expr(e, binop.right);  
         }
 
+        if (binop.op >= OP_EQ && binop.op <= OP_GTE && ast_is_pure(binop.right))
+        {
+            // Comparisons only read their operands
+            Value lt, rt;
+            const Value *l = eval_borrow(e, binop.left, &lt);
+            const Value *r = eval_borrow(e, binop.right, &rt);
+            Value res = eval_binop(binop.op, *l, *r);
+            value_free(lt);
+            value_free(rt);
+            return res;
+        }
+
+        if (binop.op == OP_ADD && binop.left->kind == NODE_BINOP &&
+            binop.left->get<BinOpNode>().op == OP_ADD)
+        {
+            return eval_sum(e, n);
+        }
+
         Value l = eval_expr(e, binop.left);  
         Value r = eval_expr(e, binop.right);  
         Value res = eval_binop(binop.op, l, r);  
@@ -417,27 +1025,44 @@ static Value eval_expr(Env *e, AstNode *n)
     case NODE_INDEX:
     {
         IndexNode& index_node = n->get<IndexNode>();
+        if (ast_is_pure(index_node.index))
+        {
+            // Only the item is copied, not the lists leading to it
+            Value tmp;
+            const Value *v = eval_borrow(e, n, &tmp);
+            return v == &tmp ? tmp : value_copy(*v);
+        }
         Value target = eval_expr(e, index_node.target);
         Value idx = eval_expr(e, index_node.index);
+        Value res = value_null();
         if (target.type == VAL_LIST && idx.type == VAL_INT)
         {
-            if (idx.i >= 0 && idx.i < target.list.count)
+            if (idx.i >= 0 && idx.i < target.list->count)
             {
-                Value res = value_copy(target.list.items[idx.i]);
-                value_free(target);
-                value_free(idx);
-                return res;
+                res = value_copy(target.list->items[idx.i]);
+            }
+        }
+        else if (target.type == VAL_MAP)
+        {
+            Value *item = value_map_find(&target, &idx);
+            res = item ? value_copy(*item) : value_null();
+        }
+        else if (target.type == VAL_DENSE_LIST && idx.type == VAL_INT)
+        {
+            if (idx.i >= 0 && idx.i < target.dlist->count)
+            {
+                res = value_float(target.dlist->data[idx.i]);
             }
         }
         value_free(target);
         value_free(idx);
-        return value_null();
+        return res;
     }
 
     //  Increment Operator (++)
     case NODE_INC:
     {
-        Value *v = env_get(e, n->get<IncNode>().name.c_str());
+        Value *v = env_get(e, n->get<IncNode>().name);
         if (v && v->type == VAL_INT)
         {
             Value old = value_copy(*v);
@@ -456,7 +1081,7 @@ static Value eval_expr(Env *e, AstNode *n)
     // Decrement Operator (--)
     case NODE_DEC:
     {
-        Value *v = env_get(e, n->get<DecNode>().name.c_str());
+        Value *v = env_get(e, n->get<DecNode>().name);
         if (v && v->type == VAL_INT)
         {
             Value old = value_copy(*v);
@@ -476,28 +1101,20 @@ static Value eval_expr(Env *e, AstNode *n)
     case NODE_CALL:
     {
         CallNode& call_node = n->get<CallNode>();
+        switch (call_node.intrinsic)
+        {
         // Built-in: len()
-        if (!strcmp(call_node.name.c_str(), "len"))
+        case INTRINSIC_LEN:
         {
-            if (call_node.args.count == 1)
-            {
-                Value v = eval_expr(e, call_node.args.items[0]);
-                size_t len = 0;
-                if (v.type == VAL_STRING)
-                {
-                    len = strlen(v.s);
-                }
-                if (v.type == VAL_LIST)
-                {
-                    len = v.list.count;
-                }
-                value_free(v);
-                return value_int(len);
-            }
+            Value tmp;
+            const Value *v = eval_borrow(e, call_node.args.items[0], &tmp);
+            Value res = builtin_len(*v);
+            value_free(tmp);
+            return res;
         }
 
         // Built-in: append(list, value)
-        if (!strcmp(call_node.name.c_str(), "append"))
+        case INTRINSIC_APPEND:
         {
             if (call_node.args.count != 2)
             {
@@ -513,6 +1130,14 @@ static Value eval_expr(Env *e, AstNode *n)
             {
                 value_list_append(list_ptr, item_val);
             }
+            else if (list_ptr && list_ptr->type == VAL_DENSE_LIST)
+            {
+                dense_append(list_ptr, item_val, n->line);
+            }
+            else if (list_ptr && list_ptr->type == VAL_STRING)
+            {
+                value_string_append_value(list_ptr, &item_val);
+            }
             else
             {
                 // Use node line number
@@ -531,114 +1156,45 @@ static Value eval_expr(Env *e, AstNode *n)
         }
 
         // Built-in: type() - Returns type name ("int", "long", "float", etc)
-        if (!strcmp(call_node.name.c_str(), "type"))
+        case INTRINSIC_TYPE:
         {
-            if (call_node.args.count == 1)
-            {
-                Value v = eval_expr(e, call_node.args.items[0]);
-                const char *tname = "unknown";
-                switch (v.type)
-                {
-                case VAL_INT:
-                    // Check magnitude to differentiate int vs long for user
-                    // Assumes standard 32-bit int limits for "int" label
-                    if (v.i > INT_MAX || v.i < INT_MIN)
-                    {
-                        tname = "long";
-                    }
-                    else
-                    {
-                        tname = "int";
-                    }
-                    break;
-                case VAL_FLOAT:
-                    tname = "float";
-                    break;
-                case VAL_STRING:
-                    tname = "string";
-                    break;
-                case VAL_CHAR:
-                    tname = "char";
-                    break;
-                case VAL_BOOL:
-                    tname = "boolean";
-                    break;
-                case VAL_LIST:
-                    tname = "list";
-                    break;
-                case VAL_NATIVE:
-                    tname = "native_function";
-                    break;
-                case VAL_NULL:
-                    tname = "null";
-                    break;
-                }
-                value_free(v);
-                return value_string(tname);
-            }
+            Value v = eval_expr(e, call_node.args.items[0]);
+            Value res = builtin_type(v);
+            value_free(v);
+            return res;
         }
 
         // Built-in: int()
-        if (!strcmp(call_node.name.c_str(), "int"))
+        case INTRINSIC_INT:
         {
-            if (call_node.args.count == 1)
-            {
-                Value v = eval_expr(e, call_node.args.items[0]);
-                long long res = 0;
-                if (v.type == VAL_STRING)
-                {
-                    res = atoll(v.s);
-                }
-                else if (v.type == VAL_FLOAT)
-                {
-                    res = (long long)v.f;
-                }
-                else if (v.type == VAL_INT)
-                {
-                    res = v.i;
-                }
-                else if (v.type == VAL_BOOL)
-                {
-                    res = v.b;
-                }
-                else if (v.type == VAL_CHAR)
-                {
-                    res = (long long)v.c;
-                }
-                value_free(v);
-                return value_int(res);
-            }
+            Value v = eval_expr(e, call_node.args.items[0]);
+            Value res = builtin_int(v);
+            value_free(v);
+            return res;
         }
+
         // Built-in: float()
-        if (!strcmp(call_node.name.c_str(), "float"))
+        case INTRINSIC_FLOAT:
         {
-            if (call_node.args.count == 1)
-            {
-                Value v = eval_expr(e, call_node.args.items[0]);
-                double res = 0.0;
-                if (v.type == VAL_STRING)
-                {
-                    res = atof(v.s);
-                }
-                else if (v.type == VAL_INT)
-                {
-                    res = static_cast<double>(v.i);
-                }
-                else if (v.type == VAL_FLOAT)
-                {
-                    res = v.f;
-                }
-                else if (v.type == VAL_BOOL)
-                {
-                    res = v.b ? 1.0 : 0.0;
-                }
-                value_free(v);
-                return value_float(res);
-            }
+            Value v = eval_expr(e, call_node.args.items[0]);
+            Value res = builtin_float(v);
+            value_free(v);
+            return res;
         }
 
-        // 1. Check for User defined function
-        AstNode *fn = env_get_func(e, call_node.name.c_str());
+        case INTRINSIC_NONE:
+            break;
+        }
+
+        CallTarget target = call_resolve(e, call_node);
+        AstNode *fn = target.fn;
+
+        if (fn && fn->get<FuncDefNode>().memo)
+        {
+            return call_memo(e, fn, call_node);
+        }
+
+        // 1. User defined function
         if (fn)
         {
             // Create new scope for function execution
@@ -646,78 +1202,70 @@ static Value eval_expr(Env *e, AstNode *n)
 
             // Map arguments to parameters
             FuncDefNode& funcdef = fn->get<FuncDefNode>();
-            for (size_t i = 0; i < funcdef.params.size(); i++)
+            for (int i = 0; i < funcdef.param_count; i++)
             {
                 Value v = (i < call_node.args.count) ? 
                 eval_expr(e, call_node.args.items[i]) : value_null();
 
-                env_def(scope, funcdef.params[i].c_str(), v);
+                env_def(scope, funcdef.params[i], v);
                 value_free(v);
             }
 
-            // Execute function body
-            for (int i = 0; i < funcdef.body.count; i++)
-            {
-                exec_stmt(scope, funcdef.body.items[i]);
-                {
-                    if (return_exception.active) break;
-                }
-            }
-
-            // Handle return value
-            Value ret = return_exception.active ? value_copy(return_exception.value) : value_null();
-            if (return_exception.active)
-            {
-                value_free(return_exception.value);
-                return_exception.active = 0;
-            }
-            env_free(scope);
-            return ret;
+            return run_call(e, scope, fn);
         }
 
-        // 2. Check for Native Function (Registered in Variables)
-        Value *native_val = env_get(e, call_node.name.c_str());
-        if (native_val && native_val->type == VAL_NATIVE)
+        // 2. Native Function (Registered in Variables)
+        if (target.native)
         {
-            // Evaluate Arguments first
+            NativeArgs args;
             int argc = call_node.args.count;
-            Value *argv = static_cast<Value*>(malloc(sizeof(Value) * argc));
+            native_args_init(&args, argc);
             for (int i = 0; i < argc; i++)
             {
-                // Fixed it, now it Passes list identifiers by reference to allow in-place modification
-                if (call_node.args.items[i]->kind == NODE_IDENT)
+                AstNode *arg = call_node.args.items[i];
+                int borrowable = i + 1 >= call_node.pure_tail;
+                if (borrowable && !target.mutates)
+                {
+                    // Read-only natives see variables and list items in place
+                    Value tmp;
+                    const Value *v = eval_borrow(e, arg, &tmp);
+                    args.argv[i] = *v;
+                    args.borrowed[i] = v != &tmp;
+                    continue;
+                }
+
+                // Natives that change lists or maps get those variables by
+                // reference, unshared first so the change only reaches that variable
+                Value *ref = borrowable && arg->kind == NODE_IDENT ?
+                    env_get(e, arg->get<IdentNode>().name) : nullptr;
+                if (ref && value_unshare(ref))
                 {
-                    Value *env_ref = 
-                    env_get(e, call_node.args.items[i]->get<IdentNode>().name.c_str());
-
-                    if (env_ref && env_ref->type == VAL_LIST)
-                    {
-                        argv[i] = *env_ref; 
-                    }
-                    else
-                    {
-                        argv[i] = eval_expr(e, call_node.args.items[i]);
-                    }
+                    args.argv[i] = *ref;
+                    args.borrowed[i] = 1;
                 }
                 else
                 {
-                    argv[i] = eval_expr(e, call_node.args.items[i]);
+                    args.argv[i] = eval_expr(e, arg);
+                    args.borrowed[i] = 0;
                 }
             }
-
-            // Call the C Function Pointer
-            Value res = native_val->native(argc, argv);
-
-            // Clean up arguments
-            for (int i = 0; i < argc; i++)
+            for (int i = 0; target.mutates && i + 1 < call_node.pure_tail; i++)
             {
-                // Only free if it was a deep-copied expression, not an environment reference
-                if (call_node.args.items[i]->kind != NODE_IDENT)
+                // Variables the arguments after them might change are
+                // copied first and taken by reference once those have run
+                AstNode *arg = call_node.args.items[i];
+                Value *ref = arg->kind == NODE_IDENT ?
+                    env_get(e, arg->get<IdentNode>().name) : nullptr;
+                if (ref)
                 {
-                    value_free(argv[i]);
+                    value_free(args.argv[i]);
+                    args.borrowed[i] = value_unshare(ref);
+                    args.argv[i] = args.borrowed[i] ? *ref : value_copy(*ref);
                 }
             }
-            free(argv);
+
+            Value res = target.native(argc, args.argv);
+            native_args_free(&args, argc);
             return res;
         }
 
@@ -728,9 +1276,9 @@ static Value eval_expr(Env *e, AstNode *n)
     {
         InputNode& input_node = n->get<InputNode>();
         char buf[256];
-        if (!input_node.prompt.empty())
+        if (input_node.prompt[0])
         {
-            printf("%s", input_node.prompt.c_str());
+            printf("%s", input_node.prompt);
         }
         if (fgets(buf, 256, stdin))
         {
@@ -747,12 +1295,27 @@ static Value eval_expr(Env *e, AstNode *n)
     }
 }
 
-// Executes a statement node (side effects, control flow)
-static Value exec_stmt(Env *e, AstNode *n)
+// Runs statements in order until one does not complete normally
+static ExecStatus exec_list(Env *e, NodeList *list, CallFrame *frame)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        ExecStatus status = exec_stmt(e, list->items[i], frame);
+        if (status != EXEC_NORMAL)
+        {
+            return status;
+        }
+    }
+    return EXEC_NORMAL;
+}
+
+// Executes a statement node (side effects, control flow) and reports how
+// it finished
+static ExecStatus exec_stmt(Env *e, AstNode *n, CallFrame *frame)
 {
     if (!n)
     {
-        return value_null();
+        return EXEC_NORMAL;
     }
 
     luna_current_line = n->line;
@@ -763,17 +1326,38 @@ static Value exec_stmt(Env *e, AstNode *n)
         {
             LetNode& let_node = n->get<LetNode>();
             Value v = eval_expr(e, let_node.expr);
-            env_def(e, let_node.name.c_str(), v);
+            env_def(e, let_node.name, v);
             value_free(v);
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_ASSIGN:
         {
             AssignNode& assign_node = n->get<AssignNode>();
+
+            // x = x + ...: extend x's string in place when it is not shared
+            AstNode *nodes[SUM_MAX_OPERANDS];
+            int count = ast_self_append(n, nodes);
+            if (count > 0)
+            {
+                Value values[SUM_MAX_OPERANDS];
+                for (int i = 0; i < count; i++)
+                {
+                    values[i] = eval_expr(e, nodes[i]);
+                }
+                if (append_sum(env_get(e, assign_node.name), values, count))
+                {
+                    return EXEC_NORMAL;
+                }
+                Value v = sum_values(values, count);
+                env_assign(e, assign_node.name, v);
+                value_free(v);
+                return EXEC_NORMAL;
+            }
+
             Value v = eval_expr(e, assign_node.expr);
-            env_assign(e, assign_node.name.c_str(), v);
+            env_assign(e, assign_node.name, v);
             value_free(v);
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_ASSIGN_INDEX:
         {
@@ -782,6 +1366,22 @@ static Value exec_stmt(Env *e, AstNode *n)
 
             // Get pointer to the actual list item in the environment
             Value *target = get_mutable_value(e, assign_idx.list);
+            if (target && target->type == VAL_MAP)
+            {
+                Value key = eval_expr(e, assign_idx.index);
+                map_store(target, &key, val, n->line);
+                value_free(key);
+                value_free(val);
+                return EXEC_NORMAL;
+            }
+            if (target && target->type == VAL_DENSE_LIST)
+            {
+                Value idx = eval_expr(e, assign_idx.index);
+                dense_store(target, &idx, val, n->line);
+                value_free(idx);
+                value_free(val);
+                return EXEC_NORMAL;
+            }
 
             // Verify target is actually a list
             if (!target || target->type != VAL_LIST)
@@ -796,7 +1396,7 @@ static Value exec_stmt(Env *e, AstNode *n)
                     "Use list indices only on list variables, e.g., myList[0] = value"
                 );
                 value_free(val);
-                return value_null();
+                return EXEC_NORMAL;
             }
 
             // Evaluate the index
@@ -814,11 +1414,11 @@ static Value exec_stmt(Env *e, AstNode *n)
                 );
                 value_free(val);
                 value_free(idx);
-                return value_null();
+                return EXEC_NORMAL;
             }
 
             // Bounds Check
-            if (idx.i < 0 || idx.i >= target->list.count)
+            if (idx.i < 0 || idx.i >= target->list->count)
             {
                 char msg[128];
                 snprintf
@@ -826,7 +1426,7 @@ static Value exec_stmt(Env *e, AstNode *n)
                     msg, 
                     sizeof(msg), 
                     "Index %lld is out of bounds for list of length %d",
-                    idx.i, target->list.count
+                    idx.i, target->list->count
                 );
                 // Use node line number
                 error_report
@@ -839,17 +1439,18 @@ static Value exec_stmt(Env *e, AstNode *n)
                 );
                 value_free(val);
                 value_free(idx);
-                return value_null();
+                return EXEC_NORMAL;
             }
 
             // Assign to the specific slot
-            Value *slot = &target->list.items[idx.i];
+            value_list_unique(target);
+            Value *slot = &target->list->items[idx.i];
             value_free(*slot);       // Free the old value in this slot
             *slot = value_copy(val); // Assign the new value
 
             value_free(val);
             value_free(idx);
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_PRINT:
         {
@@ -857,13 +1458,14 @@ static Value exec_stmt(Env *e, AstNode *n)
             for (int i = 0; i < print_node.args.count; i++)
             {
                 Value v = eval_expr(e, print_node.args.items[i]);
-                char *s = value_to_string(v);
-                printf("%s ", s);
-                free(s);
+                TempMark mark = temp_mark();
+                size_t len;
+                printf("%s ", value_temp_string(&v, &len));
+                temp_release(mark);
                 value_free(v);
             }
             printf("\n");
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_IF:
         {
@@ -872,24 +1474,11 @@ static Value exec_stmt(Env *e, AstNode *n)
             int t = is_truthy(v);
             value_free(v);
 
-            NodeList block = t ? if_node.then_block : if_node.else_block;
+            NodeList& block = t ? if_node.then_block : if_node.else_block;
             Env *scope = env_create(e);
-            for (int i = 0; i < block.count; i++)
-            {
-                exec_stmt(scope, block.items[i]);
-                // Stop if a control flow event occurred
-                if 
-                (
-                    return_exception.active     || 
-                    loop_exception.break_active ||
-                    loop_exception.continue_active
-                )
-                {
-                    break;
-                }
-            }
+            ExecStatus status = exec_list(scope, &block, frame);
             env_free(scope);
-            return value_null();
+            return status;
         }
         case NODE_WHILE:
         {
@@ -905,36 +1494,19 @@ static Value exec_stmt(Env *e, AstNode *n)
                 }
 
                 Env *scope = env_create(e);
-                for (int i = 0; i < while_node.body.count; i++)
-                {
-                    exec_stmt(scope, while_node.body.items[i]);
-                    if (return_exception.active || loop_exception.break_active)
-                    {
-                        break;
-                    }
-                    if (loop_exception.continue_active)
-                    {
-                        break;
-                    }
-                }
+                ExecStatus status = exec_list(scope, &while_node.body, frame);
                 env_free(scope);
 
-                if (return_exception.active)
+                if (status == EXEC_RETURN)
                 {
-                    break;
+                    return status;
                 }
-                if (loop_exception.break_active)
+                if (status == EXEC_BREAK)
                 {
-                    loop_exception.break_active = 0;
                     break;
                 }
-                if (loop_exception.continue_active)
-                {
-                    loop_exception.continue_active = 0;
-                    continue;
-                }
             }
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_FOR:
         {
@@ -942,7 +1514,7 @@ static Value exec_stmt(Env *e, AstNode *n)
             Env *scope = env_create(e); // Create scope for the loop variable (i)
 
             // 1. Run Initializer (once)
-            exec_stmt(scope, for_node.init);
+            exec_stmt(scope, for_node.init, frame);
 
             while (1)
             {
@@ -956,115 +1528,50 @@ static Value exec_stmt(Env *e, AstNode *n)
                 // 3. Execute Body
                 // We create a generic inner scope for the body to protect the iterator
                 Env *inner_scope = env_create(scope);
-                for (int i = 0; i < for_node.body.count; i++)
-                {
-                    exec_stmt
-                    (
-                        inner_scope, 
-                        for_node.body.items[i]
-                    );
-                    if 
-                    (
-                        return_exception.active     || 
-                        loop_exception.break_active || 
-                        loop_exception.continue_active
-                    ) break;
-
-                }
+                ExecStatus status = exec_list(inner_scope, &for_node.body, frame);
                 env_free(inner_scope);
 
-                if (return_exception.active)
+                if (status == EXEC_RETURN)
                 {
-                    break;
+                    env_free(scope);
+                    return status;
                 }
-
-                if (loop_exception.break_active)
+                if (status == EXEC_BREAK)
                 {
-                    loop_exception.break_active = 0;
                     break;
                 }
                 // (Continue is handled implicitly by going to the increment step)
-                if (loop_exception.continue_active)
-                {
-                    loop_exception.continue_active = 0;
-                }
 
                 // 4. Run Increment
-                exec_stmt(scope, for_node.incr);
+                exec_stmt(scope, for_node.incr, frame);
             }
 
             env_free(scope); // Cleanup loop variable 'i'
-            return value_null();
+            return EXEC_NORMAL;
         }
         case NODE_SWITCH:
         {
             SwitchNode& switch_node = n->get<SwitchNode>();
             Value val = eval_expr(e, switch_node.expr);
             int matched = 0;
+            ExecStatus status = EXEC_NORMAL;
 
             // Check all cases
             for (int i = 0; i < switch_node.cases.count; i++)
             {
                 AstNode *c = switch_node.cases.items[i];
                 Value cval = eval_expr(e, c->get<CaseNode>().value);
-                int eq = 0;
 
                 // Compare switch value with case value
-                if (val.type == cval.type)
-                {
-                    if (val.type == VAL_INT)
-                    {
-                        eq = (val.i == cval.i);
-                    }
-                    else if (val.type == VAL_FLOAT)
-                    {
-                        eq = (val.f == cval.f);
-                    }
-                    else if (val.type == VAL_STRING)
-                    {
-                        eq = !strcmp(val.s, cval.s);
-                    }
-                    else if (val.type == VAL_BOOL)
-                    {
-                        eq = (val.b == cval.b);
-                    }
-                    else if (val.type == VAL_CHAR)
-                    {
-                        eq = (val.c == cval.c);
-                    }
-                }
-                else if (val.type == VAL_INT && cval.type == VAL_FLOAT)
-                {
-                    eq = (val.i == cval.f);
-                }
-                else if (val.type == VAL_FLOAT && cval.type == VAL_INT)
-                {
-                    eq = (val.f == cval.i);
-                }   
+                int eq = switch_values_equal(val, cval);
                 value_free(cval);
 
                 if (eq)
                 {
                     matched = 1;
                     Env *scope = env_create(e);
-                    for (int j = 0; j < c->get<CaseNode>().body.count; j++)
-                    {
-                        exec_stmt(scope, c->get<CaseNode>().body.items[j]);
-                        if (return_exception.active || loop_exception.continue_active)
-                        {
-                            break;
-                        }
-
-                        if (loop_exception.break_active)
-                        {
-                            break;
-                        }
-                    }
+                    status = exec_list(scope, &c->get<CaseNode>().body, frame);
                     env_free(scope);
-                    if (loop_exception.break_active)
-                    {
-                        loop_exception.break_active = 0;
-                    }
                     break;
                 }
             }
@@ -1073,118 +1580,247 @@ static Value exec_stmt(Env *e, AstNode *n)
             if (!matched && switch_node.default_case.count > 0)
             {
                 Env *scope = env_create(e);
-                for (int j = 0; j < switch_node.default_case.count; j++)
-                {
-                    exec_stmt(scope, switch_node.default_case.items[j]);
-                    if (return_exception.active || loop_exception.continue_active)
-                    {
-                        break;
-                    }
-                    if (loop_exception.break_active)
-                    {
-                        break;
-                    }
-                }
+                status = exec_list(scope, &switch_node.default_case, frame);
                 env_free(scope);
-                if (loop_exception.break_active)
-                {
-                    loop_exception.break_active = 0;
-                }
             }
             value_free(val);
-            return value_null();
+
+            // 'break' ends the switch; 'continue' and 'return' pass through
+            return status == EXEC_BREAK ? EXEC_NORMAL : status;
         }
         case NODE_BLOCK:
         {
             BlockNode& block_node = n->get<BlockNode>();
             Env *scope = env_create(e);
-            for (int i = 0; i < block_node.items.count; i++)
-            {
-                exec_stmt(scope, block_node.items.items[i]);
-                if 
-                (
-                    return_exception.active     || 
-                    loop_exception.break_active || 
-                    loop_exception.continue_active
-                )
-                {
-                    break;
-                }
-            }
+            ExecStatus status = exec_list(scope, &block_node.items, frame);
             env_free(scope);
-            return value_null();
+            return status;
         }
         case NODE_GROUP:
         {
             BlockNode& block_node = n->get<BlockNode>();
             // Execute statements in the CURRENT environment (e)
-            for (int i = 0; i < block_node.items.count; i++)
-            {
-                exec_stmt(e, block_node.items.items[i]);
-
-                // Still need to check for control flow (return/break)
-                if 
-                (
-                    return_exception.active     || 
-                    loop_exception.break_active || 
-                    loop_exception.continue_active
-                )
-                {
-                    break;
-                }
-            }
-            return value_null();
+            return exec_list(e, &block_node.items, frame);
         }
 
         case NODE_FUNC_DEF:
         {
             FuncDefNode& funcdef = n->get<FuncDefNode>();
-            env_def_func(e, funcdef.name.c_str(), n);
-            return value_null();
+            env_def_func(e, funcdef.name, n);
+            return EXEC_NORMAL;
         }
 
         case NODE_RETURN:
         {
             ReturnNode& ret_node = n->get<ReturnNode>();
 
-            // 1. Calculate the return value first
-            Value v = eval_expr(e, ret_node.expr);
+            // 'return f(...)' to a user function is run by the caller's
+            // call loop in place of this call, so recursion through tail
+            // calls does not nest
+            AstNode *tail_fn = tail_call_target(e, ret_node.expr, frame->scope);
+            if (tail_fn)
+            {
+                // Arguments may make calls of their own, so they are only
+                // handed over once all of them are evaluated
+                CallNode& call = ret_node.expr->get<CallNode>();
+                int nparams = tail_fn->get<FuncDefNode>().param_count;
+                Value argv[NATIVE_INLINE_ARGS];
+                for (int i = 0; i < nparams; i++)
+                {
+                    argv[i] = (i < call.args.count) ? 
+                    eval_expr(e, call.args.items[i]) : value_null();
+                }
+                for (int i = 0; i < nparams; i++)
+                {
+                    frame->tail_args[i] = argv[i];
+                }
+                frame->tail_fn = tail_fn;
+                return EXEC_RETURN;
+            }
 
-            // 2. Set the exception flag to stop further execution
-            return_exception.active = 1;
-            return_exception.value = v;
-            return value_null();
+            // The value is kept in the frame for the caller to take
+            frame->ret = eval_expr(e, ret_node.expr);
+            return EXEC_RETURN;
         }
 
         case NODE_BREAK:
-            loop_exception.break_active = 1;
-            return value_null();
+            return EXEC_BREAK;
 
         case NODE_CONTINUE:
-            loop_exception.continue_active = 1;
-            return value_null();
+            return EXEC_CONTINUE;
 
         default:
         {
             // Evaluate standalone expressions (e.g., function calls without assignment)
             Value v = eval_expr(e, n);
             value_free(v);
-            return value_null();
+            return EXEC_NORMAL;
         }
     }
 }
 
-Value interpret(AstNode *prog, Env *env)
+// Finds what a call refers to: a user function (these shadow natives) or a
+// native stored in a variable. The function lookup is cached on the call
+// node until a function is defined or goes out of scope; the variable is
+// read through the node's global cache. Callers keep the returned
+// copy, since a recursive call through the same node may resolve again.
+CallTarget call_resolve(Env *e, CallNode &call)
+{
+    CallTarget &target = call.target;
+    if (target.epoch == env_func_epoch())
+    {
+        if (target.fn || (target.native && target.cacheable))
+        {
+            return target;
+        }
+    }
+    else
+    {
+        target.fn = env_get_func(e, call.name);
+        target.epoch = env_func_epoch();
+    }
+
+    // Without a function of that name, the callee is whatever the variable
+    // holds now. A variable of the same name could hide a native, so the
+    // native itself is only kept for names that are never used as variables.
+    target.native = nullptr;
+    if (!target.fn)
+    {
+        Value *v = env_get_cached(e, call.name, &call.var);
+        if (v && v->type == VAL_NATIVE)
+        {
+            target.native = v->native;
+        }
+    }
+    target.mutates = target.native && native_mutates_args(target.native);
+    return target;
+}
+
+// Every name bound as a variable or parameter by the programs run so far
+static std::unordered_set<std::string> variable_names;
+
+static void scan_names(AstNode *n, std::vector<CallNode*> &calls);
+
+static void scan_list(NodeList *list, std::vector<CallNode*> &calls)
 {
-    // Reset global flags to prevent state leaking between tests
-    return_exception.active = 0;
-    loop_exception.break_active = 0;
-    loop_exception.continue_active = 0;
+    for (int i = 0; i < list->count; i++)
+    {
+        scan_names(list->items[i], calls);
+    }
+}
 
-    if (!prog)
+// Collects the variable names and the call sites of a program
+static void scan_names(AstNode *n, std::vector<CallNode*> &calls)
+{
+    if (!n)
     {
-        return value_null();
+        return;
+    }
+    switch (n->kind)
+    {
+    case NODE_LIST:
+        scan_list(&n->get<ListNode>().items, calls);
+        break;
+    case NODE_MAP:
+        scan_list(&n->get<MapNode>().items, calls);
+        break;
+    case NODE_BINOP:
+        scan_names(n->get<BinOpNode>().left, calls);
+        scan_names(n->get<BinOpNode>().right, calls);
+        break;
+    case NODE_LET:
+        variable_names.insert(n->get<LetNode>().name);
+        scan_names(n->get<LetNode>().expr, calls);
+        break;
+    case NODE_ASSIGN:
+        variable_names.insert(n->get<AssignNode>().name);
+        scan_names(n->get<AssignNode>().expr, calls);
+        break;
+    case NODE_ASSIGN_INDEX:
+        scan_names(n->get<AssignIndexNode>().list, calls);
+        scan_names(n->get<AssignIndexNode>().index, calls);
+        scan_names(n->get<AssignIndexNode>().value, calls);
+        break;
+    case NODE_PRINT:
+        scan_list(&n->get<PrintNode>().args, calls);
+        break;
+    case NODE_NOT:
+        scan_names(n->get<NotNode>().expr, calls);
+        break;
+    case NODE_IF:
+        scan_names(n->get<IfNode>().cond, calls);
+        scan_list(&n->get<IfNode>().then_block, calls);
+        scan_list(&n->get<IfNode>().else_block, calls);
+        break;
+    case NODE_WHILE:
+        scan_names(n->get<WhileNode>().cond, calls);
+        scan_list(&n->get<WhileNode>().body, calls);
+        break;
+    case NODE_FOR:
+        scan_names(n->get<ForNode>().init, calls);
+        scan_names(n->get<ForNode>().cond, calls);
+        scan_names(n->get<ForNode>().incr, calls);
+        scan_list(&n->get<ForNode>().body, calls);
+        break;
+    case NODE_SWITCH:
+        scan_names(n->get<SwitchNode>().expr, calls);
+        scan_list(&n->get<SwitchNode>().cases, calls);
+        scan_list(&n->get<SwitchNode>().default_case, calls);
+        break;
+    case NODE_CASE:
+        scan_names(n->get<CaseNode>().value, calls);
+        scan_list(&n->get<CaseNode>().body, calls);
+        break;
+    case NODE_BLOCK:
+    case NODE_GROUP:
+        scan_list(&n->get<BlockNode>().items, calls);
+        break;
+    case NODE_CALL:
+        calls.push_back(&n->get<CallNode>());
+        scan_list(&n->get<CallNode>().args, calls);
+        break;
+    case NODE_INDEX:
+        scan_names(n->get<IndexNode>().target, calls);
+        scan_names(n->get<IndexNode>().index, calls);
+        break;
+    case NODE_FUNC_DEF:
+    {
+        FuncDefNode &funcdef = n->get<FuncDefNode>();
+        for (int i = 0; i < funcdef.param_count; i++)
+        {
+            variable_names.insert(funcdef.params[i]);
+        }
+        scan_list(&funcdef.body, calls);
+        break;
+    }
+    case NODE_RETURN:
+        scan_names(n->get<ReturnNode>().expr, calls);
+        break;
+    default:
+        break;
     }
+}
+
+// Decides which call sites of a program may cache the natives they call
+static void resolve_calls(AstNode *prog)
+{
+    std::vector<CallNode*> calls;
+    scan_names(prog, calls);
+    for (size_t i = 0; i < calls.size(); i++)
+    {
+        calls[i]->target.cacheable = !variable_names.count(calls[i]->name);
+    }
+}
+
+// Runs a program through the reference AST walker
+static Value interpret_tree(AstNode *prog, Env *env)
+{
+    // A top-level 'return' ends the program; stray break and continue
+    // statements do nothing, as in the VM
+    CallFrame frame;
+    frame.scope = nullptr;
+    frame.ret = value_null();
+    frame.tail_fn = nullptr;
 
     // Use the passed environment directly
     if (prog->kind == NODE_BLOCK)
@@ -1192,12 +1828,36 @@ Value interpret(AstNode *prog, Env *env)
         BlockNode& block_node = prog->get<BlockNode>();
         for (int i = 0; i < block_node.items.count; i++)
         {
-            exec_stmt(env, block_node.items.items[i]);
+            if (exec_stmt(env, block_node.items.items[i], &frame) == EXEC_RETURN)
+            {
+                break;
+            }
         }
     }
     else
     {
-        exec_stmt(env, prog);
+        exec_stmt(env, prog, &frame);
     }
+    value_free(frame.ret);
     return value_null();
+}
+
+Value interpret(AstNode *prog, Env *env)
+{
+    if (!prog)
+    {
+        return value_null();
+    }
+    resolve_calls(prog);
+
+    if (luna_use_tree_walker)
+    {
+        return interpret_tree(prog, env);
+    }
+
+    // Lower the tree to bytecode and run it on the VM
+    Proto *proto = compile_program(prog);
+    Value res = vm_run(proto, env);
+    proto_free(proto);
+    return res;
 }
\ No newline at end of file
@@ -0,0 +1,1052 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Template JIT (see jit.h). Each supported tree node is emitted as a fixed
+// x86-64 instruction sequence: integer results live in rax, float results
+// in xmm0, and locals and temporaries in 8-byte slots below rbp. Compiled
+// code has no side effects besides its result, so when it meets something
+// it cannot handle it simply gives up and the VM runs the whole call again.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <luna/jit.h>
+#include <luna/interpreter.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LUNA_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+int luna_no_jit = 0;
+
+// Static type of a compiled value
+typedef enum
+{
+    JIT_VOID,
+    JIT_INT,
+    JIT_FLOAT
+} JitType;
+
+// Status returned in rdx next to the result in rax
+typedef enum
+{
+    JIT_RET_VALUE,  // rax holds a value of the function's return type
+    JIT_RET_NULL,   // the body ended without returning a value
+    JIT_RET_BAIL    // the call has to be run by the VM
+} JitStatus;
+
+typedef struct
+{
+    int64_t value;
+    int64_t status;
+} JitResult;
+
+typedef JitResult (*JitEntry)(const int64_t *args);
+
+struct JitCode
+{
+    void *mem;
+    size_t size;
+    JitEntry entry;
+    JitType params[JIT_MAX_ARGS];
+    int nparams;
+    JitType ret;
+};
+
+void jit_free(JitCode *code)
+{
+    if (!code)
+    {
+        return;
+    }
+#ifdef LUNA_JIT
+    munmap(code->mem, code->size);
+#endif
+    delete code;
+}
+
+#ifdef LUNA_JIT
+
+// Compiled code bails out instead of growing the C stack past this address
+static uintptr_t jit_stack_limit;
+#define JIT_STACK_BYTES (1 << 20)
+
+typedef struct
+{
+    std::string name;
+    int slot;
+    JitType type;
+} JitLocal;
+
+typedef struct
+{
+    std::vector<size_t> breaks;     // Jumps to the loop exit
+    std::vector<size_t> continues;  // Jumps to the next iteration
+} JitLoop;
+
+typedef struct
+{
+    FuncDefNode *def;
+    JitType params[JIT_MAX_ARGS];
+    JitType ret;
+    std::vector<uint8_t> code;
+    std::vector<JitLocal> locals;   // Visible locals, innermost last
+    std::vector<JitLoop> loops;
+    std::vector<size_t> bails;      // Jumps to the bail-out exit
+    int nslots;                     // Slots in use
+    int max_slots;
+    int ok;                         // Cleared by anything unsupported
+} JitCompiler;
+
+// --- Encoding -------------------------------------------------------------
+
+static void put(JitCompiler *c, std::initializer_list<uint8_t> bytes)
+{
+    c->code.insert(c->code.end(), bytes);
+}
+
+static void put32(JitCompiler *c, int32_t v)
+{
+    uint8_t b[4];
+    memcpy(b, &v, 4);
+    c->code.insert(c->code.end(), b, b + 4);
+}
+
+static void put64(JitCompiler *c, int64_t v)
+{
+    uint8_t b[8];
+    memcpy(b, &v, 8);
+    c->code.insert(c->code.end(), b, b + 8);
+}
+
+static int32_t slot_disp(int slot)
+{
+    return -8 * (slot + 1);
+}
+
+// Emits prefix bytes followed by a [rbp + disp32] operand for reg
+static void put_slot(JitCompiler *c, std::initializer_list<uint8_t> prefix, int reg, int slot)
+{
+    put(c, prefix);
+    put(c, { (uint8_t)(0x85 | (reg << 3)) });
+    put32(c, slot_disp(slot));
+}
+
+// Register numbers used in ModRM fields
+enum { RAX = 0, RCX = 1, RDX = 2, RDI = 7 };
+
+static void load_int(JitCompiler *c, int reg, int slot)     // mov reg, [slot]
+{
+    put_slot(c, { 0x48, 0x8B }, reg, slot);
+}
+
+static void store_int(JitCompiler *c, int slot)             // mov [slot], rax
+{
+    put_slot(c, { 0x48, 0x89 }, RAX, slot);
+}
+
+static void load_float(JitCompiler *c, int xmm, int slot)   // movsd xmm, [slot]
+{
+    put_slot(c, { 0xF2, 0x0F, 0x10 }, xmm, slot);
+}
+
+static void store_float(JitCompiler *c, int slot)           // movsd [slot], xmm0
+{
+    put_slot(c, { 0xF2, 0x0F, 0x11 }, 0, slot);
+}
+
+static void load_imm(JitCompiler *c, int reg, int64_t v)    // mov reg, imm64
+{
+    put(c, { 0x48, (uint8_t)(0xB8 + reg) });
+    put64(c, v);
+}
+
+// Emits a jump (jmp, or jcc when cc is a 0x8x condition) and returns the
+// position of its offset for patch()
+static size_t jump(JitCompiler *c, int cc)
+{
+    if (cc)
+    {
+        put(c, { 0x0F, (uint8_t)cc });
+    }
+    else
+    {
+        put(c, { 0xE9 });
+    }
+    put32(c, 0);
+    return c->code.size() - 4;
+}
+
+static void patch(JitCompiler *c, size_t at, size_t target)
+{
+    int32_t rel = (int32_t)(target - (at + 4));
+    memcpy(&c->code[at], &rel, 4);
+}
+
+static void patch_all(JitCompiler *c, const std::vector<size_t> &jumps, size_t target)
+{
+    for (size_t at : jumps)
+    {
+        patch(c, at, target);
+    }
+}
+
+enum
+{
+    CC_E = 0x84, CC_NE = 0x85, CC_B = 0x82, CC_AE = 0x83, CC_BE = 0x86,
+    CC_A = 0x87, CC_P = 0x8A, CC_L = 0x8C, CC_GE = 0x8D, CC_LE = 0x8E, CC_G = 0x8F
+};
+
+// --- Slots and names ------------------------------------------------------
+
+static int alloc_slot(JitCompiler *c)
+{
+    int slot = c->nslots++;
+    if (c->nslots > c->max_slots)
+    {
+        c->max_slots = c->nslots;
+    }
+    return slot;
+}
+
+static const JitLocal *find_local(JitCompiler *c, const char *name)
+{
+    for (size_t i = c->locals.size(); i-- > 0; )
+    {
+        if (c->locals[i].name == name)
+        {
+            return &c->locals[i];
+        }
+    }
+    return nullptr;
+}
+
+// --- Expressions ----------------------------------------------------------
+
+static JitType emit_expr(JitCompiler *c, AstNode *n);
+static void emit_cond(JitCompiler *c, AstNode *n, int jump_if, std::vector<size_t> *target);
+
+// Evaluates both operands of a binop: ints end up in rax (left) and rcx
+// (right), floats in xmm0 and xmm1. Returns the common type.
+static JitType emit_operands(JitCompiler *c, BinOpNode &binop)
+{
+    JitType lt = emit_expr(c, binop.left);
+    if (!c->ok)
+    {
+        return JIT_VOID;
+    }
+
+    // An int constant or local on the right needs no temporary
+    AstNode *r = binop.right;
+    const JitLocal *rl = r->kind == NODE_IDENT ? find_local(c, r->get<IdentNode>().name) : nullptr;
+    if (lt == JIT_INT && (r->kind == NODE_NUMBER || (rl && rl->type == JIT_INT)))
+    {
+        if (rl)
+        {
+            load_int(c, RCX, rl->slot);
+        }
+        else
+        {
+            load_imm(c, RCX, r->get<NumberNode>().value);
+        }
+        return JIT_INT;
+    }
+
+    int temp = alloc_slot(c);
+    if (lt == JIT_INT)
+    {
+        store_int(c, temp);
+    }
+    else
+    {
+        store_float(c, temp);
+    }
+    JitType rt = emit_expr(c, r);
+    c->nslots--;
+    if (!c->ok)
+    {
+        return JIT_VOID;
+    }
+
+    if (lt == JIT_INT && rt == JIT_INT)
+    {
+        put(c, { 0x48, 0x89, 0xC1 });                   // mov rcx, rax
+        load_int(c, RAX, temp);
+        return JIT_INT;
+    }
+    if (rt == JIT_INT)
+    {
+        put(c, { 0xF2, 0x48, 0x0F, 0x2A, 0xC8 });       // cvtsi2sd xmm1, rax
+    }
+    else
+    {
+        put(c, { 0xF2, 0x0F, 0x10, 0xC8 });             // movsd xmm1, xmm0
+    }
+    if (lt == JIT_INT)
+    {
+        put_slot(c, { 0xF2, 0x48, 0x0F, 0x2A }, 0, temp); // cvtsi2sd xmm0, [temp]
+    }
+    else
+    {
+        load_float(c, 0, temp);
+    }
+    return JIT_FLOAT;
+}
+
+static JitType emit_arith(JitCompiler *c, BinOpNode &binop)
+{
+    JitType t = emit_operands(c, binop);
+    if (!c->ok)
+    {
+        return JIT_VOID;
+    }
+
+    if (t == JIT_INT)
+    {
+        switch (binop.op)
+        {
+        case OP_ADD:
+            put(c, { 0x48, 0x01, 0xC8 });               // add rax, rcx
+            return JIT_INT;
+        case OP_SUB:
+            put(c, { 0x48, 0x29, 0xC8 });               // sub rax, rcx
+            return JIT_INT;
+        case OP_MUL:
+            put(c, { 0x48, 0x0F, 0xAF, 0xC1 });         // imul rax, rcx
+            return JIT_INT;
+        case OP_MOD:
+            // x % 0 is left to the VM
+            put(c, { 0x48, 0x85, 0xC9 });               // test rcx, rcx
+            c->bails.push_back(jump(c, CC_E));
+            put(c, { 0x48, 0x99 });                     // cqo
+            put(c, { 0x48, 0xF7, 0xF9 });               // idiv rcx
+            put(c, { 0x48, 0x89, 0xD0 });               // mov rax, rdx
+            return JIT_INT;
+        case OP_DIV:
+            // Int division gives a float, except x / 0 which gives int 0
+            put(c, { 0x48, 0x85, 0xC9 });               // test rcx, rcx
+            c->bails.push_back(jump(c, CC_E));
+            put(c, { 0xF2, 0x48, 0x0F, 0x2A, 0xC0 });   // cvtsi2sd xmm0, rax
+            put(c, { 0xF2, 0x48, 0x0F, 0x2A, 0xC9 });   // cvtsi2sd xmm1, rcx
+            put(c, { 0xF2, 0x0F, 0x5E, 0xC1 });         // divsd xmm0, xmm1
+            return JIT_FLOAT;
+        default:
+            c->ok = 0;
+            return JIT_VOID;
+        }
+    }
+
+    switch (binop.op)
+    {
+    case OP_ADD:
+        put(c, { 0xF2, 0x0F, 0x58, 0xC1 });             // addsd xmm0, xmm1
+        return JIT_FLOAT;
+    case OP_SUB:
+        put(c, { 0xF2, 0x0F, 0x5C, 0xC1 });             // subsd xmm0, xmm1
+        return JIT_FLOAT;
+    case OP_MUL:
+        put(c, { 0xF2, 0x0F, 0x59, 0xC1 });             // mulsd xmm0, xmm1
+        return JIT_FLOAT;
+    case OP_DIV:
+        // Division by 0.0 is left to the VM
+        put(c, { 0x66, 0x0F, 0x57, 0xD2 });             // xorpd xmm2, xmm2
+        put(c, { 0x66, 0x0F, 0x2E, 0xCA });             // ucomisd xmm1, xmm2
+        c->bails.push_back(jump(c, CC_E));
+        put(c, { 0xF2, 0x0F, 0x5E, 0xC1 });             // divsd xmm0, xmm1
+        return JIT_FLOAT;
+    default:
+        // Float modulo rounds through fmod; not compiled
+        c->ok = 0;
+        return JIT_VOID;
+    }
+}
+
+// A call of the function being compiled, made directly to its own code
+static JitType emit_self_call(JitCompiler *c, CallNode &call, int bail_on_null)
+{
+    int nparams = c->def->param_count;
+    if (call.intrinsic != INTRINSIC_NONE || strcmp(call.name, c->def->name) != 0 || call.args.count != nparams)
+    {
+        c->ok = 0;
+        return JIT_VOID;
+    }
+
+    // Argument i goes to the slot 8 * i bytes above argument 0
+    int base = c->nslots;
+    for (int i = 0; i < nparams; i++)
+    {
+        alloc_slot(c);
+    }
+    for (int i = 0; i < nparams && c->ok; i++)
+    {
+        JitType t = emit_expr(c, call.args.items[i]);
+        if (t != c->params[i])
+        {
+            c->ok = 0;
+            break;
+        }
+        if (t == JIT_INT)
+        {
+            store_int(c, base + nparams - 1 - i);
+        }
+        else
+        {
+            store_float(c, base + nparams - 1 - i);
+        }
+    }
+    c->nslots = base;
+    if (!c->ok)
+    {
+        return JIT_VOID;
+    }
+
+    put_slot(c, { 0x48, 0x8D }, RDI, base + nparams - 1);   // lea rdi, [args]
+    put(c, { 0xE8 });                                       // call <entry>
+    put32(c, 0);
+    patch(c, c->code.size() - 4, 0);
+
+    // A bail-out unwinds every pending call; a missing result can only
+    // be used by the VM
+    put(c, { 0x48, 0x83, 0xFA, (uint8_t)(bail_on_null ? JIT_RET_VALUE : JIT_RET_BAIL) });
+    c->bails.push_back(jump(c, bail_on_null ? CC_NE : CC_E));   // cmp rdx, status
+    if (c->ret == JIT_FLOAT)
+    {
+        put(c, { 0x66, 0x48, 0x0F, 0x6E, 0xC0 });               // movq xmm0, rax
+    }
+    return c->ret;
+}
+
+static JitType emit_expr(JitCompiler *c, AstNode *n)
+{
+    if (!c->ok || !n)
+    {
+        c->ok = 0;
+        return JIT_VOID;
+    }
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        load_imm(c, RAX, n->get<NumberNode>().value);
+        return JIT_INT;
+
+    case NODE_FLOAT:
+    {
+        int64_t bits;
+        double f = n->get<FloatNode>().value;
+        memcpy(&bits, &f, 8);
+        load_imm(c, RAX, bits);
+        put(c, { 0x66, 0x48, 0x0F, 0x6E, 0xC0 });       // movq xmm0, rax
+        return JIT_FLOAT;
+    }
+
+    case NODE_IDENT:
+    {
+        const JitLocal *local = find_local(c, n->get<IdentNode>().name);
+        if (!local)
+        {
+            // Anything but a local of this call could be seen or changed
+            // by someone else
+            break;
+        }
+        if (local->type == JIT_INT)
+        {
+            load_int(c, RAX, local->slot);
+        }
+        else
+        {
+            load_float(c, 0, local->slot);
+        }
+        return local->type;
+    }
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op <= OP_MOD)
+        {
+            return emit_arith(c, binop);
+        }
+        // Comparisons give bools, which only conditions can use
+        break;
+    }
+
+    case NODE_CALL:
+        return emit_self_call(c, n->get<CallNode>(), 1);
+
+    default:
+        break;
+    }
+    c->ok = 0;
+    return JIT_VOID;
+}
+
+// --- Conditions -----------------------------------------------------------
+
+static int negate(int cc)
+{
+    return cc ^ 1;
+}
+
+// Emits a comparison and returns the condition code that holds when the
+// comparison is true
+static int emit_compare(JitCompiler *c, BinOpNode &binop)
+{
+    JitType t = emit_operands(c, binop);
+    if (!c->ok)
+    {
+        return 0;
+    }
+
+    if (t == JIT_INT)
+    {
+        put(c, { 0x48, 0x39, 0xC8 });                   // cmp rax, rcx
+        switch (binop.op)
+        {
+        case OP_EQ:  return CC_E;
+        case OP_NEQ: return CC_NE;
+        case OP_LT:  return CC_L;
+        case OP_GT:  return CC_G;
+        case OP_LTE: return CC_LE;
+        default:     return CC_GE;
+        }
+    }
+
+    // Unordered (NaN) operands make every comparison false, as in C
+    switch (binop.op)
+    {
+    case OP_EQ:
+    case OP_NEQ:
+    {
+        // Equal when |l - r| < EPSILON
+        int64_t bits;
+        double eps = EPSILON;
+        memcpy(&bits, &eps, 8);
+        put(c, { 0xF2, 0x0F, 0x5C, 0xC1 });             // subsd xmm0, xmm1
+        put(c, { 0x66, 0x48, 0x0F, 0x7E, 0xC0 });       // movq rax, xmm0
+        put(c, { 0x48, 0xD1, 0xE0 });                   // shl rax, 1
+        put(c, { 0x48, 0xD1, 0xE8 });                   // shr rax, 1
+        put(c, { 0x66, 0x48, 0x0F, 0x6E, 0xC0 });       // movq xmm0, rax
+        load_imm(c, RAX, bits);
+        put(c, { 0x66, 0x48, 0x0F, 0x6E, 0xC8 });       // movq xmm1, rax
+        if (binop.op == OP_EQ)
+        {
+            put(c, { 0x66, 0x0F, 0x2E, 0xC8 });         // ucomisd xmm1, xmm0
+            return CC_A;
+        }
+        put(c, { 0x66, 0x0F, 0x2E, 0xC1 });             // ucomisd xmm0, xmm1
+        return CC_AE;
+    }
+    case OP_GT:
+        put(c, { 0x66, 0x0F, 0x2E, 0xC1 });             // ucomisd xmm0, xmm1
+        return CC_A;
+    case OP_GTE:
+        put(c, { 0x66, 0x0F, 0x2E, 0xC1 });
+        return CC_AE;
+    case OP_LT:
+        put(c, { 0x66, 0x0F, 0x2E, 0xC8 });             // ucomisd xmm1, xmm0
+        return CC_A;
+    default:
+        put(c, { 0x66, 0x0F, 0x2E, 0xC8 });
+        return CC_AE;
+    }
+}
+
+// Jumps to target when the truthiness of n equals jump_if, else falls
+// through
+static void emit_cond(JitCompiler *c, AstNode *n, int jump_if, std::vector<size_t> *target)
+{
+    if (!c->ok || !n)
+    {
+        c->ok = 0;
+        return;
+    }
+    switch (n->kind)
+    {
+    case NODE_BOOL:
+        if (n->get<BoolNode>().value == (bool)jump_if)
+        {
+            target->push_back(jump(c, 0));
+        }
+        return;
+
+    case NODE_NOT:
+        emit_cond(c, n->get<NotNode>().expr, !jump_if, target);
+        return;
+
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        if (binop.op == OP_AND || binop.op == OP_OR)
+        {
+            // The left side alone decides when it is false for &&, or true
+            // for ||
+            int decides = binop.op == OP_OR;
+            if (decides == jump_if)
+            {
+                emit_cond(c, binop.left, jump_if, target);
+                emit_cond(c, binop.right, jump_if, target);
+            }
+            else
+            {
+                std::vector<size_t> skip;
+                emit_cond(c, binop.left, decides, &skip);
+                emit_cond(c, binop.right, jump_if, target);
+                patch_all(c, skip, c->code.size());
+            }
+            return;
+        }
+        if (binop.op >= OP_EQ)
+        {
+            int cc = emit_compare(c, binop);
+            if (c->ok)
+            {
+                target->push_back(jump(c, jump_if ? cc : negate(cc)));
+            }
+            return;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    // Any other int or float: truthy when non-zero (NaN is truthy)
+    JitType t = emit_expr(c, n);
+    if (!c->ok)
+    {
+        return;
+    }
+    if (t == JIT_INT)
+    {
+        put(c, { 0x48, 0x85, 0xC0 });                   // test rax, rax
+        target->push_back(jump(c, jump_if ? CC_NE : CC_E));
+        return;
+    }
+    put(c, { 0x66, 0x0F, 0x57, 0xC9 });                 // xorpd xmm1, xmm1
+    put(c, { 0x66, 0x0F, 0x2E, 0xC1 });                 // ucomisd xmm0, xmm1
+    if (jump_if)
+    {
+        target->push_back(jump(c, CC_NE));
+        target->push_back(jump(c, CC_P));
+    }
+    else
+    {
+        size_t nan = jump(c, CC_P);
+        target->push_back(jump(c, CC_E));
+        patch(c, nan, c->code.size());
+    }
+}
+
+// --- Statements -----------------------------------------------------------
+
+static void emit_stmt(JitCompiler *c, AstNode *n);
+
+static void emit_block(JitCompiler *c, NodeList &list)
+{
+    size_t locals = c->locals.size();
+    int slots = c->nslots;
+    for (int i = 0; i < list.count && c->ok; i++)
+    {
+        emit_stmt(c, list.items[i]);
+    }
+    c->locals.resize(locals);
+    c->nslots = slots;
+}
+
+static void emit_store(JitCompiler *c, JitType t, int slot)
+{
+    if (t == JIT_INT)
+    {
+        store_int(c, slot);
+    }
+    else
+    {
+        store_float(c, slot);
+    }
+}
+
+static void emit_loop_end(JitCompiler *c, size_t next, size_t exit)
+{
+    JitLoop &loop = c->loops.back();
+    patch_all(c, loop.continues, next);
+    patch_all(c, loop.breaks, exit);
+    c->loops.pop_back();
+}
+
+static void emit_stmt(JitCompiler *c, AstNode *n)
+{
+    if (!c->ok || !n)
+    {
+        return;
+    }
+    switch (n->kind)
+    {
+    case NODE_LET:
+    {
+        LetNode &let = n->get<LetNode>();
+        JitType t = emit_expr(c, let.expr);
+        if (!c->ok || strcmp(let.name, c->def->name) == 0)
+        {
+            c->ok = 0;
+            return;
+        }
+        int slot = alloc_slot(c);
+        emit_store(c, t, slot);
+        c->locals.push_back({ let.name, slot, t });
+        return;
+    }
+
+    case NODE_ASSIGN:
+    {
+        AssignNode &assign = n->get<AssignNode>();
+        const JitLocal *local = find_local(c, assign.name);
+        if (!local)
+        {
+            c->ok = 0;
+            return;
+        }
+        int slot = local->slot;
+        JitType want = local->type;
+        JitType t = emit_expr(c, assign.expr);
+        if (c->ok && t != want)
+        {
+            // A local keeps one type for the whole body
+            c->ok = 0;
+        }
+        if (c->ok)
+        {
+            emit_store(c, t, slot);
+        }
+        return;
+    }
+
+    case NODE_INC:
+    case NODE_DEC:
+    {
+        const char *name = n->kind == NODE_INC ?
+            n->get<IncNode>().name : n->get<DecNode>().name;
+        const JitLocal *local = find_local(c, name);
+        if (!local || local->type != JIT_INT)
+        {
+            c->ok = 0;
+            return;
+        }
+        // add / sub qword [slot], 1
+        put_slot(c, { 0x48, 0x83 }, n->kind == NODE_INC ? 0 : 5, local->slot);
+        put(c, { 1 });
+        return;
+    }
+
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        std::vector<size_t> else_jumps;
+        emit_cond(c, node.cond, 0, &else_jumps);
+        emit_block(c, node.then_block);
+        if (node.else_block.count > 0)
+        {
+            size_t end = jump(c, 0);
+            patch_all(c, else_jumps, c->code.size());
+            emit_block(c, node.else_block);
+            patch(c, end, c->code.size());
+        }
+        else
+        {
+            patch_all(c, else_jumps, c->code.size());
+        }
+        return;
+    }
+
+    case NODE_WHILE:
+    {
+        WhileNode &node = n->get<WhileNode>();
+        size_t top = c->code.size();
+        c->loops.push_back(JitLoop());
+        emit_cond(c, node.cond, 0, &c->loops.back().breaks);
+        emit_block(c, node.body);
+        patch(c, jump(c, 0), top);
+        emit_loop_end(c, top, c->code.size());
+        return;
+    }
+
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+        if (!node.cond)
+        {
+            c->ok = 0;
+            return;
+        }
+        size_t locals = c->locals.size();
+        int slots = c->nslots;
+        emit_stmt(c, node.init);
+        size_t top = c->code.size();
+        c->loops.push_back(JitLoop());
+        emit_cond(c, node.cond, 0, &c->loops.back().breaks);
+        emit_block(c, node.body);
+        size_t next = c->code.size();
+        emit_stmt(c, node.incr);
+        patch(c, jump(c, 0), top);
+        emit_loop_end(c, next, c->code.size());
+        c->locals.resize(locals);
+        c->nslots = slots;
+        return;
+    }
+
+    case NODE_BREAK:
+    case NODE_CONTINUE:
+        if (c->loops.empty())
+        {
+            c->ok = 0;
+            return;
+        }
+        (n->kind == NODE_BREAK ? c->loops.back().breaks : c->loops.back().continues)
+            .push_back(jump(c, 0));
+        return;
+
+    case NODE_BLOCK:
+        emit_block(c, n->get<BlockNode>().items);
+        return;
+
+    case NODE_GROUP:
+    {
+        NodeList &items = n->get<BlockNode>().items;
+        for (int i = 0; i < items.count && c->ok; i++)
+        {
+            emit_stmt(c, items.items[i]);
+        }
+        return;
+    }
+
+    case NODE_RETURN:
+    {
+        AstNode *expr = n->get<ReturnNode>().expr;
+        if (!expr)
+        {
+            put(c, { 0x31, 0xC0 });                     // xor eax, eax
+            put(c, { 0xBA });                           // mov edx, JIT_RET_NULL
+            put32(c, JIT_RET_NULL);
+            put(c, { 0xC9, 0xC3 });                     // leave; ret
+            return;
+        }
+        JitType t = emit_expr(c, expr);
+        if (!c->ok || t != c->ret)
+        {
+            c->ok = 0;
+            return;
+        }
+        if (t == JIT_FLOAT)
+        {
+            put(c, { 0x66, 0x48, 0x0F, 0x7E, 0xC0 });   // movq rax, xmm0
+        }
+        put(c, { 0xBA });                               // mov edx, JIT_RET_VALUE
+        put32(c, JIT_RET_VALUE);
+        put(c, { 0xC9, 0xC3 });                         // leave; ret
+        return;
+    }
+
+    case NODE_CALL:
+        // Calls to itself are the only calls without side effects
+        emit_self_call(c, n->get<CallNode>(), 0);
+        return;
+
+    default:
+        c->ok = 0;
+        return;
+    }
+}
+
+// --- Functions ------------------------------------------------------------
+
+// Compiles fn for the given parameter and return types into c->code
+static int emit_function(JitCompiler *c)
+{
+    FuncDefNode &def = *c->def;
+    int nparams = def.param_count;
+
+    put(c, { 0x55 });                                   // push rbp
+    put(c, { 0x48, 0x89, 0xE5 });                       // mov rbp, rsp
+    put(c, { 0x48, 0x81, 0xEC });                       // sub rsp, frame
+    size_t frame = c->code.size();
+    put32(c, 0);
+
+    load_imm(c, RAX, (int64_t)(uintptr_t)&jit_stack_limit);
+    put(c, { 0x48, 0x3B, 0x20 });                       // cmp rsp, [rax]
+    c->bails.push_back(jump(c, CC_B));
+
+    // Parameters take the first slots
+    for (int i = 0; i < nparams; i++)
+    {
+        if (strcmp(def.params[i], def.name) == 0)
+        {
+            return 0;
+        }
+        put(c, { 0x48, 0x8B, 0x87 });                   // mov rax, [rdi + 8i]
+        put32(c, 8 * i);
+        store_int(c, alloc_slot(c));
+        c->locals.push_back({ def.params[i], i, c->params[i] });
+    }
+
+    emit_block(c, def.body);
+    if (!c->ok)
+    {
+        return 0;
+    }
+
+    // Falling off the end returns null
+    put(c, { 0x31, 0xC0 });                             // xor eax, eax
+    put(c, { 0xBA });
+    put32(c, JIT_RET_NULL);
+    put(c, { 0xC9, 0xC3 });
+
+    size_t bail = c->code.size();
+    put(c, { 0xBA });
+    put32(c, JIT_RET_BAIL);
+    put(c, { 0xC9, 0xC3 });
+    patch_all(c, c->bails, bail);
+
+    int32_t bytes = (int32_t)((c->max_slots * 8 + 15) & ~15);
+    memcpy(&c->code[frame], &bytes, 4);
+    return 1;
+}
+
+// Compiles fn specialized to the types of args, or returns nullptr
+static JitCode *jit_compile(AstNode *fn, int argc, const Value *args)
+{
+    FuncDefNode &def = fn->get<FuncDefNode>();
+    if (argc != def.param_count || argc > JIT_MAX_ARGS)
+    {
+        return nullptr;
+    }
+
+    // The return type is not known up front: try int, then float
+    static const JitType rets[] = { JIT_INT, JIT_FLOAT };
+    for (JitType ret : rets)
+    {
+        JitCompiler c;
+        c.def = &def;
+        c.ret = ret;
+        c.nslots = 0;
+        c.max_slots = 0;
+        c.ok = 1;
+        for (int i = 0; i < argc; i++)
+        {
+            if (args[i].type != VAL_INT && args[i].type != VAL_FLOAT)
+            {
+                return nullptr;
+            }
+            c.params[i] = args[i].type == VAL_INT ? JIT_INT : JIT_FLOAT;
+        }
+        if (!emit_function(&c))
+        {
+            continue;
+        }
+
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (c.code.size() + page - 1) / page * page;
+        void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        memcpy(mem, c.code.data(), c.code.size());
+        if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(mem, size);
+            return nullptr;
+        }
+
+        JitCode *code = new JitCode();
+        code->mem = mem;
+        code->size = size;
+        code->entry = (JitEntry)mem;
+        memcpy(code->params, c.params, sizeof(c.params));
+        code->nparams = argc;
+        code->ret = ret;
+        return code;
+    }
+    return nullptr;
+}
+
+#endif // LUNA_JIT
+
+int jit_call(AstNode *fn, int argc, const Value *args, Value *out)
+{
+#ifdef LUNA_JIT
+    FuncDefNode &def = fn->get<FuncDefNode>();
+    if (!def.jit)
+    {
+        if (luna_no_jit || def.calls < 0 || ++def.calls < JIT_HOT_CALLS)
+        {
+            return 0;
+        }
+        def.jit = jit_compile(fn, argc, args);
+        if (!def.jit)
+        {
+            def.calls = -1;
+            return 0;
+        }
+    }
+
+    // Guard: the arguments must have the types the code was compiled for
+    JitCode *code = def.jit;
+    if (argc != code->nparams)
+    {
+        return 0;
+    }
+    int64_t raw[JIT_MAX_ARGS];
+    for (int i = 0; i < argc; i++)
+    {
+        if (code->params[i] == JIT_INT && args[i].type == VAL_INT)
+        {
+            raw[i] = args[i].i;
+        }
+        else if (code->params[i] == JIT_FLOAT && args[i].type == VAL_FLOAT)
+        {
+            memcpy(&raw[i], &args[i].f, 8);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    char here;
+    jit_stack_limit = (uintptr_t)&here - JIT_STACK_BYTES;
+    JitResult res = code->entry(raw);
+    switch (res.status)
+    {
+    case JIT_RET_VALUE:
+        if (code->ret == JIT_INT)
+        {
+            *out = value_int(res.value);
+        }
+        else
+        {
+            double f;
+            memcpy(&f, &res.value, 8);
+            *out = value_float(f);
+        }
+        return 1;
+    case JIT_RET_NULL:
+        *out = value_null();
+        return 1;
+    default:
+        // Code that bailed out once is likely to again: leave it to the VM
+        jit_free(code);
+        def.jit = nullptr;
+        def.calls = -1;
+        return 0;
+    }
+#else
+    (void)fn;
+    (void)argc;
+    (void)args;
+    (void)out;
+    return 0;
+#endif
+}
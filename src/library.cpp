@@ -16,6 +16,8 @@
 #include "vec_lib.h"
 #include "file_lib.h" 
 #include "list_lib.h" // Added for sort and shuffle
+#include "map_lib.h"
+#include "memo.h"
 #include "gui_lib.h" // For GUI
 
 // Sand Lib Externs
@@ -31,10 +33,11 @@ static int lib_is_truthy(Value v) {
         case VAL_BOOL:   return v.b;
         case VAL_INT:    return v.i != 0;
         case VAL_FLOAT:  return v.f != 0.0;
-        case VAL_STRING: return v.string && v.string->chars && v.string->chars[0] != '\0';
+        case VAL_STRING: return value_chars(&v)[0] != '\0';
         case VAL_NULL:   return 0;
         case VAL_LIST:   
         case VAL_DENSE_LIST: return 1; // Updated to include Dense Lists
+        case VAL_MAP:    return 1;
         case VAL_NATIVE: return 1;
         case VAL_CHAR:   return v.c != 0;
         case VAL_FILE:   return v.file != NULL; // Files are truthy if open
@@ -63,6 +66,23 @@ static Value lib_assert(int argc, Value *argv, Env *env) {
     return value_bool(1);
 }
 
+// Natives that change their list (or map) arguments in place
+static const NativeFunc mutating_natives[] = {
+    lib_list_sort,
+    lib_list_shuffle,
+    lib_list_append,
+    lib_map_remove,
+};
+
+int native_mutates_args(NativeFunc fn) {
+    for (size_t i = 0; i < sizeof(mutating_natives) / sizeof(mutating_natives[0]); i++) {
+        if (mutating_natives[i] == fn) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void env_register_stdlib(Env *env) {
     env_def(env, "null", value_null());
     
@@ -142,6 +162,7 @@ void env_register_stdlib(Env *env) {
     
     env_def(env, "split", value_native(lib_str_split));
     env_def(env, "join", value_native(lib_str_join));
+    env_def(env, "string_builder", value_native(lib_str_builder));
     
     env_def(env, "is_digit", value_native(lib_str_is_digit));
     env_def(env, "is_alpha", value_native(lib_str_is_alpha));
@@ -158,6 +179,16 @@ void env_register_stdlib(Env *env) {
     env_def(env, "list_append", value_native(lib_list_append));
     env_def(env, "dense_list", value_native(lib_dense_list));
 
+    // Map Library
+    env_def(env, "keys", value_native(lib_map_keys));
+    env_def(env, "values", value_native(lib_map_values));
+    env_def(env, "has", value_native(lib_map_has));
+    env_def(env, "remove", value_native(lib_map_remove));
+
+    // Memoization ('memo func')
+    env_def(env, "memo_limit", value_native(lib_memo_limit));
+    env_def(env, "memo_stats", value_native(lib_memo_stats));
+
     // Time Library
     env_def(env, "clock", value_native(lib_time_clock));
    
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <luna/list_lib.h>
 #include <luna/value.h>
+#include <luna/temp.h>
 #include <luna/math_lib.h> // For math_internal_next()
 #include <luna/luna_error.h>
 
@@ -24,7 +25,7 @@ static int value_less_than(Value a, Value b)
     if (a.type == VAL_FLOAT && b.type == VAL_INT)
         return a.f < (double)b.i;
     if (a.type == VAL_STRING && b.type == VAL_STRING)
-        return strcmp(a.s, b.s) < 0;
+        return strcmp(value_chars(&a), value_chars(&b)) < 0;
     return 0;
 }
 
@@ -50,8 +51,9 @@ static void merge(Value *items, int l, int m, int r)
     int n1 = m - l + 1;
     int n2 = r - m;
 
-    Value *L = (Value*)malloc(n1 * sizeof(Value));
-    Value *R = (Value*)malloc(n2 * sizeof(Value));
+    TempMark mark = temp_mark();
+    Value *L = (Value*)temp_alloc(n1 * sizeof(Value));
+    Value *R = (Value*)temp_alloc(n2 * sizeof(Value));
 
     for (int i = 0; i < n1; i++)
         L[i] = items[l + i];
@@ -76,8 +78,7 @@ static void merge(Value *items, int l, int m, int r)
     while (j < n2)
         items[k++] = R[j++];
 
-    free(L);
-    free(R);
+    temp_release(mark);
 }
 
 // Recursive Hybrid Sort Logic
@@ -107,10 +108,12 @@ Value lib_list_sort(int argc, Value *argv)
         return value_null();
     }
 
+    // A list passed by value may still be shared; sort a private copy
+    value_list_unique(&argv[0]);
     Value list = argv[0];
-    if (list.list.count > 1)
+    if (list.list->count > 1)
     {
-        hybrid_sort(list.list.items, 0, list.list.count - 1);
+        hybrid_sort(list.list->items, 0, list.list->count - 1);
     }
     return value_null();
 }
@@ -125,8 +128,9 @@ Value lib_list_shuffle(int argc, Value *argv)
         return value_null();
     }
 
+    value_list_unique(&argv[0]);
     Value list = argv[0];
-    int n = list.list.count;
+    int n = list.list->count;
     if (n <= 1)
         return value_null();
 
@@ -136,10 +140,23 @@ Value lib_list_shuffle(int argc, Value *argv)
         int j = (int)(math_internal_next() % (i + 1));
 
         // Swap
-        Value temp = list.list.items[i];
-        list.list.items[i] = list.list.items[j];
-        list.list.items[j] = temp;
+        Value temp = list.list->items[i];
+        list.list->items[i] = list.list->items[j];
+        list.list->items[j] = temp;
     }
 
     return value_null();
-}
\ No newline at end of file
+}
+
+// list_append(list, value): append() as a native, so it can be passed the
+// list variable itself (see native_mutates_args)
+Value lib_list_append(int argc, Value *argv)
+{
+    if (argc != 2 || argv[0].type != VAL_LIST)
+    {
+        error_report(ERR_ARGUMENT, 0, 0, "list_append() expects a list and a value", "Usage: list_append(myList, value)");
+        return value_null();
+    }
+    value_list_append(&argv[0], argv[1]);
+    return value_null();
+}
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h> 
+#include <vector>
 #include <luna/util.h>
 #include <luna/parser.h>
 #include <luna/interpreter.h>
@@ -13,6 +14,11 @@
 #include <luna/env.h>
 #include <luna/library.h>
 #include <luna/math_lib.h>
+#include <luna/bytecode.h>
+#include <luna/optimizer.h>
+#include <luna/jit.h>
+#include <luna/emit_c.h>
+#include <luna/memo.h>
 
 #define MAX_INPUT 1024
 
@@ -22,6 +28,10 @@ void run_repl(Env *env)
     char line[MAX_INPUT];
     printf("Luna v0.1 REPL\nType 'exit' or Ctrl+C to quit.\n");
 
+    // env keeps pointing into the trees of earlier lines (the functions
+    // they defined), so every line is kept until the session ends
+    std::vector<AstNode*> lines;
+
     while (1)
     {
         printf("> ");
@@ -51,11 +61,17 @@ void run_repl(Env *env)
 
         if (prog)
         {
+            prog = optimize_program(prog);
             interpret(prog, env);
-            ast_free(prog);
+            lines.push_back(prog);
         }
         // If !prog, the parser already printed the error to stderr, so we just loop again
     }
+
+    for (AstNode *prog : lines)
+    {
+        ast_free(prog);
+    }
 }
 
 static int ends_with_lu(const char *s)
@@ -64,6 +80,17 @@ static int ends_with_lu(const char *s)
     return n >= 3 && strcmp(s + n - 3, ".lu") == 0;
 }
 
+// Prints the bytecode of a proto and of every function it defines
+static void dump_bytecode(Proto *proto)
+{
+    proto_dump(proto, stdout);
+    for (size_t i = 0; i < proto->funcs.size(); i++)
+    {
+        printf("\n");
+        dump_bytecode(compile_function(proto->funcs[i]));
+    }
+}
+
 int main(int argc, char **argv)
 {
     // Force standard "C" locale to ensure '.' is treated as a decimal point
@@ -80,7 +107,49 @@ int main(int argc, char **argv)
     // Passing 0 and NULL triggers the internal get_os_entropy() fallback
     lib_math_srand(0, NULL);
 
-    if (argc < 2)
+    // Options come before the script name
+    const char *path = NULL;
+    int dump = 0;
+    int dump_ast = 0;
+    int emit = 0;
+    int stats = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--tree-walk"))
+        {
+            luna_use_tree_walker = 1;
+        }
+        else if (!strcmp(argv[i], "--dump-bytecode"))
+        {
+            dump = 1;
+        }
+        else if (!strcmp(argv[i], "--dump-ast"))
+        {
+            dump_ast = 1;
+        }
+        else if (!strcmp(argv[i], "--emit-c"))
+        {
+            emit = 1;
+        }
+        else if (!strcmp(argv[i], "--no-opt"))
+        {
+            luna_no_opt = 1;
+        }
+        else if (!strcmp(argv[i], "--no-jit"))
+        {
+            luna_no_jit = 1;
+        }
+        else if (!strcmp(argv[i], "--stats"))
+        {
+            stats = 1;
+        }
+        else if (!path)
+        {
+            path = argv[i];
+        }
+    }
+
+    if (!path)
     {
         // No file provided: Run REPL mode
         run_repl(global_env);
@@ -88,7 +157,7 @@ int main(int argc, char **argv)
     else
     {
 
-        if (!ends_with_lu(argv[1]))
+        if (!ends_with_lu(path))
         {
             fprintf(stderr, "Error: expected a .lu file\n");
             env_free_global(global_env);
@@ -96,16 +165,16 @@ int main(int argc, char **argv)
         }
 
         // File provided: Run File mode
-        char *src = read_file(argv[1]);
+        char *src = read_file(path);
         if (!src)
         {
-            fprintf(stderr, "Could not read file: %s\n", argv[1]);
+            fprintf(stderr, "Could not read file: %s\n", path);
             env_free_global(global_env);
             return 1;
         }
 
         // Initialize error system with file source
-        error_init(src, argv[1]);
+        error_init(src, path);
 
         Parser parser;
         parser_init(&parser, src);
@@ -123,13 +192,45 @@ int main(int argc, char **argv)
             return 1;
         }
 
-        // Execute the parsed program
-        interpret(prog, global_env);
+        prog = optimize_program(prog);
+
+        if (dump_ast)
+        {
+            // Show the tree as it will be executed
+            ast_dump(prog, stdout);
+        }
+        else if (emit)
+        {
+            // Translate to C++ for an ahead-of-time build (see emit_c.h)
+            emit_c(prog, src, path, stdout);
+        }
+        else if (dump)
+        {
+            // Show the compiled program instead of running it
+            Proto *proto = compile_program(prog);
+            dump_bytecode(proto);
+            proto_free(proto);
+        }
+        else
+        {
+            // Execute the parsed program
+            interpret(prog, global_env);
+            if (stats)
+            {
+                // Memo tables go with the program
+                memo_report(stderr);
+            }
+        }
 
         ast_free(prog);
         free(src);
     }
 
+    if (stats)
+    {
+        fprintf(stderr, "scope allocations: %zu\n", env_heap_allocs());
+    }
+
     env_free_global(global_env);
     return 0;
 }
\ No newline at end of file
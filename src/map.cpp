@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Maps (VAL_MAP): open addressing in the style of a Swiss table. Each slot
+// has a control byte holding 7 bits of its key's hash, so a lookup compares
+// a whole group of 16 slots against those bits at once and only looks at
+// the entries that match. The entries themselves sit in a separate array
+// in insertion order, which is the order keys() and print show.
+
+#include <stdlib.h>
+#include <string.h>
+#include <luna/value.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAP_SSE2 1
+#endif
+
+#define MAP_GROUP 16            // Slots compared at once
+#define MAP_EMPTY 0x80          // Control bytes of slots without a key
+#define MAP_REMOVED 0xFE        // (full slots hold 0..127)
+
+static int lowest_bit(unsigned int bits)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, bits);
+    return (int)i;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+// Bit i is set when control byte i of the group equals byte
+static unsigned int group_match(const unsigned char *group, unsigned char byte)
+{
+#ifdef MAP_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+    unsigned int bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++)
+    {
+        bits |= (unsigned int)(group[i] == byte) << i;
+    }
+    return bits;
+#endif
+}
+
+// Bit i is set when slot i of the group has no key (empty or removed)
+static unsigned int group_free(const unsigned char *group)
+{
+#ifdef MAP_SSE2
+    return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    unsigned int bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++)
+    {
+        bits |= (unsigned int)(group[i] >> 7) << i;
+    }
+    return bits;
+#endif
+}
+
+static unsigned int mix(unsigned long long x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return (unsigned int)x;
+}
+
+// The low 7 bits go to the control byte, the rest pick the first group
+static unsigned int key_hash(const Value *key)
+{
+    unsigned long long tag = (unsigned long long)key->type << 56;
+    switch (key->type)
+    {
+    case VAL_INT:
+        return mix((unsigned long long)key->i ^ tag);
+    case VAL_STRING:
+        return mix(value_string_hash(key) ^ tag);
+    case VAL_CHAR:
+        return mix((unsigned char)key->c ^ tag);
+    default:
+        return mix((unsigned long long)key->b ^ tag);
+    }
+}
+
+static int same_key(const Value *a, const Value *b)
+{
+    if (a->type != b->type)
+    {
+        return 0;
+    }
+    switch (a->type)
+    {
+    case VAL_INT:
+        return a->i == b->i;
+    case VAL_STRING:
+        return value_string_equal(a, b);
+    case VAL_CHAR:
+        return a->c == b->c;
+    default:
+        return a->b == b->b;
+    }
+}
+
+int value_map_key_ok(const Value *key)
+{
+    return key->type == VAL_INT || key->type == VAL_STRING ||
+        key->type == VAL_CHAR || key->type == VAL_BOOL;
+}
+
+// Empty tables of the given slot count. Entries fill at most 7/8 of the
+// slots, so every probe sequence reaches an empty slot.
+static void table_alloc(LunaMap *m, int slots)
+{
+    m->slots = slots;
+    m->capacity = slots / 8 * 7;
+    m->count = 0;
+    m->used = 0;
+    m->ctrl = (unsigned char *)malloc((size_t)slots * (1 + sizeof(int)));
+    m->index = (int *)(m->ctrl + slots);
+    m->entries = (LunaMapEntry *)malloc(sizeof(LunaMapEntry) * m->capacity);
+    memset(m->ctrl, MAP_EMPTY, slots);
+}
+
+Value value_map(void)
+{
+    LunaMap *m = (LunaMap *)malloc(sizeof(LunaMap));
+    m->refcount = 1;
+    table_alloc(m, MAP_GROUP);
+
+    Value v;
+    v.type = VAL_MAP;
+    v.map = m;
+    return v;
+}
+
+// Slot holding key, or -1. Groups are visited in triangular steps, which
+// reaches every group of a power-of-2 table.
+static int find_slot(const LunaMap *m, const Value *key, unsigned int h)
+{
+    size_t mask = (size_t)m->slots / MAP_GROUP - 1;
+    size_t g = (h >> 7) & mask;
+    for (size_t step = 1;; step++)
+    {
+        const unsigned char *group = m->ctrl + g * MAP_GROUP;
+        unsigned int hits = group_match(group, (unsigned char)(h & 0x7F));
+        while (hits)
+        {
+            int slot = (int)(g * MAP_GROUP) + lowest_bit(hits);
+            const LunaMapEntry *e = &m->entries[m->index[slot]];
+            if (e->hash == h && same_key(&e->key, key))
+            {
+                return slot;
+            }
+            hits &= hits - 1;
+        }
+        if (group_match(group, MAP_EMPTY))
+        {
+            return -1;
+        }
+        g = (g + step) & mask;
+    }
+}
+
+// First slot without a key on h's probe sequence
+static int free_slot(const LunaMap *m, unsigned int h)
+{
+    size_t mask = (size_t)m->slots / MAP_GROUP - 1;
+    size_t g = (h >> 7) & mask;
+    for (size_t step = 1;; step++)
+    {
+        unsigned int bits = group_free(m->ctrl + g * MAP_GROUP);
+        if (bits)
+        {
+            return (int)(g * MAP_GROUP) + lowest_bit(bits);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+static void place(LunaMap *m, int entry)
+{
+    unsigned int h = m->entries[entry].hash;
+    int slot = free_slot(m, h);
+    m->ctrl[slot] = (unsigned char)(h & 0x7F);
+    m->index[slot] = entry;
+}
+
+// Rebuilds the table with room for at least twice its keys, dropping
+// removed entries. Keys keep their order.
+static void rebuild(LunaMap *m)
+{
+    unsigned char *ctrl = m->ctrl;
+    LunaMapEntry *entries = m->entries;
+    int used = m->used;
+
+    int slots = MAP_GROUP;
+    while (slots / 8 * 7 < (m->count + 1) * 2)
+    {
+        slots *= 2;
+    }
+    table_alloc(m, slots);
+    for (int i = 0; i < used; i++)
+    {
+        if (entries[i].key.type != VAL_NULL)
+        {
+            m->entries[m->used] = entries[i];
+            place(m, m->used++);
+        }
+    }
+    m->count = m->used;
+    free(ctrl);
+    free(entries);
+}
+
+// Gives a map its own table before it is modified (copy-on-write). Keys
+// and values are shared with the original.
+void value_map_unique(Value *map)
+{
+    LunaMap *old = map->map;
+    if (old->refcount == 1)
+    {
+        return;
+    }
+
+    LunaMap *copy = (LunaMap *)malloc(sizeof(LunaMap));
+    *copy = *old;
+    copy->refcount = 1;
+    copy->ctrl = (unsigned char *)malloc((size_t)old->slots * (1 + sizeof(int)));
+    copy->index = (int *)(copy->ctrl + old->slots);
+    copy->entries = (LunaMapEntry *)malloc(sizeof(LunaMapEntry) * old->capacity);
+    memcpy(copy->ctrl, old->ctrl, (size_t)old->slots * (1 + sizeof(int)));
+    for (int i = 0; i < old->used; i++)
+    {
+        copy->entries[i].key = value_copy(old->entries[i].key);
+        copy->entries[i].value = value_copy(old->entries[i].value);
+        copy->entries[i].hash = old->entries[i].hash;
+    }
+    old->refcount--;
+    map->map = copy;
+}
+
+Value *value_map_find(const Value *map, const Value *key)
+{
+    if (!value_map_key_ok(key))
+    {
+        return nullptr;
+    }
+    LunaMap *m = map->map;
+    int slot = find_slot(m, key, key_hash(key));
+    return slot < 0 ? nullptr : &m->entries[m->index[slot]].value;
+}
+
+Value *value_map_slot(Value *map, const Value *key)
+{
+    if (!value_map_key_ok(key))
+    {
+        return nullptr;
+    }
+    value_map_unique(map);
+    LunaMap *m = map->map;
+    unsigned int h = key_hash(key);
+    int slot = find_slot(m, key, h);
+    if (slot >= 0)
+    {
+        return &m->entries[m->index[slot]].value;
+    }
+
+    if (m->used == m->capacity)
+    {
+        rebuild(m);
+    }
+    int entry = m->used++;
+    m->entries[entry].key = value_copy(*key);
+    m->entries[entry].value = value_null();
+    m->entries[entry].hash = h;
+    place(m, entry);
+    m->count++;
+    return &m->entries[entry].value;
+}
+
+int value_map_remove(Value *map, const Value *key)
+{
+    if (!value_map_key_ok(key))
+    {
+        return 0;
+    }
+    unsigned int h = key_hash(key);
+    if (find_slot(map->map, key, h) < 0)
+    {
+        return 0;
+    }
+    value_map_unique(map);
+    LunaMap *m = map->map;
+    int slot = find_slot(m, key, h);
+    LunaMapEntry *e = &m->entries[m->index[slot]];
+    value_free(e->key);
+    value_free(e->value);
+    e->key = value_null();
+    e->value = value_null();
+
+    // The slot stays taken so probes for other keys still pass it
+    m->ctrl[slot] = MAP_REMOVED;
+    m->count--;
+    return 1;
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+#include <luna/map_lib.h>
+#include <luna/value.h>
+#include <luna/luna_error.h>
+
+// Keys or values of a map as a list, in insertion order
+static Value map_column(Value map, int keys)
+{
+    Value list = value_list();
+    value_list_reserve(&list, map.map->count);
+    for (int i = 0; i < map.map->used; i++)
+    {
+        LunaMapEntry *entry = &map.map->entries[i];
+        if (entry->key.type != VAL_NULL)
+        {
+            value_list_append(&list, keys ? entry->key : entry->value);
+        }
+    }
+    return list;
+}
+
+Value lib_map_keys(int argc, Value *argv)
+{
+    if (argc != 1 || argv[0].type != VAL_MAP)
+    {
+        error_report(ERR_ARGUMENT, 0, 0, "keys() expects 1 map", "Usage: keys(myMap)");
+        return value_null();
+    }
+    return map_column(argv[0], 1);
+}
+
+Value lib_map_values(int argc, Value *argv)
+{
+    if (argc != 1 || argv[0].type != VAL_MAP)
+    {
+        error_report(ERR_ARGUMENT, 0, 0, "values() expects 1 map", "Usage: values(myMap)");
+        return value_null();
+    }
+    return map_column(argv[0], 0);
+}
+
+Value lib_map_has(int argc, Value *argv)
+{
+    if (argc != 2 || argv[0].type != VAL_MAP)
+    {
+        error_report(ERR_ARGUMENT, 0, 0, "has() expects a map and a key", "Usage: has(myMap, key)");
+        return value_null();
+    }
+    return value_bool(value_map_find(&argv[0], &argv[1]) != nullptr);
+}
+
+// Gets map variables by reference (see native_mutates_args)
+Value lib_map_remove(int argc, Value *argv)
+{
+    if (argc != 2 || argv[0].type != VAL_MAP)
+    {
+        error_report(ERR_ARGUMENT, 0, 0, "remove() expects a map and a key", "Usage: remove(myMap, key)");
+        return value_null();
+    }
+    return value_bool(value_map_remove(&argv[0], &argv[1]));
+}
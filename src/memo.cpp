@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Result caches of 'memo func' functions (see memo.h). A table is a chained
+// hash table whose entries are also linked from most to least recently used.
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <luna/memo.h>
+
+#define MEMO_MIN_BUCKETS 64
+
+long long luna_memo_limit = MEMO_DEFAULT_LIMIT;
+
+typedef struct MemoEntry
+{
+    unsigned long long hash;
+    Value *args;                // One copy per parameter
+    Value result;
+    struct MemoEntry *chain;    // Next entry in the same bucket
+    struct MemoEntry *newer;
+    struct MemoEntry *older;
+} MemoEntry;
+
+struct MemoTable
+{
+    std::string name;
+    int nparams;
+    MemoEntry **buckets;
+    size_t bucket_count;        // Power of 2
+    size_t count;
+    MemoEntry *newest;
+    MemoEntry *oldest;
+    size_t hits;
+    size_t misses;
+};
+
+// Live tables, for memo_stats() and --stats
+static std::vector<MemoTable *> memo_tables;
+
+static unsigned long long mix(unsigned long long h, unsigned long long v)
+{
+    h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+static int hash_value(Value v, unsigned long long *h)
+{
+    *h = mix(*h, (unsigned long long)v.type);
+    switch (v.type)
+    {
+    case VAL_INT:
+        *h = mix(*h, (unsigned long long)v.i);
+        return 1;
+    case VAL_FLOAT:
+    {
+        unsigned long long bits;
+        memcpy(&bits, &v.f, sizeof(bits));
+        *h = mix(*h, bits);
+        return 1;
+    }
+    case VAL_CHAR:
+        *h = mix(*h, (unsigned char)v.c);
+        return 1;
+    case VAL_BOOL:
+        *h = mix(*h, (unsigned long long)v.b);
+        return 1;
+    case VAL_NULL:
+        return 1;
+    case VAL_STRING:
+        *h = mix(*h, value_string_hash(&v));
+        return 1;
+    case VAL_DENSE_LIST:
+        *h = mix(*h, (unsigned long long)v.dlist->count);
+        for (int i = 0; i < v.dlist->count; i++)
+        {
+            unsigned long long bits;
+            memcpy(&bits, &v.dlist->data[i], sizeof(bits));
+            *h = mix(*h, bits);
+        }
+        return 1;
+    case VAL_LIST:
+        *h = mix(*h, (unsigned long long)v.list->count);
+        for (int i = 0; i < v.list->count; i++)
+        {
+            if (!hash_value(v.list->items[i], h))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Key equality: same type and same contents (floats bit for bit)
+static int same_value(Value a, Value b)
+{
+    if (a.type != b.type)
+    {
+        return 0;
+    }
+    switch (a.type)
+    {
+    case VAL_INT:
+        return a.i == b.i;
+    case VAL_FLOAT:
+        return memcmp(&a.f, &b.f, sizeof(a.f)) == 0;
+    case VAL_CHAR:
+        return a.c == b.c;
+    case VAL_BOOL:
+        return a.b == b.b;
+    case VAL_NULL:
+        return 1;
+    case VAL_STRING:
+        return value_string_equal(&a, &b);
+    case VAL_LIST:
+        if (a.list == b.list)
+        {
+            return 1;
+        }
+        if (a.list->count != b.list->count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a.list->count; i++)
+        {
+            if (!same_value(a.list->items[i], b.list->items[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case VAL_DENSE_LIST:
+        return a.dlist->count == b.dlist->count &&
+               (a.dlist->count == 0 ||
+                memcmp(a.dlist->data, b.dlist->data, sizeof(double) * a.dlist->count) == 0);
+    default:
+        return 0;
+    }
+}
+
+// Argument i of a call with argc arguments (missing ones are null)
+static Value arg_at(const Value *args, int argc, int i)
+{
+    return i < argc ? args[i] : value_null();
+}
+
+MemoKey memo_key(AstNode *fn, const Value *args, int argc)
+{
+    MemoKey key = { 0, 1 };
+    int nparams = fn->get<FuncDefNode>().param_count;
+    for (int i = 0; i < nparams && key.keyable; i++)
+    {
+        key.keyable = hash_value(arg_at(args, argc, i), &key.hash);
+    }
+    return key;
+}
+
+static MemoTable *memo_table(AstNode *fn)
+{
+    FuncDefNode &def = fn->get<FuncDefNode>();
+    if (!def.memo_table)
+    {
+        MemoTable *t = new MemoTable();
+        t->name = def.name;
+        t->nparams = def.param_count;
+        t->bucket_count = MEMO_MIN_BUCKETS;
+        t->buckets = (MemoEntry **)calloc(t->bucket_count, sizeof(MemoEntry *));
+        t->count = 0;
+        t->newest = t->oldest = nullptr;
+        t->hits = t->misses = 0;
+        def.memo_table = t;
+        memo_tables.push_back(t);
+    }
+    return def.memo_table;
+}
+
+static MemoEntry *find_entry(MemoTable *t, MemoKey key, const Value *args, int argc)
+{
+    for (MemoEntry *e = t->buckets[key.hash & (t->bucket_count - 1)]; e; e = e->chain)
+    {
+        if (e->hash != key.hash)
+        {
+            continue;
+        }
+        int i = 0;
+        while (i < t->nparams && same_value(e->args[i], arg_at(args, argc, i)))
+        {
+            i++;
+        }
+        if (i == t->nparams)
+        {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+static void unlink_lru(MemoTable *t, MemoEntry *e)
+{
+    (e->newer ? e->newer->older : t->newest) = e->older;
+    (e->older ? e->older->newer : t->oldest) = e->newer;
+}
+
+static void push_newest(MemoTable *t, MemoEntry *e)
+{
+    e->newer = nullptr;
+    e->older = t->newest;
+    (t->newest ? t->newest->newer : t->oldest) = e;
+    t->newest = e;
+}
+
+static void free_entry(MemoTable *t, MemoEntry *e)
+{
+    for (int i = 0; i < t->nparams; i++)
+    {
+        value_free(e->args[i]);
+    }
+    value_free(e->result);
+    free(e->args);
+    free(e);
+}
+
+// Drops the least recently used entry
+static void evict(MemoTable *t)
+{
+    MemoEntry *e = t->oldest;
+    MemoEntry **link = &t->buckets[e->hash & (t->bucket_count - 1)];
+    while (*link != e)
+    {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+    unlink_lru(t, e);
+    free_entry(t, e);
+    t->count--;
+}
+
+static void grow_buckets(MemoTable *t)
+{
+    size_t count = t->bucket_count * 2;
+    MemoEntry **buckets = (MemoEntry **)calloc(count, sizeof(MemoEntry *));
+    for (size_t b = 0; b < t->bucket_count; b++)
+    {
+        MemoEntry *e = t->buckets[b];
+        while (e)
+        {
+            MemoEntry *next = e->chain;
+            e->chain = buckets[e->hash & (count - 1)];
+            buckets[e->hash & (count - 1)] = e;
+            e = next;
+        }
+    }
+    free(t->buckets);
+    t->buckets = buckets;
+    t->bucket_count = count;
+}
+
+int memo_lookup(AstNode *fn, MemoKey key, const Value *args, int argc, Value *out)
+{
+    if (!key.keyable)
+    {
+        return 0;
+    }
+    MemoTable *t = memo_table(fn);
+    MemoEntry *e = find_entry(t, key, args, argc);
+    if (!e)
+    {
+        t->misses++;
+        return 0;
+    }
+    t->hits++;
+    if (t->newest != e)
+    {
+        unlink_lru(t, e);
+        push_newest(t, e);
+    }
+    *out = value_copy(e->result);
+    return 1;
+}
+
+void memo_store(AstNode *fn, MemoKey key, const Value *args, int argc, Value result)
+{
+    if (!key.keyable || luna_memo_limit <= 0)
+    {
+        return;
+    }
+    MemoTable *t = memo_table(fn);
+
+    // A recursive call may have stored the same arguments meanwhile
+    MemoEntry *e = find_entry(t, key, args, argc);
+    if (e)
+    {
+        value_free(e->result);
+        e->result = value_copy(result);
+        return;
+    }
+
+    while (t->count > 0 && (long long)t->count >= luna_memo_limit)
+    {
+        evict(t);
+    }
+    if (t->count >= t->bucket_count)
+    {
+        grow_buckets(t);
+    }
+
+    e = (MemoEntry *)malloc(sizeof(MemoEntry));
+    e->hash = key.hash;
+    e->args = (Value *)malloc(sizeof(Value) * (t->nparams > 0 ? t->nparams : 1));
+    for (int i = 0; i < t->nparams; i++)
+    {
+        e->args[i] = value_copy(arg_at(args, argc, i));
+    }
+    e->result = value_copy(result);
+    MemoEntry **bucket = &t->buckets[key.hash & (t->bucket_count - 1)];
+    e->chain = *bucket;
+    *bucket = e;
+    push_newest(t, e);
+    t->count++;
+}
+
+void memo_free(MemoTable *t)
+{
+    if (!t)
+    {
+        return;
+    }
+    while (t->oldest)
+    {
+        MemoEntry *e = t->oldest;
+        unlink_lru(t, e);
+        free_entry(t, e);
+    }
+    free(t->buckets);
+    memo_tables.erase(std::find(memo_tables.begin(), memo_tables.end(), t));
+    delete t;
+}
+
+void memo_report(FILE *out)
+{
+    for (MemoTable *t : memo_tables)
+    {
+        fprintf(out, "memo %s: %zu hits, %zu misses, %zu entries\n",
+            t->name.c_str(), t->hits, t->misses, t->count);
+    }
+}
+
+Value lib_memo_limit(int argc, Value *argv)
+{
+    if (argc != 1 || argv[0].type != VAL_INT)
+    {
+        fprintf(stderr, "Runtime Error: memo_limit() takes 1 integer argument.\n");
+        return value_null();
+    }
+    long long previous = luna_memo_limit;
+    luna_memo_limit = argv[0].i;
+    return value_int(previous);
+}
+
+Value lib_memo_stats(int argc, Value *argv)
+{
+    if (argc != 1 || argv[0].type != VAL_STRING)
+    {
+        fprintf(stderr, "Runtime Error: memo_stats() takes 1 string argument.\n");
+        return value_null();
+    }
+
+    // The most recently created table of that name
+    long long hits = 0, misses = 0, entries = 0;
+    for (MemoTable *t : memo_tables)
+    {
+        if (t->name == value_chars(&argv[0]))
+        {
+            hits = (long long)t->hits;
+            misses = (long long)t->misses;
+            entries = (long long)t->count;
+        }
+    }
+    Value list = value_list();
+    value_list_append(&list, value_int(hits));
+    value_list_append(&list, value_int(misses));
+    value_list_append(&list, value_int(entries));
+    return list;
+}
@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// AST optimizer (see optimizer.h). Constants are folded with eval_binop and
+// is_truthy from the interpreter, so a folded expression always has the
+// value running it would have produced. Replaced nodes are left in the
+// program's arena and freed with it.
+
+#include <luna/optimizer.h>
+#include <luna/interpreter.h>
+#include <luna/value.h>
+
+int luna_no_opt = 0;
+
+static AstNode *opt_expr(AstNode *n);
+static AstNode *opt_stmt(AstNode *n);
+static void opt_list(NodeList *list);
+
+// Optimizes each expression of an argument or item list
+static void opt_exprs(NodeList *list)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        list->items[i] = opt_expr(list->items[i]);
+    }
+}
+
+// Gives the value of a literal node. Returns 0 for anything else.
+static int literal_value(AstNode *n, Value *out)
+{
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        *out = value_int(n->get<NumberNode>().value);
+        return 1;
+    case NODE_FLOAT:
+        *out = value_float(n->get<FloatNode>().value);
+        return 1;
+    case NODE_STRING:
+        *out = value_string(n->get<StringNode>().text);
+        return 1;
+    case NODE_CHAR:
+        *out = value_char(n->get<CharNode>().value);
+        return 1;
+    case NODE_BOOL:
+        *out = value_bool(n->get<BoolNode>().value);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Makes a literal node holding v, or returns nullptr if v has no literal form
+static AstNode *literal_node(Value v, int line)
+{
+    switch (v.type)
+    {
+    case VAL_INT:
+        return ast_number(v.i, line);
+    case VAL_FLOAT:
+        return ast_float(v.f, line);
+    case VAL_STRING:
+        return ast_string(value_chars(&v), line);
+    case VAL_CHAR:
+        return ast_char(v.c, line);
+    case VAL_BOOL:
+        return ast_bool(v.b, line);
+    default:
+        return nullptr;
+    }
+}
+
+// True when n always evaluates to an integer
+static int is_int_expr(AstNode *n)
+{
+    switch (n->kind)
+    {
+    case NODE_NUMBER:
+        return 1;
+    case NODE_CALL:
+    {
+        Intrinsic intrinsic = n->get<CallNode>().intrinsic;
+        return intrinsic == INTRINSIC_LEN || intrinsic == INTRINSIC_INT;
+    }
+    case NODE_BINOP:
+    {
+        BinOpNode &binop = n->get<BinOpNode>();
+        return (binop.op == OP_ADD || binop.op == OP_SUB || binop.op == OP_MUL) &&
+            is_int_expr(binop.left) && is_int_expr(binop.right);
+    }
+    default:
+        return 0;
+    }
+}
+
+static int is_int_literal(AstNode *n, long long v)
+{
+    return n->kind == NODE_NUMBER && n->get<NumberNode>().value == v;
+}
+
+// Replaces the binop n by one of its operands
+static AstNode *keep_operand(AstNode *n, int left)
+{
+    BinOpNode &binop = n->get<BinOpNode>();
+    return left ? binop.left : binop.right;
+}
+
+static AstNode *opt_binop(AstNode *n)
+{
+    BinOpNode &binop = n->get<BinOpNode>();
+    binop.left = opt_expr(binop.left);
+    binop.right = opt_expr(binop.right);
+    if (!binop.left || !binop.right)
+    {
+        return n;
+    }
+
+    Value l, r;
+    int l_const = literal_value(binop.left, &l);
+
+    // A constant left side decides && and || on its own: the result is
+    // either the left value or whatever the right side evaluates to
+    if (binop.op == OP_AND || binop.op == OP_OR)
+    {
+        if (!l_const)
+        {
+            return n;
+        }
+        int truthy = is_truthy(l);
+        value_free(l);
+        return keep_operand(n, binop.op == OP_AND ? !truthy : truthy);
+    }
+
+    if (l_const && literal_value(binop.right, &r))
+    {
+        // Integer modulo by zero is left for the program to hit at run time
+        int skip = binop.op == OP_MOD &&
+            ((r.type == VAL_INT && r.i == 0) || (r.type == VAL_FLOAT && r.f == 0));
+        AstNode *folded = nullptr;
+        if (!skip)
+        {
+            Value v = eval_binop(binop.op, l, r);
+            folded = literal_node(v, n->line);
+            value_free(v);
+        }
+        value_free(l);
+        value_free(r);
+        return folded ? folded : n;
+    }
+    if (l_const)
+    {
+        value_free(l);
+    }
+
+    // Identities, only where the other operand is known to be an integer
+    switch (binop.op)
+    {
+    case OP_ADD:
+        if (is_int_literal(binop.right, 0) && is_int_expr(binop.left))
+        {
+            return keep_operand(n, 1);
+        }
+        if (is_int_literal(binop.left, 0) && is_int_expr(binop.right))
+        {
+            return keep_operand(n, 0);
+        }
+        break;
+    case OP_SUB:
+        if (is_int_literal(binop.right, 0) && is_int_expr(binop.left))
+        {
+            return keep_operand(n, 1);
+        }
+        break;
+    case OP_MUL:
+        if (is_int_literal(binop.right, 1) && is_int_expr(binop.left))
+        {
+            return keep_operand(n, 1);
+        }
+        if (is_int_literal(binop.left, 1) && is_int_expr(binop.right))
+        {
+            return keep_operand(n, 0);
+        }
+        if (is_int_literal(binop.right, 0) && is_int_expr(binop.left) && ast_is_pure(binop.left))
+        {
+            return keep_operand(n, 0);
+        }
+        if (is_int_literal(binop.left, 0) && is_int_expr(binop.right) && ast_is_pure(binop.right))
+        {
+            return keep_operand(n, 1);
+        }
+        break;
+    default:
+        break;
+    }
+    return n;
+}
+
+static AstNode *opt_expr(AstNode *n)
+{
+    if (!n)
+    {
+        return n;
+    }
+    switch (n->kind)
+    {
+    case NODE_BINOP:
+        return opt_binop(n);
+
+    case NODE_NOT:
+    {
+        NotNode &not_node = n->get<NotNode>();
+        not_node.expr = opt_expr(not_node.expr);
+        Value v;
+        if (not_node.expr && literal_value(not_node.expr, &v))
+        {
+            AstNode *folded = ast_bool(!is_truthy(v), n->line);
+            value_free(v);
+            return folded;
+        }
+        return n;
+    }
+
+    case NODE_LIST:
+        opt_exprs(&n->get<ListNode>().items);
+        return n;
+
+    case NODE_MAP:
+        opt_exprs(&n->get<MapNode>().items);
+        return n;
+
+    case NODE_INDEX:
+    {
+        IndexNode &idx = n->get<IndexNode>();
+        idx.target = opt_expr(idx.target);
+        idx.index = opt_expr(idx.index);
+        return n;
+    }
+
+    case NODE_CALL:
+        opt_exprs(&n->get<CallNode>().args);
+        return n;
+
+    default:
+        return n;
+    }
+}
+
+// True when the literal n is known to be truthy (*truthy) or falsy
+static int const_condition(AstNode *n, int *truthy)
+{
+    Value v;
+    if (!n || !literal_value(n, &v))
+    {
+        return 0;
+    }
+    *truthy = is_truthy(v);
+    value_free(v);
+    return 1;
+}
+
+// Takes the statements out of list as a scoped block, or nullptr if empty
+static AstNode *take_block(NodeList *list, int line)
+{
+    if (list->count == 0)
+    {
+        return nullptr;
+    }
+    AstNode *block = ast_block(*list, line);
+    nodelist_init(list);
+    return block;
+}
+
+// Returns the optimized statement, or nullptr if it can be dropped
+static AstNode *opt_stmt(AstNode *n)
+{
+    if (!n)
+    {
+        return n;
+    }
+    switch (n->kind)
+    {
+    case NODE_LET:
+        n->get<LetNode>().expr = opt_expr(n->get<LetNode>().expr);
+        return n;
+
+    case NODE_ASSIGN:
+        n->get<AssignNode>().expr = opt_expr(n->get<AssignNode>().expr);
+        return n;
+
+    case NODE_ASSIGN_INDEX:
+    {
+        AssignIndexNode &node = n->get<AssignIndexNode>();
+        node.value = opt_expr(node.value);
+        node.list = opt_expr(node.list);
+        node.index = opt_expr(node.index);
+        return n;
+    }
+
+    case NODE_PRINT:
+        opt_exprs(&n->get<PrintNode>().args);
+        return n;
+
+    case NODE_IF:
+    {
+        IfNode &node = n->get<IfNode>();
+        node.cond = opt_expr(node.cond);
+        opt_list(&node.then_block);
+        opt_list(&node.else_block);
+
+        // The branch that runs keeps its own scope
+        int truthy;
+        if (!const_condition(node.cond, &truthy))
+        {
+            return n;
+        }
+        return take_block(truthy ? &node.then_block : &node.else_block, n->line);
+    }
+
+    case NODE_WHILE:
+    {
+        WhileNode &node = n->get<WhileNode>();
+        node.cond = opt_expr(node.cond);
+        opt_list(&node.body);
+        int truthy;
+        if (const_condition(node.cond, &truthy) && !truthy)
+        {
+            return nullptr;
+        }
+        return n;
+    }
+
+    case NODE_FOR:
+    {
+        ForNode &node = n->get<ForNode>();
+        node.init = opt_stmt(node.init);
+        node.cond = opt_expr(node.cond);
+        node.incr = opt_stmt(node.incr);
+        opt_list(&node.body);
+        return n;
+    }
+
+    case NODE_SWITCH:
+    {
+        SwitchNode &node = n->get<SwitchNode>();
+        node.expr = opt_expr(node.expr);
+        for (int i = 0; i < node.cases.count; i++)
+        {
+            CaseNode &case_node = node.cases.items[i]->get<CaseNode>();
+            case_node.value = opt_expr(case_node.value);
+            opt_list(&case_node.body);
+        }
+        opt_list(&node.default_case);
+        return n;
+    }
+
+    case NODE_BLOCK:
+    case NODE_GROUP:
+        opt_list(&n->get<BlockNode>().items);
+        return n;
+
+    case NODE_FUNC_DEF:
+        opt_list(&n->get<FuncDefNode>().body);
+        return n;
+
+    case NODE_RETURN:
+        n->get<ReturnNode>().expr = opt_expr(n->get<ReturnNode>().expr);
+        return n;
+
+    default:
+        // Expression statements
+        return opt_expr(n);
+    }
+}
+
+// Optimizes a statement list, dropping statements that do nothing
+static void opt_list(NodeList *list)
+{
+    int kept = 0;
+    for (int i = 0; i < list->count; i++)
+    {
+        AstNode *n = opt_stmt(list->items[i]);
+        if (n)
+        {
+            list->items[kept++] = n;
+        }
+    }
+    list->count = kept;
+}
+
+AstNode *optimize_program(AstNode *prog)
+{
+    if (!prog || luna_no_opt)
+    {
+        return prog;
+    }
+    return opt_stmt(prog);
+}
@@ -38,6 +38,13 @@ static int match(Parser *p, TokenType type)
     return 0;
 }
 
+static void skip_newlines(Parser *p)
+{
+    while (match(p, T_NEWLINE))
+    {
+    }
+}
+
 static void consume(Parser *p, TokenType type, const char *err)
 {
     if (p->had_error)
@@ -59,6 +66,30 @@ static void consume(Parser *p, TokenType type, const char *err)
     }
 }
 
+// Type of the token after the current one, without consuming anything
+static TokenType peek_type(Parser *p)
+{
+    Lexer saved = p->lx;
+    Token next = lexer_next(&p->lx);
+    TokenType type = next.type;
+    free_token(&next);
+    p->lx = saved;
+    return type;
+}
+
+// 'memo' is only a keyword right before 'func', so it stays usable as a
+// variable name
+static int match_memo(Parser *p)
+{
+    if (check(p, T_IDENT) && !strcmp(p->cur.lexeme, "memo") && peek_type(p) == T_FUNC)
+    {
+        match(p, T_IDENT);
+        match(p, T_FUNC);
+        return 1;
+    }
+    return 0;
+}
+
 void parser_init(Parser *p, const char *source)
 {
     p->lx = lexer_create(source);
@@ -158,6 +189,35 @@ static AstNode *primary(Parser *p)
         consume(p, T_RBRACKET, "Expected ']' at end of list");
         return ast_list(items, line);
     }
+    // Map literal {key: value, ...}, which may span lines
+    if (match(p, T_LBRACE))
+    {
+        NodeList items;
+        nodelist_init(&items);
+        skip_newlines(p);
+        if (!check(p, T_RBRACE))
+        {
+            do
+            {
+                skip_newlines(p);
+                if (check(p, T_RBRACE))
+                {
+                    break; // Trailing comma
+                }
+                AstNode *key = expression(p);
+                consume(p, T_COLON, "Expected ':' after map key");
+                AstNode *value = expression(p);
+                if (key && value)
+                {
+                    nodelist_push(&items, key);
+                    nodelist_push(&items, value);
+                }
+                skip_newlines(p);
+            } while (match(p, T_COMMA));
+        }
+        consume(p, T_RBRACE, "Expected '}' at end of map");
+        return ast_map(items, line);
+    }
     // Parse input(...) expression with optional prompt string
     if (match(p, T_INPUT))
     {
@@ -223,10 +283,7 @@ static AstNode *call_or_index(Parser *p)
             if (expr && expr->kind == NODE_IDENT)
             {
                 // FIXED LINE 225 - Using get<IdentNode>() instead of ->ident
-                char *name = my_strdup(expr->get<IdentNode>().name.c_str());
-                ast_free(expr);
-                expr = ast_call(name, args, line);
-                free(name);
+                expr = ast_call(expr->get<IdentNode>().name, args, line);
             }
             else
             {
@@ -253,10 +310,7 @@ static AstNode *call_or_index(Parser *p)
             if (expr && expr->kind == NODE_IDENT)
             {
                 // FIXED: Using get<IdentNode>() instead of ->ident
-                char *name = my_strdup(expr->get<IdentNode>().name.c_str());
-                ast_free(expr);
-                expr = ast_inc(name, line);
-                free(name);
+                expr = ast_inc(expr->get<IdentNode>().name, line);
             }
             else
             {
@@ -278,10 +332,7 @@ static AstNode *call_or_index(Parser *p)
             if (expr && expr->kind == NODE_IDENT)
             {
                 // FIXED: Using get<IdentNode>() instead of ->ident
-                char *name = my_strdup(expr->get<IdentNode>().name.c_str());
-                ast_free(expr);
-                expr = ast_dec(name, line);
-                free(name);
+                expr = ast_dec(expr->get<IdentNode>().name, line);
             }
             else
             {
@@ -456,6 +507,17 @@ static AstNode *statement(Parser *p)
         return function_def(p);
     }
 
+    // memo func name(params) { ... }
+    if (match_memo(p))
+    {
+        AstNode *n = function_def(p);
+        if (n)
+        {
+            n->get<FuncDefNode>().memo = true;
+        }
+        return n;
+    }
+
     if (match(p, T_LET))
     {
         // 1. Collect all variable names
@@ -512,11 +574,6 @@ static AstNode *statement(Parser *p)
                 free(names[i]);
             }
             free(names);
-
-            for (int i = 0; i < val_count; i++)
-            {
-                ast_free(values[i]);
-            }
             free(values);
             return nullptr;
         }
@@ -794,16 +851,13 @@ static AstNode *statement(Parser *p)
         if (expr && expr->kind == NODE_IDENT)
         {
             // FIXED: Using get<IdentNode>() instead of ->ident
-            char *name = my_strdup(expr->get<IdentNode>().name.c_str());
-            ast_free(expr);
+            const char *name = expr->get<IdentNode>().name;
             AstNode *val = expression(p);
             AstNode *n = nullptr;
             if (val && !p->had_error)
             {
                 n = ast_assign(name, val, line);
             }
-                
-            free(name);
             return n;
         }
         // Case 2: List Index Assignment (x[0] = 5)
@@ -814,22 +868,12 @@ static AstNode *statement(Parser *p)
             AstNode *target = index_node.target;
             AstNode *index = index_node.index;
 
-            // Clear the pointers in the node before freeing it
-            index_node.target = nullptr;;
-            index_node.index = nullptr;;
-            ast_free(expr);
-
             AstNode *val = expression(p);
             AstNode *n = nullptr;
             if (val && !p->had_error)
             {
                 n = ast_assign_index(target, index, val, line);
             }
-            else
-            {
-                ast_free(target);
-                ast_free(index);
-            }
             return n;
         }
         else
@@ -838,8 +882,6 @@ static AstNode *statement(Parser *p)
                                       "Invalid assignment target",
                                       "You can only assign to variables (e.g., 'x = 5') or list indices (e.g., 'arr[0] = 5')");
             p->had_error = 1;
-            if (expr) ast_free(expr);
-                
             return nullptr;
         }
     }
@@ -941,6 +983,10 @@ static AstNode *function_def(Parser *p)
 
 AstNode *parser_parse_program(Parser *p)
 {
+    // The tree, and whatever the optimizer adds to it, is made in its own arena
+    AstArena *arena = ast_arena_create();
+    ast_arena_use(arena);
+
     NodeList items;
     nodelist_init(&items);
     int line = p->cur.line;
@@ -970,7 +1016,8 @@ AstNode *parser_parse_program(Parser *p)
     if (p->had_error)
     {
         nodelist_free(&items);
+        ast_arena_free(arena);
         return nullptr;
     }
-    return ast_block(items, line);
+    return ast_program(items, arena, line);
 }
\ No newline at end of file
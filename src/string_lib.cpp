@@ -29,7 +29,7 @@ static std::string_view get_str_arg(Value *argv, int index)
     {
         return {};
     }
-    return argv[index].s;
+    return std::string_view(value_chars(&argv[index]), value_length(&argv[index]));
 }
 
 // Basic Operations
@@ -57,7 +57,15 @@ Value lib_len(int argc, Value *argv)
     }
     else if (v.type == VAL_LIST)
     {
-        return value_int(static_cast<long long>(v.list.count));
+        return value_int(static_cast<long long>(v.list->count));
+    }
+    else if (v.type == VAL_DENSE_LIST)
+    {
+        return value_int(v.dlist->count);
+    }
+    else if (v.type == VAL_MAP)
+    {
+        return value_int(v.map->count);
     }
     else
     {
@@ -67,7 +75,7 @@ Value lib_len(int argc, Value *argv)
             0, 
             0, 
             "len() cannot be used on this type",
-            "len() works on strings and lists."
+            "len() works on strings, lists and maps."
         );
         return value_null();
     }
@@ -100,9 +108,17 @@ Value lib_str_len(int argc, Value *argv)
         {
             return value_int
             (
-                static_cast<long long>(v.list.count)
+                static_cast<long long>(v.list->count)
             );
         }
+        case VAL_DENSE_LIST:
+        {
+            return value_int(v.dlist->count);
+        }
+        case VAL_MAP:
+        {
+            return value_int(v.map->count);
+        }
             
         default:
             error_report
@@ -110,7 +126,7 @@ Value lib_str_len(int argc, Value *argv)
                 ERR_TYPE,
                 0, 0,
                 "len() cannot be used on this type",
-                "len() works on strings and lists."
+                "len() works on strings, lists and maps."
             );
             return value_null();
     }
@@ -188,7 +204,7 @@ Value lib_str_slice(int argc, Value *argv)
         Value src = argv[0];
         long long start = argv[1].i;
         long long end = argv[2].i;
-        long long count = src.list.count;
+        long long count = src.list->count;
 
         // Handle negative indices
         if (start < 0) start += count;
@@ -202,7 +218,7 @@ Value lib_str_slice(int argc, Value *argv)
         Value result = value_list();
         for (long long i = start; i < end; i++)
         {
-            value_list_append(&result, src.list.items[i]);
+            value_list_append(&result, src.list->items[i]);
         }   
         
         return result;
@@ -730,47 +746,65 @@ Value lib_str_join(int argc, Value *argv)
 
     std::string_view delim = get_str_arg(argv, 1);
 
-    const auto& list = argv[0].list;
-    if (list.count == 0)
+    const LunaList *list = argv[0].list;
+    if (list->count == 0)
     {
         return make_string_value({});
     }
 
     // Calculate total size
     size_t total_size = 0;
-    for (int i = 0; i < list.count; ++i)
+    for (int i = 0; i < list->count; ++i)
     {
-        if (list.items[i].type == VAL_STRING && list.items[i].s)
+        if (list->items[i].type == VAL_STRING)
         {
-            total_size += strlen(list.items[i].s);
+            total_size += value_length(&list->items[i]);
         }
     }
     
-    if (list.count > 1)
+    if (list->count > 1)
     {
-        total_size += delim.size() * (list.count - 1);
+        total_size += delim.size() * (list->count - 1);
     }
 
     // Build the result
     std::string result;
     result.reserve(total_size);
     
-    for (int i = 0; i < list.count; ++i)
+    for (int i = 0; i < list->count; ++i)
     {
         if (i > 0 && !delim.empty())
         {
             result.append(delim);
         }
         
-        if (list.items[i].type == VAL_STRING && list.items[i].s)
+        if (list->items[i].type == VAL_STRING)
         {
-            result.append(list.items[i].s);
+            result.append(value_chars(&list->items[i]), value_length(&list->items[i]));
         }
     }
 
     return make_string_value(result);
 }
 
+// An empty string with room reserved for capacity bytes, for building a
+// long string with append() or 's = s + x' without reallocating
+Value lib_str_builder(int argc, Value *argv)
+{
+    if (argc > 1 || (argc == 1 && argv[0].type != VAL_INT))
+    {
+        fprintf(stderr, "Runtime Error: string_builder() takes an optional integer capacity.\n");
+        return value_null();
+    }
+
+    Value s = value_string_alloc(0);
+    if (argc == 1 && argv[0].i > 0)
+    {
+        value_string_reserve(&s, (size_t)argv[0].i);
+    }
+    return s;
+}
+
 // Character Checks
 Value lib_str_is_digit(int argc, Value *argv)
 {
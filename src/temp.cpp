@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Scratch memory (see temp.h): a stack of blocks used from first to last.
+// Releasing a mark only moves the position back; blocks are never freed.
+
+#include <stdlib.h>
+#include <vector>
+#include <luna/temp.h>
+
+#define TEMP_BLOCK (64 * 1024)      // Size of the first block
+#define TEMP_ALIGN 16
+
+typedef struct
+{
+    char *data;
+    size_t size;
+} TempBlock;
+
+static std::vector<TempBlock> blocks;
+static size_t current = 0;          // Block in use
+static size_t used = 0;             // Bytes used in it
+
+TempMark temp_mark(void)
+{
+    TempMark mark = { current, used };
+    return mark;
+}
+
+void *temp_alloc(size_t size)
+{
+    size = (size + TEMP_ALIGN - 1) & ~(size_t)(TEMP_ALIGN - 1);
+    if (current < blocks.size() && used + size <= blocks[current].size)
+    {
+        void *p = blocks[current].data + used;
+        used += size;
+        return p;
+    }
+
+    // Move on to the next block, replacing it if it is too small. Blocks
+    // double in size, so deep nesting needs few of them.
+    if (current < blocks.size())
+    {
+        current++;
+    }
+    if (current == blocks.size() || blocks[current].size < size)
+    {
+        if (current < blocks.size())
+        {
+            free(blocks[current].data);
+            blocks.erase(blocks.begin() + current);
+        }
+        size_t bytes = blocks.empty() ? TEMP_BLOCK : blocks.back().size * 2;
+        while (bytes < size)
+        {
+            bytes *= 2;
+        }
+        TempBlock block = { (char *)malloc(bytes), bytes };
+        blocks.insert(blocks.begin() + current, block);
+    }
+    used = size;
+    return blocks[current].data;
+}
+
+void temp_release(TempMark mark)
+{
+    current = mark.block;
+    used = mark.used;
+}
@@ -4,9 +4,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <format>
 #include <luna/value.h>
 #include <luna/mystr.h>
+#include <luna/temp.h>
+
+#ifdef LUNA_COMPACT_VALUES
+static_assert(sizeof(Value) == 12, "compact Value should be a tag and a payload");
+#else
+static_assert(sizeof(Value) == 16, "Value should be a tag and an 8-byte payload");
+#endif
 
 // Constructor for integer values
 Value value_int(long long x)
@@ -26,20 +32,48 @@ Value value_float(double x)
     return v;
 }
 
-// Constructor for string values
-Value value_string(const char *s)
+// Constructor for a string of len bytes that the caller fills in
+Value value_string_alloc(size_t len)
 {
     Value v;
     v.type = VAL_STRING;
-    if (s)
+    if (len <= VALUE_SMALL_MAX)
     {
-        v.s = my_strdup(s);
+        v.small = (unsigned char)(len + 1);
+        value_chars(&v)[len] = '\0';
+        return v;
     }
-    else
+
+    // Header and characters share one allocation
+    LunaString *str = (LunaString*)malloc(sizeof(LunaString) + len + 1);
+    str->refcount = 1;
+    str->hash = 0;
+    str->length = len;
+    str->capacity = len;
+    str->chars = (char*)(str + 1);
+    str->chars[len] = '\0';
+
+    v.small = 0;
+    v.string = str;
+    return v;
+}
+
+// Constructor for string values from the first len bytes of s
+Value value_string_len(const char *s, size_t len)
+{
+    Value v = value_string_alloc(len);
+    memcpy(value_chars(&v), s, len);
+    return v;
+}
+
+// Constructor for string values
+Value value_string(const char *s)
+{
+    if (!s)
     {
-        v.s = my_strdup("");
+        s = "";
     }
-    return v;
+    return value_string_len(s, strlen(s));
 }
 
 // Constructor for char values
@@ -63,11 +97,30 @@ Value value_bool(int b)
 // Constructor for empty lists
 Value value_list(void)
 {
+    LunaList *list = (LunaList*)malloc(sizeof(LunaList));
+    list->refcount = 1;
+    list->count = 0;
+    list->capacity = 0;
+    list->items = nullptr;
+
     Value v;
     v.type = VAL_LIST;
-    v.list.items = nullptr;
-    v.list.count = 0;
-    v.list.capacity = 0;
+    v.list = list;
+    return v;
+}
+
+// Constructor for empty dense lists
+Value value_dense_list(void)
+{
+    LunaDenseList *dlist = (LunaDenseList*)malloc(sizeof(LunaDenseList));
+    dlist->refcount = 1;
+    dlist->count = 0;
+    dlist->capacity = 0;
+    dlist->data = nullptr;
+
+    Value v;
+    v.type = VAL_DENSE_LIST;
+    v.dlist = dlist;
     return v;
 }
 
@@ -98,26 +151,43 @@ Value value_null(void)
     return v;
 }
 
-// Frees memory associated with a Value (deep free for lists)
+// Releases a reference; the payload is freed with its last reference
 void value_free(Value v)
 {
-    if (v.type == VAL_STRING && v.s)
+    if (v.type == VAL_STRING && !v.small && --v.string->refcount == 0)
+    {
+        free(v.string);
+    }
+    if (v.type == VAL_LIST && --v.list->refcount == 0)
+    {
+        for (int i = 0; i < v.list->count; i++)
+        {
+            value_free(v.list->items[i]);
+        }
+        free(v.list->items);
+        free(v.list);
+    }
+    if (v.type == VAL_DENSE_LIST && --v.dlist->refcount == 0)
     {
-        free(v.s);
+        free(v.dlist->data);
+        free(v.dlist);
     }
-    if (v.type == VAL_LIST)
+    if (v.type == VAL_MAP && --v.map->refcount == 0)
     {
-        for (int i = 0; i < v.list.count; i++)
+        for (int i = 0; i < v.map->used; i++)
         {
-            value_free(v.list.items[i]);
+            value_free(v.map->entries[i].key);
+            value_free(v.map->entries[i].value);
         }
-        free(v.list.items);
+        free(v.map->ctrl);  // The slot indices share its allocation
+        free(v.map->entries);
+        free(v.map);
     }
     // VAL_NATIVE does not need freeing (function pointer is static/global)
     // VAL_FILE does not need freeing here (files must be closed explicitly via close())
 }
 
-// Creates a deep copy of a Value
+// Copies a Value; strings, lists and maps are shared, not duplicated
 Value value_copy(Value v)
 {
     Value r;
@@ -143,23 +213,23 @@ Value value_copy(Value v)
         r.file = v.file;
         break;
     case VAL_STRING:
-        if (v.s)
+        r = v;
+        if (!r.small)
         {
-            r.s = my_strdup(v.s);
-        }
-        else
-        {
-            r.s = my_strdup("");
+            r.string->refcount++;
         }
         break;
     case VAL_LIST:
-        r.list.count = v.list.count;
-        r.list.capacity = v.list.count;
-        r.list.items = (Value*)malloc(sizeof(Value) * r.list.count);
-        for (int i = 0; i < r.list.count; i++)
-        {
-            r.list.items[i] = value_copy(v.list.items[i]);
-        }
+        r.list = v.list;
+        r.list->refcount++;
+        break;
+    case VAL_DENSE_LIST:
+        r.dlist = v.dlist;
+        r.dlist->refcount++;
+        break;
+    case VAL_MAP:
+        r.map = v.map;
+        r.map->refcount++;
         break;
     default:
         r.i = 0;
@@ -168,64 +238,66 @@ Value value_copy(Value v)
     return r;
 }
 
-// Converts a Value to a string representation (for printing)
-char *value_to_string(Value v)
+// Text of a value that is neither a string nor a list or map, written to buf
+// unless it is a fixed word
+static const char *scalar_text(Value v, char buf[128])
 {
-    char buf[128];
     switch (v.type)
     {
     case VAL_INT:
         snprintf(buf, 128, "%lld", v.i); // Use lld for long long
-        return my_strdup(buf);
+        return buf;
 
     case VAL_FLOAT:
         snprintf(buf, 128, "%.6g", v.f);
-        return my_strdup(buf);
+        return buf;
 
     case VAL_BOOL:
-        return my_strdup(v.b ? "true" : "false");
+        return v.b ? "true" : "false";
 
     case VAL_CHAR:
         snprintf(buf, 128, "%c", v.c);
-        return my_strdup(buf);
+        return buf;
 
     case VAL_NATIVE:
-        return my_strdup("<native function>");
+        return "<native function>";
 
     case VAL_FILE:
     {
         if (v.file)
         {
-            return my_strdup("<file handle>");
+            return "<file handle>";
         }
         else
         {
-            return my_strdup("<closed file>");
+            return "<closed file>";
         }
     }
 
-    case VAL_STRING:
-    {
-        if (v.s)
-        {
-            return my_strdup(v.s);
-        }
-        else
-        {
-            return my_strdup("");
-        }
+    default:
+        return "null";
     }
+}
+
+// Converts a Value to a string representation (for printing)
+char *value_to_string(Value v)
+{
+    char buf[128];
+    switch (v.type)
+    {
+    case VAL_STRING:
+        return my_strdup(value_chars(&v));
 
     case VAL_LIST:
     {
         char *res = my_strdup("[");
-        for (int i = 0; i < v.list.count; i++)
+        for (int i = 0; i < v.list->count; i++)
         {
-            char *vs = value_to_string(v.list.items[i]);
+            char *vs = value_to_string(v.list->items[i]);
             size_t new_len = strlen(res) + strlen(vs) + 3;
             res = static_cast<char*>(realloc(res, new_len));
             strcat(res, vs);
-            if (i < v.list.count - 1)
+            if (i < v.list->count - 1)
             {
                 strcat(res, ", ");
             }
@@ -235,11 +307,357 @@ char *value_to_string(Value v)
         strcat(res, "]");
         return res;
     }
+    case VAL_DENSE_LIST:
+    {
+        // Printed like a list of the same floats
+        size_t len = 1;
+        char *res = (char*)malloc((size_t)v.dlist->count * 32 + 3);
+        res[0] = '[';
+        for (int i = 0; i < v.dlist->count; i++)
+        {
+            len += snprintf(res + len, 32, i ? ", %.6g" : "%.6g", v.dlist->data[i]);
+        }
+        memcpy(res + len, "]", 2);
+        return res;
+    }
+    case VAL_MAP:
+    {
+        // {key: value, ...} in insertion order
+        char *res = my_strdup("{");
+        int first = 1;
+        for (int i = 0; i < v.map->used; i++)
+        {
+            LunaMapEntry *entry = &v.map->entries[i];
+            if (entry->key.type == VAL_NULL)
+            {
+                continue;
+            }
+            char *ks = value_to_string(entry->key);
+            char *vs = value_to_string(entry->value);
+            size_t new_len = strlen(res) + strlen(ks) + strlen(vs) + 5;
+            res = static_cast<char*>(realloc(res, new_len));
+            if (!first)
+            {
+                strcat(res, ", ");
+            }
+            strcat(res, ks);
+            strcat(res, ": ");
+            strcat(res, vs);
+            first = 0;
+            free(ks);
+            free(vs);
+        }
+        res = static_cast<char*>(realloc(res, strlen(res) + 2));
+        strcat(res, "}");
+        return res;
+    }
     default:
-        return my_strdup("null");
+        return my_strdup(scalar_text(v, buf));
     }
 }   
 
+// Compares two string values, by length and cached hashes first
+int value_string_equal(const Value *a, const Value *b)
+{
+    size_t len = value_length(a);
+    if (len != value_length(b))
+    {
+        return 0;
+    }
+    if (!a->small && !b->small)
+    {
+        // Copies of one string share its characters
+        if (a->string == b->string)
+        {
+            return 1;
+        }
+        if (a->string->hash && b->string->hash && a->string->hash != b->string->hash)
+        {
+            return 0;
+        }
+    }
+    return memcmp(value_chars(a), value_chars(b), len) == 0;
+}
+
+// djb2, like the variable names in env.cpp (0 is kept for "not computed")
+static unsigned int hash_chars(const char *c, size_t len)
+{
+    unsigned int h = 5381;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = ((h << 5) + h) + (unsigned char)c[i];
+    }
+    return h ? h : 1;
+}
+
+// Cached in heap strings; inline ones are short enough to hash each time
+unsigned int value_string_hash(const Value *v)
+{
+    if (v->small)
+    {
+        return hash_chars(value_chars(v), value_length(v));
+    }
+    if (!v->string->hash)
+    {
+        v->string->hash = hash_chars(v->string->chars, v->string->length);
+    }
+    return v->string->hash;
+}
+
+// Interned heap strings: open addressing, at most half full
+static LunaString **intern_table = nullptr;
+static size_t intern_capacity = 0;
+static size_t intern_count = 0;
+
+static LunaString **intern_find(LunaString **table, size_t capacity, const char *chars, size_t len, unsigned int h)
+{
+    size_t mask = capacity - 1;
+    size_t i = h & mask;
+    while (table[i])
+    {
+        LunaString *str = table[i];
+        if (str->hash == h && str->length == len && memcmp(str->chars, chars, len) == 0)
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &table[i];
+}
+
+Value value_string_intern(const char *chars, size_t len)
+{
+    if (len <= VALUE_SMALL_MAX)
+    {
+        return value_string_len(chars, len);
+    }
+
+    if ((intern_count + 1) * 2 > intern_capacity)
+    {
+        size_t capacity = intern_capacity ? intern_capacity * 2 : 256;
+        LunaString **table = (LunaString**)calloc(capacity, sizeof(LunaString*));
+        for (size_t i = 0; i < intern_capacity; i++)
+        {
+            LunaString *str = intern_table[i];
+            if (str)
+            {
+                *intern_find(table, capacity, str->chars, str->length, str->hash) = str;
+            }
+        }
+        free(intern_table);
+        intern_table = table;
+        intern_capacity = capacity;
+    }
+
+    unsigned int h = hash_chars(chars, len);
+    LunaString **slot = intern_find(intern_table, intern_capacity, chars, len, h);
+    if (!*slot)
+    {
+        // The table keeps a reference, so interned strings are never freed
+        // or appended to in place
+        Value v = value_string_len(chars, len);
+        v.string->hash = h;
+        *slot = v.string;
+        intern_count++;
+    }
+    (*slot)->refcount++;
+
+    Value v;
+    v.type = VAL_STRING;
+    v.small = 0;
+    v.string = *slot;
+    return v;
+}
+
+// value_to_string without the copy: a string's own characters, or the
+// text of anything else in temp memory (see temp.h)
+const char *value_temp_string(const Value *v, size_t *len)
+{
+    const char *text;
+    char buf[128];
+    if (v->type == VAL_STRING)
+    {
+        *len = value_length(v);
+        return value_chars(v);
+    }
+    else if (v->type == VAL_LIST || v->type == VAL_DENSE_LIST || v->type == VAL_MAP)
+    {
+        char *s = value_to_string(*v);
+        *len = strlen(s);
+        char *copy = (char*)temp_alloc(*len + 1);
+        memcpy(copy, s, *len + 1);
+        free(s);
+        return copy;
+    }
+    else
+    {
+        text = scalar_text(*v, buf);
+        if (text == buf)
+        {
+            *len = strlen(buf);
+            char *copy = (char*)temp_alloc(*len + 1);
+            memcpy(copy, buf, *len + 1);
+            return copy;
+        }
+    }
+    *len = strlen(text);
+    return text;
+}
+
+// Gives a list its own payload before it is modified (copy-on-write).
+// The items of the copy are shared with the original.
+void value_list_unique(Value *list)
+{
+    LunaList *old = list->list;
+    if (old->refcount == 1)
+    {
+        return;
+    }
+
+    LunaList *copy = (LunaList*)malloc(sizeof(LunaList));
+    copy->refcount = 1;
+    copy->count = old->count;
+    copy->capacity = old->count;
+    copy->items = old->count ? (Value*)malloc(sizeof(Value) * old->count) : nullptr;
+    for (int i = 0; i < old->count; i++)
+    {
+        copy->items[i] = value_copy(old->items[i]);
+    }
+    old->refcount--;
+    list->list = copy;
+}
+
+// Gives a dense list its own buffer before it is modified
+void value_dlist_unique(Value *list)
+{
+    LunaDenseList *old = list->dlist;
+    if (old->refcount == 1)
+    {
+        return;
+    }
+
+    LunaDenseList *copy = (LunaDenseList*)malloc(sizeof(LunaDenseList));
+    copy->refcount = 1;
+    copy->count = old->count;
+    copy->capacity = old->count;
+    copy->data = old->count ? (double*)malloc(sizeof(double) * old->count) : nullptr;
+    if (old->count)
+    {
+        memcpy(copy->data, old->data, sizeof(double) * old->count);
+    }
+    old->refcount--;
+    list->dlist = copy;
+}
+
+int value_unshare(Value *v)
+{
+    if (v->type == VAL_LIST)
+    {
+        value_list_unique(v);
+        return 1;
+    }
+    if (v->type == VAL_DENSE_LIST)
+    {
+        value_dlist_unique(v);
+        return 1;
+    }
+    if (v->type == VAL_MAP)
+    {
+        value_map_unique(v);
+        return 1;
+    }
+    return 0;
+}
+
+// Gives a string its own buffer of at least capacity bytes, so appending
+// up to that length does not reallocate
+void value_string_reserve(Value *s, size_t capacity)
+{
+    size_t len = value_length(s);
+    if (s->small)
+    {
+        if (capacity <= VALUE_SMALL_MAX)
+        {
+            return;
+        }
+    }
+    else if (s->string->refcount == 1)
+    {
+        if (s->string->capacity < capacity)
+        {
+            // Header and characters move together
+            LunaString *str = (LunaString*)realloc(s->string, sizeof(LunaString) + capacity + 1);
+            str->chars = (char*)(str + 1);
+            str->capacity = capacity;
+            s->string = str;
+        }
+        return;
+    }
+
+    if (capacity < len)
+    {
+        capacity = len;
+    }
+    LunaString *str = (LunaString*)malloc(sizeof(LunaString) + capacity + 1);
+    str->refcount = 1;
+    str->hash = s->small ? 0 : s->string->hash;
+    str->length = len;
+    str->capacity = capacity;
+    str->chars = (char*)(str + 1);
+    memcpy(str->chars, value_chars(s), len + 1);
+    value_free(*s);
+    s->small = 0;
+    s->string = str;
+}
+
+// Appends len bytes to a string in place (copy-on-write, like lists). The
+// buffer at least doubles when it grows, so building a string by appending
+// takes linear time.
+void value_string_append(Value *s, const char *chars, size_t len)
+{
+    size_t old = value_length(s);
+    size_t total = old + len;
+    if (s->small && total <= VALUE_SMALL_MAX)
+    {
+        memcpy(value_chars(s) + old, chars, len);
+        value_chars(s)[total] = '\0';
+        s->small = (unsigned char)(total + 1);
+        return;
+    }
+    if (s->small || s->string->refcount > 1 || s->string->capacity < total)
+    {
+        size_t capacity = s->small ? 0 : s->string->capacity * 2;
+        value_string_reserve(s, capacity > total ? capacity : total);
+    }
+    LunaString *str = s->string;
+    memcpy(str->chars + old, chars, len);
+    str->chars[total] = '\0';
+    str->length = total;
+    str->hash = 0;
+}
+
+// Appends the text of v (as print shows it) to a string
+void value_string_append_value(Value *s, const Value *v)
+{
+    TempMark mark = temp_mark();
+    size_t len;
+    const char *text = value_temp_string(v, &len);
+    value_string_append(s, text, len);
+    temp_release(mark);
+}
+
+// Makes room for capacity items, so appending that many does not reallocate
+void value_list_reserve(Value *list, int capacity)
+{
+    value_list_unique(list);
+    LunaList *l = list->list;
+    if (l->capacity < capacity)
+    {
+        l->items = (Value*)realloc(l->items, sizeof(Value) * capacity);
+        l->capacity = capacity;
+    }
+}
+
 // Appends a value to a list, resizing capacity if needed
 void value_list_append(Value *list, Value v)
 {
@@ -247,11 +665,50 @@ void value_list_append(Value *list, Value v)
     {
         return;
     }
-    if (list->list.count >= list->list.capacity)
+    value_list_unique(list);
+
+    LunaList *l = list->list;
+    if (l->count >= l->capacity)
+    {
+        int n = l->capacity == 0 ? 4 : l->capacity * 2;
+        l->items = (Value*)realloc(l->items, sizeof(Value) * n);
+        l->capacity = n;
+    }
+    l->items[l->count++] = value_copy(v);
+}
+
+// Sets the length of a dense list, filling new items with 0.0
+void value_dlist_resize(Value *list, int count)
+{
+    value_dlist_unique(list);
+    LunaDenseList *d = list->dlist;
+    if (d->capacity < count)
+    {
+        d->data = (double*)realloc(d->data, sizeof(double) * count);
+        d->capacity = count;
+    }
+    for (int i = d->count; i < count; i++)
+    {
+        d->data[i] = 0.0;
+    }
+    d->count = count;
+}
+
+// Appends a number to a dense list, resizing capacity if needed
+void value_dlist_append(Value *list, double v)
+{
+    if (list->type != VAL_DENSE_LIST)
+    {
+        return;
+    }
+    value_dlist_unique(list);
+
+    LunaDenseList *d = list->dlist;
+    if (d->count >= d->capacity)
     {
-        int n = list->list.capacity == 0 ? 4 : list->list.capacity * 2;
-        list->list.items = (Value*)realloc(list->list.items, sizeof(Value) * n);
-        list->list.capacity = n;
+        int n = d->capacity == 0 ? 4 : d->capacity * 2;
+        d->data = (double*)realloc(d->data, sizeof(double) * n);
+        d->capacity = n;
     }
-    list->list.items[list->list.count++] = value_copy(v);
-}
\ No newline at end of file
+    d->data[d->count++] = v;
+}
@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // Copyright (c) 2025 Bharath
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <luna/value.h>
+#include <luna/temp.h>
+#include <luna/luna_error.h>
 #include <luna/vec_lib.h>
 
 // Define the ASM function pointer type
@@ -78,47 +81,79 @@ static double get_val(Value v)
 
 // CORE LOGIC
 
-// Generic handler that takes Values directly
+// The numbers of a list as doubles: a dense list's own buffer, or a boxed
+// list packed into temp memory (see temp.h). nullptr for anything else.
+static double *vec_data(const Value *v, int *count)
+{
+    if (v->type == VAL_DENSE_LIST)
+    {
+        *count = v->dlist->count;
+        return v->dlist->data;
+    }
+    if (v->type != VAL_LIST)
+    {
+        return nullptr;
+    }
+
+    *count = v->list->count;
+    double *raw = (double*)temp_alloc(sizeof(double) * (*count ? *count : 1));
+    for (int i = 0; i < *count; i++)
+    {
+        raw[i] = get_val(v->list->items[i]);
+    }
+    return raw;
+}
+
+// Generic handler that takes Values directly. Two boxed lists give a boxed
+// list as before; if either operand is dense the kernel reads its buffer
+// in place (the other is packed) and writes straight into a dense result.
 static Value vec_op_direct(Value list_a, Value list_b, VecOp op)
 {
     // Safety check: both must be lists
-    if (list_a.type != VAL_LIST || list_b.type != VAL_LIST)
+    if ((list_a.type != VAL_LIST && list_a.type != VAL_DENSE_LIST) ||
+        (list_b.type != VAL_LIST && list_b.type != VAL_DENSE_LIST))
     {
         return value_null();
     }
+    int dense = list_a.type == VAL_DENSE_LIST || list_b.type == VAL_DENSE_LIST;
 
-    int count = list_a.list.count < list_b.list.count ? 
-                list_a.list.count : list_b.list.count;
+    TempMark mark = temp_mark();
+    int count_a, count_b;
+    double *raw_a = vec_data(&list_a, &count_a);
+    double *raw_b = vec_data(&list_b, &count_b);
+    int count = count_a < count_b ? count_a : count_b;
 
-    if (count == 0)
+    if (dense)
     {
-        return value_list();
+        Value res = value_dense_list();
+        value_dlist_resize(&res, count);
+        if (count > 0)
+        {
+            op(count, raw_a, raw_b, res.dlist->data);
+        }
+        temp_release(mark);
+        return res;
     }
 
-    // Allocate & Pack
-    double *raw_a = (double*)malloc(sizeof(double) * count);
-    double *raw_b = (double*)malloc(sizeof(double) * count);
-    double *raw_out = (double*)malloc(sizeof(double) * count);
-
-    for (int i = 0; i < count; i++)
+    if (count == 0)
     {
-        raw_a[i] = get_val(list_a.list.items[i]);
-        raw_b[i] = get_val(list_b.list.items[i]);
+        temp_release(mark);
+        return value_list();
     }
 
     // Call ASM
+    double *raw_out = (double*)temp_alloc(sizeof(double) * count);
     op(count, raw_a, raw_b, raw_out);
 
     // Unpack
     Value res_list = value_list();
+    value_list_reserve(&res_list, count);
     for (int i = 0; i < count; i++)
     {
         value_list_append(&res_list, value_float(raw_out[i]));
     }
 
-    free(raw_a);
-    free(raw_b);
-    free(raw_out);
+    temp_release(mark);
 
     return res_list;
 }
@@ -141,7 +176,7 @@ Value vec_div_values(Value a, Value b)
     return vec_op_direct(a, b, vec_div_asm); 
 }
 
-// NATIVE WRAPPERS (Callable from Luna Scripts)\
+// NATIVE WRAPPERS (Callable from Luna Scripts)
 
 static Value vec_generic_wrapper
 (
@@ -174,4 +209,166 @@ Value lib_vec_mul(int argc, Value *argv)
 Value lib_vec_div(int argc, Value *argv) 
 { 
     return vec_generic_wrapper(argc, argv, vec_div_values, "vec_div"); 
-}
\ No newline at end of file
+}
+
+// dense_list(), dense_list(list) or dense_list(n): an empty dense list, the
+// numbers of a list stored unboxed, or n zeros
+Value lib_dense_list(int argc, Value *argv)
+{
+    if (argc == 0)
+    {
+        return value_dense_list();
+    }
+    if (argc == 1 && argv[0].type == VAL_DENSE_LIST)
+    {
+        return value_copy(argv[0]);
+    }
+    if (argc == 1 && argv[0].type == VAL_INT && argv[0].i >= 0 && argv[0].i <= INT_MAX)
+    {
+        Value res = value_dense_list();
+        value_dlist_resize(&res, (int)argv[0].i);
+        return res;
+    }
+    if (argc != 1 || argv[0].type != VAL_LIST)
+    {
+        error_report
+        (
+            ERR_ARGUMENT,
+            0,
+            0,
+            "dense_list() expects a list of numbers or a length",
+            "Usage: dense_list([1.5, 2, 3]) or dense_list(100)"
+        );
+        return value_null();
+    }
+
+    LunaList *list = argv[0].list;
+    Value res = value_dense_list();
+    value_dlist_resize(&res, list->count);
+    for (int i = 0; i < list->count; i++)
+    {
+        Value item = list->items[i];
+        if (item.type != VAL_INT && item.type != VAL_FLOAT)
+        {
+            error_report
+            (
+                ERR_TYPE,
+                0,
+                0,
+                "Dense lists can only hold numbers",
+                "Store an int or float, or use a plain list for other values"
+            );
+            value_free(res);
+            return value_null();
+        }
+        res.dlist->data[i] = get_val(item);
+    }
+    return res;
+}
+
+// Row i of a matrix: a list of rows, or a single dense row (1 x n)
+static const Value *mat_row(const Value *m, int i)
+{
+    return m->type == VAL_LIST ? &m->list->items[i] : m;
+}
+
+// mat_mul(A, B): A[m x n] * B[n x p]. Rows may be boxed or dense lists;
+// the result is a list of m dense rows.
+Value lib_mat_mul(int argc, Value *argv)
+{
+    if (argc != 2 ||
+        (argv[0].type != VAL_LIST && argv[0].type != VAL_DENSE_LIST) ||
+        (argv[1].type != VAL_LIST && argv[1].type != VAL_DENSE_LIST))
+    {
+        error_report
+        (
+            ERR_ARGUMENT,
+            0,
+            0,
+            "mat_mul() expects 2 matrices",
+            "Usage: mat_mul(A, B) where A and B are lists of rows"
+        );
+        return value_null();
+    }
+    const Value *A = &argv[0];
+    const Value *B = &argv[1];
+    int rows_a = A->type == VAL_LIST ? A->list->count : 1;
+    int rows_b = B->type == VAL_LIST ? B->list->count : 1;
+    if (rows_a == 0 || rows_b == 0)
+    {
+        return value_list();
+    }
+
+    // Every row of B is read once per row of A, so boxed rows are packed once
+    TempMark mark = temp_mark();
+    double **b_rows = (double**)temp_alloc(sizeof(double*) * rows_b);
+    int cols_a = -1;
+    int cols_b = -1;
+    int ok = 1;
+    for (int k = 0; k < rows_b && ok; k++)
+    {
+        int len;
+        b_rows[k] = vec_data(mat_row(B, k), &len);
+        ok = b_rows[k] && (cols_b < 0 || len == cols_b);
+        cols_b = len;
+    }
+    for (int i = 0; i < rows_a && ok; i++)
+    {
+        const Value *row = mat_row(A, i);
+        int len = row->type == VAL_LIST ? row->list->count :
+                  row->type == VAL_DENSE_LIST ? row->dlist->count : -1;
+        ok = len >= 0 && (cols_a < 0 || len == cols_a);
+        cols_a = len;
+    }
+    if (!ok)
+    {
+        error_report
+        (
+            ERR_ARGUMENT,
+            0,
+            0,
+            "mat_mul() needs every row of a matrix to be a list of the same length",
+            "Write matrices as lists of rows, e.g., [[1, 2], [3, 4]]"
+        );
+        temp_release(mark);
+        return value_null();
+    }
+    if (cols_a != rows_b)
+    {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Matrix dimension mismatch (%d cols vs %d rows)", cols_a, rows_b);
+        error_report(ERR_ARGUMENT, 0, 0, msg, "A[m x n] * B[n x p] needs n columns in A and n rows in B");
+        temp_release(mark);
+        return value_null();
+    }
+
+    Value res = value_list();
+    value_list_reserve(&res, rows_a);
+    for (int i = 0; i < rows_a; i++)
+    {
+        Value row = value_dense_list();
+        value_dlist_resize(&row, cols_b);
+        double *out = row.dlist->data;
+
+        TempMark row_mark = temp_mark();
+        int len;
+        double *a = vec_data(mat_row(A, i), &len);
+
+        // Cache-friendly (i, k, j) loop order
+        for (int k = 0; k < cols_a; k++)
+        {
+            double a_val = a[k];
+            double *b = b_rows[k];
+            for (int j = 0; j < cols_b; j++)
+            {
+                out[j] += a_val * b[j];
+            }
+        }
+        temp_release(row_mark);
+
+        value_list_append(&res, row);
+        value_free(row);
+    }
+    temp_release(mark);
+    return res;
+}
@@ -0,0 +1,1163 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2026 Bharath
+
+// Register VM executing the bytecode produced by compiler.cpp.
+// Calls to user functions push a VM frame instead of recursing in C, and
+// dispatch uses computed goto where the compiler supports it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <luna/vm.h>
+#include <luna/bytecode.h>
+#include <luna/interpreter.h>
+#include <luna/env.h>
+#include <luna/jit.h>
+#include <luna/memo.h>
+#include <luna/temp.h>
+#include <luna/value.h>
+#include <luna/luna_error.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LUNA_COMPUTED_GOTO 1
+#endif
+
+typedef struct
+{
+    Proto *proto;
+    const Instr *pc;
+    size_t base;        // First register of the frame in the VM stack
+    size_t ret_reg;     // Caller register receiving the return value
+    Env *env;           // Innermost scope
+    Env *frame_env;     // Scope the frame started in
+    int owns_env;       // frame_env was created by the call
+    AstNode *memo_fn;   // 'memo func' whose result is stored on return
+    MemoKey memo_key;
+    size_t memo_args;   // Its arguments, from here in VM::memo_args
+    int memo_argc;
+} Frame;
+
+// A call whose callee is resolved but whose arguments are still evaluated
+typedef struct
+{
+    AstNode *fn;        // User function, or nullptr
+    NativeFunc native;  // Native function, or nullptr
+    int base;           // Register of the first argument
+    int used;           // Number of arguments that are evaluated
+    int mutates;        // The native changes its list or map arguments
+    uint64_t borrowed;  // Arguments read in place from their variables
+} PendingCall;
+
+struct VM
+{
+    std::vector<Value> stack;
+    std::vector<Frame> frames;
+    std::vector<PendingCall> calls;
+    std::vector<Value> memo_args;   // Arguments of running memo calls
+};
+
+// Makes room for a frame's registers. Invalidates pointers into the stack.
+static void vm_reserve(VM *vm, size_t top)
+{
+    if (vm->stack.size() < top)
+    {
+        vm->stack.resize(top, value_null());
+    }
+}
+
+static int instr_line(const Frame *f)
+{
+    return f->proto->lines[f->pc - f->proto->code.data() - 1];
+}
+
+// Walks an index chain like list[i][j] down to the item it names.
+// Mirrors get_mutable_value in the AST walker, including its errors.
+static Value *vm_resolve(Value *v, Value *idx, int count, int line)
+{
+    for (int k = 0; k < count && v; k++)
+    {
+        if (v->type == VAL_MAP)
+        {
+            value_map_unique(v);
+            v = value_map_find(v, &idx[k]);
+            continue;
+        }
+        if (v->type != VAL_LIST || idx[k].type != VAL_INT)
+        {
+            return nullptr;
+        }
+        if (idx[k].i < 0 || idx[k].i >= v->list->count)
+        {
+            char msg[128];
+            snprintf
+            (
+                msg,
+                sizeof(msg),
+                "Index %lld is out of bounds for list of length %d",
+                idx[k].i,
+                v->list->count
+            );
+            error_report
+            (
+                ERR_INDEX,
+                line,
+                0,
+                msg,
+                "Check that your index is between 0 and len(list)-1"
+            );
+            return nullptr;
+        }
+        // The chain is about to be modified, so each level needs its own copy
+        value_list_unique(v);
+        v = &v->list->items[idx[k].i];
+    }
+    return v;
+}
+
+// Read-only walk of an index chain: no copies, no errors. Returns nullptr
+// when an index is out of range, a key is missing or a level is neither a
+// list nor a map.
+static const Value *vm_borrow(const Value *v, const Value *idx, int count)
+{
+    for (int k = 0; k < count && v; k++)
+    {
+        if (v->type == VAL_MAP)
+        {
+            v = value_map_find(v, &idx[k]);
+            continue;
+        }
+        if (v->type != VAL_LIST || idx[k].type != VAL_INT ||
+            idx[k].i < 0 || idx[k].i >= v->list->count)
+        {
+            return nullptr;
+        }
+        v = &v->list->items[idx[k].i];
+    }
+    return v;
+}
+
+static void vm_set_index(Value *root, Value *r, int count, int line)
+{
+    Value *target = vm_resolve(root, r + 1, count - 1, line);
+    if (target && target->type == VAL_MAP)
+    {
+        map_store(target, &r[count], r[0], line);
+        return;
+    }
+    if (target && target->type == VAL_DENSE_LIST)
+    {
+        dense_store(target, &r[count], r[0], line);
+        return;
+    }
+    if (!target || target->type != VAL_LIST)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Cannot assign to non-list target - target must be a list",
+            "Use list indices only on list variables, e.g., myList[0] = value"
+        );
+        return;
+    }
+
+    Value idx = r[count];
+    if (idx.type != VAL_INT)
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "List index must be an integer",
+            "Use integer values for list indices, e.g., myList[0] or myList[i]"
+        );
+        return;
+    }
+    if (idx.i < 0 || idx.i >= target->list->count)
+    {
+        char msg[128];
+        snprintf
+        (
+            msg,
+            sizeof(msg),
+            "Index %lld is out of bounds for list of length %d",
+            idx.i, target->list->count
+        );
+        error_report
+        (
+            ERR_INDEX,
+            line,
+            0,
+            msg,
+            "Ensure your index is between 0 and len(list)-1"
+        );
+        return;
+    }
+
+    value_list_unique(target);
+    Value *slot = &target->list->items[idx.i];
+    value_free(*slot);
+    *slot = value_copy(r[0]);
+}
+
+static void report_bad_target(int append, int line)
+{
+    if (append)
+    {
+        error_report
+        (
+            ERR_ARGUMENT,
+            line,
+            0,
+            "append() expects a list variable as the first argument",
+            "Use append(myList, value) where myList is a list variable"
+        );
+    }
+    else
+    {
+        error_report
+        (
+            ERR_TYPE,
+            line,
+            0,
+            "Cannot assign to non-list target - target must be a list",
+            "Use list indices only on list variables, e.g., myList[0] = value"
+        );
+    }
+}
+
+static Value *vm_var(Env *env, Proto *proto, const VarRef &ref)
+{
+    if (ref.slot >= 0)
+    {
+        return env_slot(env, ref.depth, ref.slot);
+    }
+    return env_get_cached(env, value_chars(&proto->consts[ref.name]), &proto->globals[ref.cache]);
+}
+
+// Looks up the variable named by operands B and C
+static inline Value *vm_named(Frame *f, const Instr *in)
+{
+    return env_get_cached(f->env, value_chars(&f->proto->consts[in->b]), &f->proto->globals[in->c]);
+}
+
+static Value vm_step_var(Value *v, int delta)
+{
+    if (v && v->type == VAL_INT)
+    {
+        Value old = *v;
+        v->i += delta;
+        return old;
+    }
+    if (v && v->type == VAL_FLOAT)
+    {
+        Value old = *v;
+        v->f += delta;
+        return old;
+    }
+    return value_null();
+}
+
+static Value vm_input(const char *prompt)
+{
+    char buf[256];
+    if (prompt[0])
+    {
+        printf("%s", prompt);
+    }
+    if (fgets(buf, 256, stdin))
+    {
+        buf[strcspn(buf, "\n")] = 0;
+    }
+    else
+    {
+        buf[0] = 0;
+    }
+    return value_string(buf);
+}
+
+// A quickened instruction whose type guard failed this many times stays
+// generic: its operand types change too often to be worth specializing
+#define VM_QUICKEN_MISSES 4
+
+// Rewrites an instruction in place. Protos are shared by every call of a
+// function, so what one call learns about operand types the next call uses.
+static inline void quicken(const Instr *in, int op)
+{
+    const_cast<Instr*>(in)->op = (uint8_t)op;
+}
+
+static inline void deoptimize(const Instr *in, int op)
+{
+    Instr *w = const_cast<Instr*>(in);
+    w->op = (uint8_t)op;
+    if (w->misses < UINT8_MAX)
+    {
+        w->misses++;
+    }
+}
+
+// Moves a register out, leaving null behind
+static inline Value take(Value *r)
+{
+    Value v = *r;
+    *r = value_null();
+    return v;
+}
+
+static inline void clear(Value *r)
+{
+    value_free(*r);
+    *r = value_null();
+}
+
+// Drops a frame's temporaries and its scopes, including any block scopes
+// still open
+static void vm_leave_frame(Frame *f, Value *R)
+{
+    for (int k = 0; k < f->proto->nregs; k++)
+    {
+        clear(&R[k]);
+    }
+    while (f->env != f->frame_env)
+    {
+        Env *inner = f->env;
+        f->env = env_parent(inner);
+        env_free(inner);
+    }
+    if (f->owns_env)
+    {
+        env_free(f->frame_env);
+    }
+}
+
+// Functions with more parameters than this are always called normally
+#define VM_TAIL_ARGS 16
+
+// True when a tail call from f to fn may reuse f. Scoping is dynamic, so
+// the callee would normally see f's variables: the frame can only go away
+// if each of its scopes binds nothing but names fn's parameters hide.
+static int vm_can_replace(const Frame *f, AstNode *fn)
+{
+    const FuncDefNode &def = fn->get<FuncDefNode>();
+    if (!f->owns_env || def.param_count > VM_TAIL_ARGS || def.memo)
+    {
+        return 0;
+    }
+    for (Env *scope = f->env; ; scope = env_parent(scope))
+    {
+        if (!env_binds_only(scope, def.params, def.param_count))
+        {
+            return 0;
+        }
+        if (scope == f->frame_env)
+        {
+            return 1;
+        }
+    }
+}
+
+Value vm_run(Proto *proto, Env *env)
+{
+    VM vm;
+    vm_reserve(&vm, (size_t)proto->nregs + 1);
+
+    Frame top;
+    top.proto = proto;
+    top.pc = proto->code.data();
+    top.base = 0;
+    top.ret_reg = 0;
+    top.env = env;
+    top.frame_env = env;
+    top.owns_env = 0;
+    top.memo_fn = nullptr;
+    vm.frames.push_back(top);
+
+    Frame *f = &vm.frames.back();
+    Value *R = vm.stack.data();
+    const Value *K = proto->consts.data();
+    const Instr *in;
+
+#ifdef LUNA_COMPUTED_GOTO
+#define LUNA_OPCODE_LABEL(op) &&L_##op,
+    static void *dispatch[] = { LUNA_OPCODES(LUNA_OPCODE_LABEL) };
+#undef LUNA_OPCODE_LABEL
+#define VM_CASE(op) L_##op:
+#define VM_NEXT() do { in = f->pc++; goto *dispatch[in->op]; } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() continue
+    for (;;)
+    {
+        in = f->pc++;
+        switch (in->op)
+        {
+#endif
+
+    VM_CASE(BC_LOADK)
+        R[in->a] = value_copy(K[in->b]);
+        VM_NEXT();
+
+    VM_CASE(BC_LOADNULL)
+        R[in->a] = value_null();
+        VM_NEXT();
+
+    VM_CASE(BC_GETVAR)
+    {
+        Value *v = vm_named(f, in);
+        R[in->a] = v ? value_copy(*v) : value_null();
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_DEFVAR)
+        env_def(f->env, value_chars(&K[in->b]), R[in->a]);
+        clear(&R[in->a]);
+        VM_NEXT();
+
+    VM_CASE(BC_SETVAR)
+    {
+        Value *v = vm_named(f, in);
+        if (v)
+        {
+            value_free(*v);
+            *v = take(&R[in->a]);
+            VM_NEXT();
+        }
+        luna_current_line = instr_line(f);
+        env_assign(f->env, value_chars(&K[in->b]), R[in->a]);
+        clear(&R[in->a]);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_INCVAR)
+        R[in->a] = vm_step_var(vm_named(f, in), 1);
+        VM_NEXT();
+
+    VM_CASE(BC_DECVAR)
+        R[in->a] = vm_step_var(vm_named(f, in), -1);
+        VM_NEXT();
+
+    VM_CASE(BC_GETLOCAL)
+        R[in->a] = value_copy(*env_slot(f->env, in->c, in->b));
+        VM_NEXT();
+
+    VM_CASE(BC_DEFLOCAL)
+        env_def_slot(f->env, in->b, take(&R[in->a]));
+        VM_NEXT();
+
+    VM_CASE(BC_SETLOCAL)
+    {
+        Value *slot = env_slot(f->env, in->c, in->b);
+        value_free(*slot);
+        *slot = take(&R[in->a]);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_INCLOCAL)
+        R[in->a] = vm_step_var(env_slot(f->env, in->c, in->b), 1);
+        VM_NEXT();
+
+    VM_CASE(BC_DECLOCAL)
+        R[in->a] = vm_step_var(env_slot(f->env, in->c, in->b), -1);
+        VM_NEXT();
+
+    VM_CASE(BC_STEPLOCAL)
+    {
+        Value *v = env_slot(f->env, in->c, in->b);
+        int delta = in->a ? -1 : 1;
+        if (v->type == VAL_INT)
+        {
+            v->i += delta;
+        }
+        else if (v->type == VAL_FLOAT)
+        {
+            v->f += delta;
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_ADD)
+    VM_CASE(BC_SUB)
+    VM_CASE(BC_MUL)
+    VM_CASE(BC_DIV)
+    VM_CASE(BC_MOD)
+    VM_CASE(BC_EQ)
+    VM_CASE(BC_NEQ)
+    VM_CASE(BC_LT)
+    VM_CASE(BC_GT)
+    VM_CASE(BC_LTE)
+    VM_CASE(BC_GTE)
+    vm_binop:
+    {
+        // Specialize the instruction for the operand types it sees, unless
+        // its guards keep failing (the operands are not monomorphic)
+        int kind = in->op - BC_ADD;
+        const Value *l = &R[in->b];
+        const Value *r = &R[in->c];
+        if (in->misses < VM_QUICKEN_MISSES)
+        {
+            if (l->type == VAL_INT && r->type == VAL_INT)
+            {
+                quicken(in, BC_ADD_II + kind);
+            }
+            else if (l->type == VAL_FLOAT && r->type == VAL_FLOAT)
+            {
+                quicken(in, BC_ADD_FF + kind);
+            }
+        }
+        Value res = eval_binop((BinOpKind)kind, *l, *r);
+        clear(&R[in->b]);
+        clear(&R[in->c]);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    // Quickened operators. Number registers hold nothing to free, so the
+    // operands are consumed by overwriting them. A failed guard turns the
+    // instruction back into the generic one and runs that.
+#define VM_BINOP_II(op, expr)                                               \
+    VM_CASE(op)                                                             \
+        if (R[in->b].type != VAL_INT || R[in->c].type != VAL_INT)           \
+        {                                                                   \
+            deoptimize(in, op - BC_ADD_II + BC_ADD);                        \
+            goto vm_binop;                                                  \
+        }                                                                   \
+        {                                                                   \
+            long long x = R[in->b].i;                                       \
+            long long y = R[in->c].i;                                       \
+            R[in->b] = value_null();                                        \
+            R[in->c] = value_null();                                        \
+            R[in->a] = expr;                                                \
+        }                                                                   \
+        VM_NEXT();
+
+#define VM_BINOP_FF(op, expr)                                               \
+    VM_CASE(op)                                                             \
+        if (R[in->b].type != VAL_FLOAT || R[in->c].type != VAL_FLOAT)       \
+        {                                                                   \
+            deoptimize(in, op - BC_ADD_FF + BC_ADD);                        \
+            goto vm_binop;                                                  \
+        }                                                                   \
+        {                                                                   \
+            double x = R[in->b].f;                                          \
+            double y = R[in->c].f;                                          \
+            R[in->b] = value_null();                                        \
+            R[in->c] = value_null();                                        \
+            R[in->a] = expr;                                                \
+        }                                                                   \
+        VM_NEXT();
+
+    // Same results as the first two cases of eval_binop
+    VM_BINOP_II(BC_ADD_II, value_int(x + y))
+    VM_BINOP_II(BC_SUB_II, value_int(x - y))
+    VM_BINOP_II(BC_MUL_II, value_int(x * y))
+    VM_BINOP_II(BC_DIV_II, y == 0 ? value_int(0) : value_float((double)x / (double)y))
+    VM_BINOP_II(BC_MOD_II, value_int(x % y))
+    VM_BINOP_II(BC_EQ_II, value_bool(x == y))
+    VM_BINOP_II(BC_NEQ_II, value_bool(x != y))
+    VM_BINOP_II(BC_LT_II, value_bool(x < y))
+    VM_BINOP_II(BC_GT_II, value_bool(x > y))
+    VM_BINOP_II(BC_LTE_II, value_bool(x <= y))
+    VM_BINOP_II(BC_GTE_II, value_bool(x >= y))
+    VM_BINOP_FF(BC_ADD_FF, value_float(x + y))
+    VM_BINOP_FF(BC_SUB_FF, value_float(x - y))
+    VM_BINOP_FF(BC_MUL_FF, value_float(x * y))
+    VM_BINOP_FF(BC_DIV_FF, value_float(y == 0 ? 0 : x / y))
+    VM_BINOP_FF(BC_MOD_FF, value_int((long long)fmod(x, y)))
+    VM_BINOP_FF(BC_EQ_FF, value_bool(fabs(x - y) < EPSILON))
+    VM_BINOP_FF(BC_NEQ_FF, value_bool(fabs(x - y) >= EPSILON))
+    VM_BINOP_FF(BC_LT_FF, value_bool(x < y))
+    VM_BINOP_FF(BC_GT_FF, value_bool(x > y))
+    VM_BINOP_FF(BC_LTE_FF, value_bool(x <= y))
+    VM_BINOP_FF(BC_GTE_FF, value_bool(x >= y))
+#undef VM_BINOP_II
+#undef VM_BINOP_FF
+
+    // Loop tests compare the counter where it lives. While both sides are
+    // ints no Value is made; anything else goes through eval_binop.
+#define VM_LOOPTEST(op, cmp)                                                \
+    VM_CASE(op)                                                             \
+    {                                                                       \
+        const Value *i = env_slot(f->env, in->c, in->b);                    \
+        int t;                                                              \
+        if (i->type == VAL_INT && R[in->a].type == VAL_INT)                 \
+        {                                                                   \
+            t = i->i cmp R[in->a].i;                                        \
+            R[in->a] = value_null();                                        \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            BinOpKind kind = (BinOpKind)(OP_LT + (op - BC_LOOPLT));         \
+            Value res = eval_binop(kind, *i, R[in->a]);                     \
+            t = is_truthy(res);                                             \
+            value_free(res);                                                \
+            clear(&R[in->a]);                                               \
+        }                                                                   \
+        if (t)                                                              \
+        {                                                                   \
+            f->pc++;                                                        \
+        }                                                                   \
+        VM_NEXT();                                                          \
+    }
+
+    VM_LOOPTEST(BC_LOOPLT, <)
+    VM_LOOPTEST(BC_LOOPGT, >)
+    VM_LOOPTEST(BC_LOOPLTE, <=)
+    VM_LOOPTEST(BC_LOOPGTE, >=)
+#undef VM_LOOPTEST
+
+    VM_CASE(BC_NOT)
+    {
+        int t = is_truthy(R[in->b]);
+        clear(&R[in->b]);
+        R[in->a] = value_bool(!t);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_JMP)
+        f->pc = f->proto->code.data() + INSTR_JUMP(*in);
+        VM_NEXT();
+
+    VM_CASE(BC_JMPF)
+    {
+        int t = is_truthy(R[in->a]);
+        clear(&R[in->a]);
+        if (!t)
+        {
+            f->pc = f->proto->code.data() + INSTR_JUMP(*in);
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_JMPF_KEEP)
+        if (!is_truthy(R[in->a]))
+        {
+            f->pc = f->proto->code.data() + INSTR_JUMP(*in);
+        }
+        else
+        {
+            clear(&R[in->a]);
+        }
+        VM_NEXT();
+
+    VM_CASE(BC_JMPT_KEEP)
+        if (is_truthy(R[in->a]))
+        {
+            f->pc = f->proto->code.data() + INSTR_JUMP(*in);
+        }
+        else
+        {
+            clear(&R[in->a]);
+        }
+        VM_NEXT();
+
+    VM_CASE(BC_NEWLIST)
+        R[in->a] = value_list();
+        VM_NEXT();
+
+    VM_CASE(BC_LISTPUSH)
+        value_list_append(&R[in->a], R[in->b]);
+        clear(&R[in->b]);
+        VM_NEXT();
+
+    VM_CASE(BC_NEWMAP)
+        R[in->a] = value_map();
+        VM_NEXT();
+
+    VM_CASE(BC_MAPSET)
+        luna_current_line = instr_line(f);
+        map_store(&R[in->a], &R[in->b], R[in->b + 1], luna_current_line);
+        clear(&R[in->b]);
+        clear(&R[in->b + 1]);
+        VM_NEXT();
+
+    VM_CASE(BC_INDEX)
+    {
+        Value target = take(&R[in->b]);
+        Value idx = take(&R[in->c]);
+        Value res = value_null();
+        if (target.type == VAL_LIST && idx.type == VAL_INT)
+        {
+            if (idx.i >= 0 && idx.i < target.list->count)
+            {
+                res = value_copy(target.list->items[idx.i]);
+            }
+        }
+        else if (target.type == VAL_MAP)
+        {
+            const Value *item = value_map_find(&target, &idx);
+            res = item ? value_copy(*item) : value_null();
+        }
+        else if (target.type == VAL_DENSE_LIST && idx.type == VAL_INT)
+        {
+            if (idx.i >= 0 && idx.i < target.dlist->count)
+            {
+                res = value_float(target.dlist->data[idx.i]);
+            }
+        }
+        value_free(target);
+        value_free(idx);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_INDEXVAR)
+    {
+        Value *root = vm_var(f->env, f->proto, f->proto->refs[in->b]);
+        const Value *list = vm_borrow(root, &R[in->a + 1], in->c - 1);
+        const Value *idx = &R[in->a + in->c];
+        if (list && list->type == VAL_DENSE_LIST)
+        {
+            // Dense items are read out, there is no Value to borrow
+            int ok = idx->type == VAL_INT && idx->i >= 0 && idx->i < list->dlist->count;
+            R[in->a] = ok ? value_float(list->dlist->data[idx->i]) : value_null();
+        }
+        else
+        {
+            const Value *item = list ? vm_borrow(list, idx, 1) : nullptr;
+            R[in->a] = item ? value_copy(*item) : value_null();
+        }
+        for (int k = 1; k <= in->c; k++)
+        {
+            clear(&R[in->a + k]);
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_SETINDEX)
+    {
+        int line = instr_line(f);
+        luna_current_line = line;
+        Value *root = vm_var(f->env, f->proto, f->proto->refs[in->b]);
+        vm_set_index(root, &R[in->a], in->c, line);
+        for (int k = 0; k <= in->c; k++)
+        {
+            clear(&R[in->a + k]);
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_APPEND)
+    {
+        int line = instr_line(f);
+        luna_current_line = line;
+        Value *root = vm_var(f->env, f->proto, f->proto->refs[in->b]);
+        Value *list = vm_resolve(root, &R[in->a + 1], in->c, line);
+        if (list && list->type == VAL_LIST)
+        {
+            value_list_append(list, R[in->a]);
+        }
+        else if (list && list->type == VAL_DENSE_LIST)
+        {
+            dense_append(list, R[in->a], line);
+        }
+        else if (list && list->type == VAL_STRING)
+        {
+            value_string_append_value(list, &R[in->a]);
+        }
+        else
+        {
+            report_bad_target(1, line);
+        }
+        for (int k = 0; k <= in->c; k++)
+        {
+            clear(&R[in->a + k]);
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_APPENDSUM)
+    {
+        Value *var = vm_var(f->env, f->proto, f->proto->refs[in->b]);
+        Value *ops = &R[in->a];
+        int count = in->c + 1;
+
+        // Counters and accumulators: x = x + n
+        if (count == 2 && var && var->type == ops[0].type && ops[0].type == ops[1].type)
+        {
+            if (ops[0].type == VAL_INT)
+            {
+                var->i = ops[0].i + ops[1].i;
+                VM_NEXT();
+            }
+            if (ops[0].type == VAL_FLOAT)
+            {
+                var->f = ops[0].f + ops[1].f;
+                VM_NEXT();
+            }
+        }
+
+        if (!append_sum(var, ops, count))
+        {
+            Value res = sum_values(ops, count);
+            if (var)
+            {
+                value_free(*var);
+                *var = res;
+            }
+            else
+            {
+                luna_current_line = instr_line(f);
+                env_assign(f->env, value_chars(&K[f->proto->refs[in->b].name]), res);
+                value_free(res);
+            }
+        }
+        for (int k = 0; k < count; k++)
+        {
+            ops[k] = value_null();
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_BADTARGET)
+    {
+        int line = instr_line(f);
+        luna_current_line = line;
+        report_bad_target(in->c, line);
+        clear(&R[in->a]);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_APPEND_ARGC)
+        fprintf(stderr, "Runtime Error: append() takes 2 arguments (list, value)\n");
+        VM_NEXT();
+
+    VM_CASE(BC_LEN)
+    {
+        Value res = builtin_len(R[in->b]);
+        clear(&R[in->b]);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_LENVAR)
+    {
+        Value *root = vm_var(f->env, f->proto, f->proto->refs[in->b]);
+        const Value *v = vm_borrow(root, &R[in->a + 1], in->c);
+        R[in->a] = v ? builtin_len(*v) : value_int(0);
+        for (int k = 1; k <= in->c; k++)
+        {
+            clear(&R[in->a + k]);
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_TYPE)
+    {
+        Value res = builtin_type(R[in->b]);
+        clear(&R[in->b]);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_TOINT)
+    {
+        Value res = builtin_int(R[in->b]);
+        clear(&R[in->b]);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_TOFLOAT)
+    {
+        Value res = builtin_float(R[in->b]);
+        clear(&R[in->b]);
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_PRINT)
+    {
+        TempMark mark = temp_mark();
+        size_t len;
+        printf("%s ", value_temp_string(&R[in->a], &len));
+        temp_release(mark);
+        clear(&R[in->a]);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_PRINTLN)
+        printf("\n");
+        VM_NEXT();
+
+    VM_CASE(BC_INPUT)
+        R[in->a] = vm_input(value_chars(&K[in->b]));
+        VM_NEXT();
+
+    VM_CASE(BC_SWITCHEQ)
+    {
+        int eq = switch_values_equal(R[in->b], R[in->c]);
+        clear(&R[in->c]);
+        R[in->a] = value_bool(eq);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_FREE)
+        clear(&R[in->a]);
+        VM_NEXT();
+
+    VM_CASE(BC_PUSHSCOPE)
+    {
+        const ScopeLayout &layout = f->proto->scopes[in->a];
+        f->env = env_create_slots(f->env, layout.data(), (int)layout.size());
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_POPSCOPE)
+    {
+        Env *inner = f->env;
+        f->env = env_parent(inner);
+        env_free(inner);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_FUNCDEF)
+    {
+        AstNode *def = f->proto->funcs[in->b];
+        env_def_func(f->env, def->get<FuncDefNode>().name, def);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_PREPCALL)
+    {
+        const CallSite &site = f->proto->calls[in->b];
+        CallTarget target = call_resolve(f->env, *site.node);
+        PendingCall call = { target.fn, target.native, in->a, 0, target.mutates, 0 };
+        if (call.fn)
+        {
+            int nparams = call.fn->get<FuncDefNode>().param_count;
+            call.used = site.argc < nparams ? site.argc : nparams;
+        }
+        else if (call.native)
+        {
+            call.used = site.argc;
+        }
+        vm.calls.push_back(call);
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_ARGSKIP)
+        if (in->a >= vm.calls.back().used)
+        {
+            f->pc = f->proto->code.data() + INSTR_JUMP(*in);
+        }
+        VM_NEXT();
+
+    VM_CASE(BC_ARGVAR)
+    VM_CASE(BC_ARGLOCAL)
+    {
+        // Natives read variables in place. Natives that change their lists
+        // (or maps) get those variables by reference, unshared first so the
+        // change only reaches that variable. User functions get copies.
+        PendingCall &call = vm.calls.back();
+        int arg = in->a - call.base;
+        Value *v = in->op == BC_ARGLOCAL ?
+            env_slot(f->env, in->c, in->b) : vm_named(f, in);
+        if (call.native && v && arg < 64 && (!call.mutates || value_unshare(v)))
+        {
+            R[in->a] = *v;
+            call.borrowed |= (uint64_t)1 << arg;
+        }
+        else
+        {
+            R[in->a] = v ? value_copy(*v) : value_null();
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_ARGREF)
+    VM_CASE(BC_ARGREFLOCAL)
+    {
+        // A variable copied before arguments that might change it. Natives
+        // that change their arguments get it now that those have run.
+        PendingCall &call = vm.calls.back();
+        int arg = in->a - call.base;
+        if (call.native && call.mutates && arg < call.used && arg < 64)
+        {
+            Value *v = in->op == BC_ARGREFLOCAL ?
+                env_slot(f->env, in->c, in->b) : vm_named(f, in);
+            clear(&R[in->a]);
+            if (v && value_unshare(v))
+            {
+                R[in->a] = *v;
+                call.borrowed |= (uint64_t)1 << arg;
+            }
+            else
+            {
+                R[in->a] = v ? value_copy(*v) : value_null();
+            }
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_CALL)
+    VM_CASE(BC_TAILCALL)
+    {
+        PendingCall call = vm.calls.back();
+        vm.calls.pop_back();
+        luna_current_line = instr_line(f);
+
+        // Memoized functions skip the call when the result is known
+        Value res = value_null();
+        MemoKey key = { 0, 0 };
+        int memo = call.fn && call.fn->get<FuncDefNode>().memo;
+        if (memo)
+        {
+            key = memo_key(call.fn, &R[in->b], call.used);
+            if (memo_lookup(call.fn, key, &R[in->b], call.used, &res))
+            {
+                for (int i = 0; i < call.used; i++)
+                {
+                    clear(&R[in->b + i]);
+                }
+                R[in->a] = res;
+                VM_NEXT();
+            }
+        }
+
+        // Hot numeric functions run as machine code when they can
+        if (call.fn && !memo && jit_call(call.fn, call.used, &R[in->b], &res))
+        {
+            for (int i = 0; i < call.used; i++)
+            {
+                clear(&R[in->b + i]);
+            }
+            R[in->a] = res;
+            VM_NEXT();
+        }
+
+        if (call.fn && in->op == BC_TAILCALL && vm_can_replace(f, call.fn))
+        {
+            // Run the callee in this frame: its scope replaces this call's
+            // scopes, so tail recursion needs no extra frames or scopes
+            FuncDefNode &def = call.fn->get<FuncDefNode>();
+            Proto *callee = compile_function(call.fn);
+            Value args[VM_TAIL_ARGS];
+            for (int i = 0; i < def.param_count; i++)
+            {
+                args[i] = i < call.used ? take(&R[in->b + i]) : value_null();
+            }
+            Env *parent = env_parent(f->frame_env);
+            vm_leave_frame(f, R);
+
+            const ScopeLayout &layout = callee->scopes[0];
+            Env *scope = env_create_slots(parent, layout.data(), (int)layout.size());
+            for (int i = 0; i < def.param_count; i++)
+            {
+                env_def_slot(scope, callee->param_slots[i], args[i]);
+            }
+            f->proto = callee;
+            f->pc = callee->code.data();
+            f->env = scope;
+            f->frame_env = scope;
+            vm_reserve(&vm, f->base + callee->nregs + 1);
+            R = vm.stack.data() + f->base;
+            K = f->proto->consts.data();
+            VM_NEXT();
+        }
+
+        if (call.fn)
+        {
+            FuncDefNode &def = call.fn->get<FuncDefNode>();
+            Proto *callee = compile_function(call.fn);
+
+            // A memo call keeps its arguments to store the result under
+            Frame next;
+            next.memo_fn = key.keyable ? call.fn : nullptr;
+            if (next.memo_fn)
+            {
+                next.memo_key = key;
+                next.memo_args = vm.memo_args.size();
+                next.memo_argc = call.used;
+                for (int i = 0; i < call.used; i++)
+                {
+                    vm.memo_args.push_back(value_copy(R[in->b + i]));
+                }
+            }
+
+            // Bind parameters in a new scope; missing arguments are null
+            const ScopeLayout &layout = callee->scopes[0];
+            Env *scope = env_create_slots(f->env, layout.data(), (int)layout.size());
+            for (int i = 0; i < def.param_count; i++)
+            {
+                Value v = i < call.used ? take(&R[in->b + i]) : value_null();
+                env_def_slot(scope, callee->param_slots[i], v);
+            }
+
+            next.proto = callee;
+            next.pc = callee->code.data();
+            next.base = f->base + f->proto->nregs;
+            next.ret_reg = f->base + in->a;
+            next.env = scope;
+            next.frame_env = scope;
+            next.owns_env = 1;
+            vm_reserve(&vm, next.base + callee->nregs + 1);
+            vm.frames.push_back(next);
+
+            f = &vm.frames.back();
+            R = vm.stack.data() + f->base;
+            K = f->proto->consts.data();
+            VM_NEXT();
+        }
+
+        if (call.native)
+        {
+            res = call.native(in->c, &R[in->b]);
+            for (int i = 0; i < in->c; i++)
+            {
+                if (i < 64 && (call.borrowed >> i) & 1)
+                {
+                    R[in->b + i] = value_null();
+                }
+                else
+                {
+                    clear(&R[in->b + i]);
+                }
+            }
+        }
+        R[in->a] = res;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_RETURN)
+    VM_CASE(BC_RETNULL)
+    {
+        Value ret = in->op == BC_RETURN ? take(&R[in->a]) : value_null();
+        vm_leave_frame(f, R);
+        if (f->memo_fn)
+        {
+            memo_store(f->memo_fn, f->memo_key, &vm.memo_args[f->memo_args], f->memo_argc, ret);
+            for (size_t i = f->memo_args; i < vm.memo_args.size(); i++)
+            {
+                value_free(vm.memo_args[i]);
+            }
+            vm.memo_args.resize(f->memo_args);
+        }
+
+        size_t ret_reg = f->ret_reg;
+        vm.frames.pop_back();
+        f = &vm.frames.back();
+        R = vm.stack.data() + f->base;
+        K = f->proto->consts.data();
+        vm.stack[ret_reg] = ret;
+        VM_NEXT();
+    }
+
+    VM_CASE(BC_HALT)
+        vm_leave_frame(f, R);
+        return value_null();
+
+#ifndef LUNA_COMPUTED_GOTO
+        default:
+            return value_null();
+        }
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+}